@@ -0,0 +1,6 @@
+TEMPLATE = subdirs
+
+SUBDIRS += app \
+    tests
+
+app.file = src/qminicom.pro
@@ -1,15 +1,30 @@
 #include "asyncserialport.h"
 
 #include <QDebug>
+#include <QFile>
 #include <QMetaEnum>
 #include <QSerialPortInfo>
 
+#ifdef Q_OS_LINUX
+#include <errno.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <linux/serial.h>
+#endif
+
 AsyncPort::AsyncPort(QObject *parent) :
     QObject(parent),
     m_serialConnectionCheckTimer(Q_NULLPTR),
     m_serialPort(Q_NULLPTR),
     m_localShell(Q_NULLPTR),
-    m_port(Q_NULLPTR)
+    m_port(Q_NULLPTR),
+    m_savedSerialFlags(-1),
+    m_readLatencyReported(0),
+    m_lastReadTimestamp(0),
+    m_terminalColumns(80),
+    m_terminalRows(24),
+    m_readScheduled(false),
+    m_expectMatcher(Q_NULLPTR)
 {
 }
 
@@ -32,11 +47,8 @@ void AsyncPort::initialize()
 
     m_serialPort = new QSerialPort(this);
 
-    m_localShell = new QProcess(this);
-    QProcessEnvironment env = m_localShell->processEnvironment();
-    env.insert("TERM", "vt100");
-    m_localShell->setProcessEnvironment(env);
-    m_localShell->setProcessChannelMode(QProcess::MergedChannels);
+    m_localShell = new PtyDevice(this);
+    connect(m_localShell, SIGNAL(finished(int)), this, SLOT(finishedLocalShell(int)));
 
     updateStatus(Offline);
 }
@@ -112,7 +124,13 @@ void AsyncPort::openSerialPort(const QString &pn, qint32 br)
                 m_serialPort->clear();
                 m_serialPort->clearError();
 
-                qDebug() << "port" << m_serialPort->portName() << "@" << m_serialPort->baudRate() << "opened";
+                applySerialTuning();
+                m_readLatency.reset();
+                m_readLatencyReported = 0;
+                m_lastReadTimestamp = 0;
+
+                qDebug() << "port" << m_serialPort->portName() << "@" << m_serialPort->baudRate() << "opened"
+                         << (m_tuning.lowLatency ? "(low latency)" : "");
 
                 connect(m_serialPort, SIGNAL(readyRead()), this, SLOT(readPort()));
 
@@ -126,27 +144,69 @@ void AsyncPort::openSerialPort(const QString &pn, qint32 br)
     }
 }
 
+void AsyncPort::setSerialTuning(const SerialTuning &tuning)
+{
+    m_tuning = tuning;
+
+    if (m_port == m_serialPort && m_serialPort->isOpen())
+    {
+        applySerialTuning();
+    }
+}
+
 void AsyncPort::openLocalShell()
 {
-    if (m_port == m_serialPort)
+    if (m_port)
     {
-        closePort(); // shut down serial port
+        closePort(); // shut down serial port or the previous shell
         Q_ASSERT(m_port == Q_NULLPTR);
     }
 
-    if (m_port != m_localShell)
+    m_port = m_localShell;
+
+    updateStatus(Opening);
+
+    QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
+    env.insert("TERM", "vt100");
+
+    m_localShell->setWindowSize(m_terminalColumns, m_terminalRows);
+
+    if (!m_localShell->start("sh", QStringList("-i"), env))
     {
-        m_port = m_localShell;
+        qDebug() << "ERROR Can't start local shell:" << m_localShell->errorString();
+        m_port = Q_NULLPTR;
+        updateStatus(Error);
+        return;
     }
 
     connect(m_localShell, SIGNAL(readyRead()), this, SLOT(readPort()));
 
-    connect(m_localShell, SIGNAL(started()), this, SLOT(startedLocalShell()));
-    connect(m_localShell, SIGNAL(error(QProcess::ProcessError)), this, SLOT(errorLocalShell(QProcess::ProcessError)));
-    connect(m_localShell, SIGNAL(finished(int,QProcess::ExitStatus)), this, SLOT(finishedLocalShell(int,QProcess::ExitStatus)));
-    connect(m_localShell, SIGNAL(stateChanged(QProcess::ProcessState)), this, SLOT(stateChangedLocalShell(QProcess::ProcessState)));
+    qDebug() << "local shell opened";
+
+    updateStatus(Online);
+}
+
+void AsyncPort::openVirtualPort()
+{
+    if (m_port)
+    {
+        closePort();
+        Q_ASSERT(m_port == Q_NULLPTR);
+    }
+
+    m_port = m_localShell;
 
-    m_localShell->start("sh", QStringList("-i"), QIODevice::ReadWrite);
+    if (!m_localShell->openVirtualDevice())
+    {
+        qDebug() << "ERROR Can't open virtual port:" << m_localShell->errorString();
+        m_port = Q_NULLPTR;
+        updateStatus(Error);
+        return;
+    }
+
+    connect(m_localShell, SIGNAL(readyRead()), this, SLOT(readPort()));
+
+    qDebug() << "virtual port" << m_localShell->slaveName() << "opened";
 
     updateStatus(Online);
 }
@@ -164,30 +224,52 @@ void AsyncPort::closePort(AsyncPort::Status st)
     {
         if (m_serialPort->isOpen())
         {
+            restoreSerialTuning();
             m_serialPort->close();
             qDebug() << "port" << m_serialPort->portName() << "closed";
+
+            if (m_readLatency.count())
+            {
+                qDebug().noquote() << "read latency (measured read intervals of a busy line):\n" + m_readLatency.toString();
+            }
         }
         m_serialConnectionCheckTimer->stop();
         m_serialPort->clearError();
-        connect(m_serialPort, SIGNAL(error(QSerialPort::SerialPortError)), this, SLOT(serialPortError(QSerialPort::SerialPortError)));
+        disconnect(m_serialPort, SIGNAL(error(QSerialPort::SerialPortError)), this, SLOT(serialPortError(QSerialPort::SerialPortError)));
     }
     else if (m_port == m_localShell)
     {
         if (m_localShell->isOpen())
         {
-            disconnect(m_localShell, SIGNAL(started()), this, SLOT(startedLocalShell()));
-            disconnect(m_localShell, SIGNAL(error(QProcess::ProcessError)), this, SLOT(errorLocalShell(QProcess::ProcessError)));
-            disconnect(m_localShell, SIGNAL(finished(int,QProcess::ExitStatus)), this, SLOT(finishedLocalShell(int,QProcess::ExitStatus)));
-            disconnect(m_localShell, SIGNAL(stateChanged(QProcess::ProcessState)), this, SLOT(stateChangedLocalShell(QProcess::ProcessState)));
-
             m_localShell->close();
-            qDebug() << "local shell closed"; // XXX wait for finish?
+            qDebug() << "local shell closed";
         }
     }
 
+    if (m_port)
+    {
+        updateStatus(st);
+    }
+
     m_port = Q_NULLPTR;
 }
 
+void AsyncPort::setTerminalSize(int columns, int rows)
+{
+    m_terminalColumns = columns;
+    m_terminalRows = rows;
+
+    if (m_localShell)
+    {
+        m_localShell->setWindowSize(columns, rows);
+    }
+}
+
+PortCounters *AsyncPort::counters()
+{
+    return &m_counters;
+}
+
 void AsyncPort::sendData(QByteArray data)
 {
     //qDebug() << __FUNCTION__;
@@ -204,10 +286,19 @@ void AsyncPort::sendData(QByteArray data)
     }
     else
     {
-        m_port->write(data);
+        qint64 written = m_port->write(data);
+        if (written > 0)
+        {
+            m_counters.txBytes.fetchAndAddRelaxed(written);
+        }
     }
 }
 
+void AsyncPort::setExpectMatcher(ExpectMatcher *matcher)
+{
+    m_expectMatcher = matcher;
+}
+
 void AsyncPort::readPort()
 {
     //qDebug() << __FUNCTION__;
@@ -218,8 +309,65 @@ void AsyncPort::readPort()
         return;
     }
 
-    QByteArray data = m_port->readAll();
-    emit dataReceived(data, m_port == m_localShell);
+    m_readScheduled = false;
+
+    const qint64 timestamp = ChunkLatency::now();
+
+    // ports share I/O threads (see PortThreadPool): read in bounded slices and
+    // queue the rest behind the other ports' events instead of draining a flooding port here
+
+    const qint64 maxReadSlice = 64 * 1024;
+
+    QByteArray data = m_port->read(maxReadSlice);
+
+    if (m_port->bytesAvailable() > 0 && !m_readScheduled)
+    {
+        m_readScheduled = true;
+        QMetaObject::invokeMethod(this, "readPort", Qt::QueuedConnection);
+    }
+
+    if (data.isEmpty())
+    {
+        return;
+    }
+
+    if (m_port == m_serialPort)
+    {
+        // the oldest byte of the chunk arrived after the previous read, so the measured interval
+        // between the reads bounds how long it waited. Only a busy line is sampled: if the chunk
+        // took less than half of the interval on the wire, the line was idle and the interval
+        // says nothing about the delivery
+
+        qint32 br = m_serialPort->baudRate();
+        if (br > 0 && m_lastReadTimestamp > 0)
+        {
+            const int bitsPerChar = 10; // 8N1: start + 8 data + stop
+            const qint64 interval = timestamp - m_lastReadTimestamp;
+            const qint64 wireTime = data.size() * bitsPerChar * Q_INT64_C(1000000) / br;
+
+            if (2 * wireTime >= interval)
+            {
+                m_readLatency.add(interval);
+            }
+        }
+
+        // a read that left bytes behind doesn't bound the next chunk: its oldest byte arrived earlier
+        m_lastReadTimestamp = m_readScheduled ? 0 : timestamp;
+    }
+
+    m_counters.rxBytes.fetchAndAddRelaxed(data.size());
+    m_counters.chunksInFlight.ref();
+
+    if (m_expectMatcher) // a script is running, see ScriptHost
+    {
+        QByteArray reply = m_expectMatcher->feed(data);
+        if (!reply.isEmpty())
+        {
+            sendData(reply); // answered from here, the timing doesn't depend on the script thread
+        }
+    }
+
+    emit dataReceived(data, timestamp);
 }
 
 void AsyncPort::checkSerialPort()
@@ -234,6 +382,11 @@ void AsyncPort::checkSerialPort()
                 qDebug() << "Warning: port" << m_serialPort->portName() << "is invalid, closing...";
                 closePort(Disconnected);
             }
+            else if (m_readLatency.count() != m_readLatencyReported)
+            {
+                m_readLatencyReported = m_readLatency.count();
+                emit readLatencyUpdated(m_readLatency.toString());
+            }
         }
     }
     else
@@ -259,37 +412,13 @@ void AsyncPort::serialPortError(QSerialPort::SerialPortError serialPortError)
     }
 }
 
-void AsyncPort::startedLocalShell()
+void AsyncPort::finishedLocalShell(int exitCode)
 {
-    //qDebug() << __FUNCTION__;
-}
+    qDebug() << __FUNCTION__ << exitCode;
 
-void AsyncPort::errorLocalShell(QProcess::ProcessError e)
-{
-    qDebug() << __FUNCTION__ << e;
-}
-
-void AsyncPort::finishedLocalShell(int r, QProcess::ExitStatus es)
-{
-    qDebug() << __FUNCTION__ << r << es;
-}
-
-void AsyncPort::stateChangedLocalShell(QProcess::ProcessState state)
-{
-    switch (state)
+    if (m_port == m_localShell)
     {
-    case QProcess::NotRunning:
-        updateStatus(Offline);
-        break;
-
-    case QProcess::Starting:
-        updateStatus(Opening);
-        break;
-
-    case QProcess::Running:
-        updateStatus(Online);
-        qDebug() << "local shell opened";
-        break;
+        closePort(Offline);
     }
 }
 
@@ -308,7 +437,7 @@ const QString AsyncPort::portName()
 
     if (m_port == m_localShell)
     {
-        return m_localShell->program();
+        return m_localShell->program().isEmpty() ? m_localShell->slaveName() : m_localShell->program();
     }
 
     return "";
@@ -323,3 +452,86 @@ qint32 AsyncPort::baudRate()
 
     return 0;
 }
+
+void AsyncPort::applySerialTuning()
+{
+    Q_ASSERT(m_serialPort->isOpen());
+
+    m_serialPort->setReadBufferSize(m_tuning.lowLatency ? m_tuning.readBufferSize : 0);
+
+#ifdef Q_OS_LINUX
+    if (!m_tuning.lowLatency)
+    {
+        restoreSerialTuning(); // switched off while the port is open
+        return;
+    }
+
+    int fd = m_serialPort->handle();
+
+    struct serial_struct ss;
+    if (ioctl(fd, TIOCGSERIAL, &ss) < 0)
+    {
+        qDebug() << "Warning: TIOCGSERIAL failed for" << m_serialPort->portName() << ":" << strerror(errno);
+    }
+    else
+    {
+        if (m_savedSerialFlags < 0)
+        {
+            m_savedSerialFlags = ss.flags;
+        }
+
+        ss.flags |= ASYNC_LOW_LATENCY;
+
+        if (ioctl(fd, TIOCSSERIAL, &ss) < 0)
+        {
+            qDebug() << "Warning: TIOCSSERIAL failed for" << m_serialPort->portName() << ":" << strerror(errno);
+        }
+    }
+
+    // no VMIN/VTIME: QSerialPort reads a non-blocking fd, where they have no effect
+
+    // FTDI chips hold the data for up to 16 ms by default, some kernels ignore ASYNC_LOW_LATENCY for them
+    QFile latencyTimer(QString("/sys/bus/usb-serial/devices/%1/latency_timer").arg(m_serialPort->portName()));
+    if (latencyTimer.exists())
+    {
+        if (m_savedLatencyTimer.isEmpty() && latencyTimer.open(QIODevice::ReadOnly))
+        {
+            m_savedLatencyTimer = latencyTimer.readAll().trimmed();
+            latencyTimer.close();
+        }
+
+        if (!latencyTimer.open(QIODevice::WriteOnly) || latencyTimer.write("1") < 0)
+        {
+            qDebug() << "Warning: can't set" << latencyTimer.fileName() << ":" << latencyTimer.errorString();
+        }
+    }
+#endif
+}
+
+void AsyncPort::restoreSerialTuning()
+{
+#ifdef Q_OS_LINUX
+    int fd = m_serialPort->handle();
+
+    if (m_savedSerialFlags >= 0)
+    {
+        struct serial_struct ss;
+        if (ioctl(fd, TIOCGSERIAL, &ss) == 0)
+        {
+            ss.flags = (ss.flags & ~ASYNC_LOW_LATENCY) | (m_savedSerialFlags & ASYNC_LOW_LATENCY);
+            ioctl(fd, TIOCSSERIAL, &ss);
+        }
+        m_savedSerialFlags = -1;
+    }
+
+    if (!m_savedLatencyTimer.isEmpty())
+    {
+        QFile latencyTimer(QString("/sys/bus/usb-serial/devices/%1/latency_timer").arg(m_serialPort->portName()));
+        if (latencyTimer.open(QIODevice::WriteOnly))
+        {
+            latencyTimer.write(m_savedLatencyTimer);
+        }
+        m_savedLatencyTimer.clear();
+    }
+#endif
+}
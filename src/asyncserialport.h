@@ -1,11 +1,38 @@
 #ifndef ASYNCSERIALPORT_H
 #define ASYNCSERIALPORT_H
 
+#include "chunklatency.h"
+#include "expectmatcher.h"
+#include "latencyhistogram.h"
+#include "ptydevice.h"
+
+#include <QAtomicInteger>
 #include <QObject>
-#include <QProcess>
 #include <QSerialPort>
 #include <QTimer>
 
+struct SerialTuning
+{
+    SerialTuning() :
+        lowLatency(false),
+        readBufferSize(4096)
+    {
+    }
+
+    bool lowLatency;        // ASYNC_LOW_LATENCY + FTDI latency timer
+    qint64 readBufferSize;  // QSerialPort internal buffer in low latency mode, 0 = unlimited
+};
+
+Q_DECLARE_METATYPE(SerialTuning)
+
+// updated by the port thread, read by anyone
+struct PortCounters
+{
+    QAtomicInteger<qint64> rxBytes;
+    QAtomicInteger<qint64> txBytes;
+    QAtomicInt chunksInFlight; // emitted by readPort, not yet taken by the log (see Session)
+};
+
 class AsyncPort : public QObject
 {
     Q_OBJECT
@@ -25,36 +52,54 @@ public:
 
     static QString convertStatusToQString(AsyncPort::Status st);
 
+    PortCounters *counters();
+
 signals:
     void statusChanged(AsyncPort::Status st, const QString &pn, qint32 br);
-    void dataReceived(QByteArray data, bool insertCR);
+    void dataReceived(QByteArray data, qint64 timestamp); // timestamp: ChunkLatency::now() at read time
+    void readLatencyUpdated(const QString &histogram);
 
 public slots:
     void initialize();
     void openSerialPort(const QString &pn, qint32 br);
+    void setSerialTuning(const SerialTuning &tuning);
     void openLocalShell();
+    void openVirtualPort();
     void closePort(Status st = Offline);
+    void setTerminalSize(int columns, int rows);
     void sendData(QByteArray data);
+    void setExpectMatcher(ExpectMatcher *matcher); // a running script, Q_NULLPTR detaches it
 
 private slots:
     void readPort();
     void checkSerialPort();
     void serialPortError(QSerialPort::SerialPortError serialPortError);
-    void startedLocalShell();
-    void errorLocalShell(QProcess::ProcessError);
-    void finishedLocalShell(int, QProcess::ExitStatus);
-    void stateChangedLocalShell(QProcess::ProcessState state);
+    void finishedLocalShell(int exitCode);
 
 private:
     void updateStatus(Status st);
     const QString portName();
     qint32 baudRate();
+    void applySerialTuning();
+    void restoreSerialTuning();
 
     Status m_status;
     QTimer *m_serialConnectionCheckTimer;
     QSerialPort *m_serialPort;
-    QProcess *m_localShell;
+    PtyDevice *m_localShell; // local shell or virtual serial device
     QIODevice *m_port;
+
+    SerialTuning m_tuning;
+    int m_savedSerialFlags; // -1 if ASYNC_LOW_LATENCY hasn't been touched
+    QByteArray m_savedLatencyTimer; // FTDI latency_timer sysfs value, empty if untouched
+    LatencyHistogram m_readLatency;
+    qint64 m_readLatencyReported;
+    qint64 m_lastReadTimestamp; // ChunkLatency::now() of the previous read that drained the port, 0 = none
+    int m_terminalColumns;
+    int m_terminalRows;
+    bool m_readScheduled;
+    ExpectMatcher *m_expectMatcher;
+    PortCounters m_counters;
 };
 
 #endif // ASYNCSERIALPORT_H
@@ -0,0 +1,363 @@
+#include "capturewriter.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <stdio.h>
+#include <zlib.h>
+
+enum EscState
+{
+    ESC_NONE,
+    ESC_STARTED,    // ESC
+    ESC_CSI,        // ESC [ ... final byte
+    ESC_ONE_MORE,   // ESC ( B, ESC # 8 etc.
+    ESC_OSC         // ESC ] ... BEL or ST
+};
+
+static QThread *s_writerThread = Q_NULLPTR;
+
+static void stopWriterThread()
+{
+    s_writerThread->quit();
+    s_writerThread->wait();
+    delete s_writerThread;
+    s_writerThread = Q_NULLPTR;
+}
+
+static void compressSegment(const QString &fileName)
+{
+    QFile in(fileName);
+    if (!in.open(QIODevice::ReadOnly))
+    {
+        qDebug() << "Warning: can't compress" << fileName << ":" << in.errorString();
+        return;
+    }
+
+    const QString gzName = fileName + ".gz";
+
+    gzFile out = gzopen(QFile::encodeName(gzName).constData(), "wb6");
+    if (!out)
+    {
+        qDebug() << "Warning: can't create" << gzName;
+        return;
+    }
+
+    bool ok = true;
+
+    for (;;)
+    {
+        QByteArray chunk = in.read(256 * 1024);
+        if (chunk.isEmpty())
+        {
+            break;
+        }
+
+        if (gzwrite(out, chunk.constData(), chunk.size()) != chunk.size())
+        {
+            ok = false;
+            break;
+        }
+    }
+
+    if (gzclose(out) != Z_OK)
+    {
+        ok = false;
+    }
+
+    in.close();
+
+    if (ok)
+    {
+        QFile::remove(fileName);
+    }
+    else
+    {
+        qDebug() << "Warning: compression of" << fileName << "failed";
+        QFile::remove(gzName);
+    }
+}
+
+CaptureWriter::CaptureWriter(QObject *parent) :
+    QObject(parent),
+    m_file(new QFile(this)),
+    m_format(Raw),
+    m_flushTimer(new QTimer(this)),
+    m_flushThresholdBytes(64 * 1024),
+    m_maxSegmentBytes(0),
+    m_maxSegmentSeconds(0),
+    m_compressSegments(false),
+    m_segmentBytes(0),
+    m_escState(ESC_NONE),
+    m_atLineStart(true)
+{
+    m_flushTimer->setInterval(1000);
+    connect(m_flushTimer, SIGNAL(timeout()), this, SLOT(flushTimeout()));
+}
+
+CaptureWriter::~CaptureWriter()
+{
+    close();
+}
+
+QThread *CaptureWriter::writerThread()
+{
+    if (!s_writerThread)
+    {
+        s_writerThread = new QThread();
+        s_writerThread->setObjectName("capture writer");
+        s_writerThread->start(QThread::LowPriority);
+        qAddPostRoutine(stopWriterThread);
+    }
+
+    return s_writerThread;
+}
+
+bool CaptureWriter::parseFormat(const QString &name, CaptureWriter::Format *format)
+{
+    if (name == "raw")
+    {
+        *format = Raw;
+    }
+    else if (name == "plain")
+    {
+        *format = PlainText;
+    }
+    else if (name == "timestamped")
+    {
+        *format = Timestamped;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+void CaptureWriter::setFlushThresholds(int bytes, int intervalMs)
+{
+    m_flushThresholdBytes = bytes;
+    m_flushTimer->setInterval(intervalMs);
+}
+
+void CaptureWriter::setRotation(qint64 maxSegmentBytes, int maxSegmentSeconds, bool compress)
+{
+    m_maxSegmentBytes = maxSegmentBytes;
+    m_maxSegmentSeconds = maxSegmentSeconds;
+    m_compressSegments = compress;
+}
+
+bool CaptureWriter::open(const QString &fileName, CaptureWriter::Format format, QString *error)
+{
+    close();
+
+    m_fileName = fileName;
+    m_format = format;
+    m_escState = ESC_NONE;
+    m_atLineStart = true;
+
+    if (!openSegment())
+    {
+        *error = m_file->errorString();
+        return false;
+    }
+
+    m_flushTimer->start();
+
+    return true;
+}
+
+void CaptureWriter::write(const QByteArray &data)
+{
+    if (!m_file->isOpen())
+    {
+        return;
+    }
+
+    if (m_format == Raw)
+    {
+        m_buffer += data;
+    }
+    else
+    {
+        appendText(data);
+    }
+
+    if (m_buffer.size() >= m_flushThresholdBytes)
+    {
+        flush();
+    }
+}
+
+void CaptureWriter::flush()
+{
+    if (m_buffer.isEmpty() || !m_file->isOpen())
+    {
+        return;
+    }
+
+    qint64 written = m_file->write(m_buffer);
+    if (written != m_buffer.size())
+    {
+        qDebug() << "ERROR Capture write failed:" << m_file->errorString();
+    }
+
+    m_segmentBytes += qMax(written, Q_INT64_C(0));
+    m_buffer.clear();
+
+    if (m_maxSegmentBytes > 0 && m_segmentBytes >= m_maxSegmentBytes)
+    {
+        rotate();
+    }
+}
+
+void CaptureWriter::close()
+{
+    if (m_file->isOpen())
+    {
+        flush();
+        m_file->close();
+    }
+
+    m_flushTimer->stop();
+    m_buffer.clear();
+}
+
+void CaptureWriter::flushTimeout()
+{
+    flush();
+
+    if (m_maxSegmentSeconds > 0 && m_segmentBytes > 0
+            && m_segmentStart.secsTo(QDateTime::currentDateTime()) >= m_maxSegmentSeconds)
+    {
+        rotate();
+    }
+}
+
+bool CaptureWriter::openSegment()
+{
+    bool ok;
+
+    if (m_fileName == "-")
+    {
+        ok = m_file->open(fileno(stdout), QIODevice::WriteOnly | QIODevice::Unbuffered);
+    }
+    else
+    {
+        m_file->setFileName(m_fileName);
+        ok = m_file->open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Unbuffered);
+    }
+
+    m_segmentBytes = ok ? m_file->size() : 0;
+    m_segmentStart = QDateTime::currentDateTime();
+
+    return ok;
+}
+
+void CaptureWriter::rotate()
+{
+    if (m_fileName == "-")
+    {
+        return;
+    }
+
+    m_file->close();
+
+    QString segmentName = QString("%1.%2").arg(m_fileName).arg(m_segmentStart.toString("yyyyMMdd-hhmmss"));
+    if (QFile::exists(segmentName) || QFile::exists(segmentName + ".gz"))
+    {
+        segmentName += QString("-%1").arg(QDateTime::currentMSecsSinceEpoch());
+    }
+
+    if (!QFile::rename(m_fileName, segmentName))
+    {
+        qDebug() << "Warning: can't rotate" << m_fileName << "to" << segmentName;
+    }
+    else if (m_compressSegments)
+    {
+        QtConcurrent::run(compressSegment, segmentName);
+    }
+
+    if (!openSegment())
+    {
+        qDebug() << "ERROR Can't reopen" << m_fileName << ":" << m_file->errorString();
+        m_flushTimer->stop();
+    }
+}
+
+void CaptureWriter::appendText(const QByteArray &data)
+{
+    for (int i = 0; i < data.size(); ++i)
+    {
+        unsigned char c = data.at(i);
+
+        switch (m_escState)
+        {
+        case ESC_NONE:
+            if (c == 0x1B)
+            {
+                m_escState = ESC_STARTED;
+            }
+            else if (c == '\n')
+            {
+                m_buffer += '\n';
+                m_atLineStart = true;
+            }
+            else if (c >= 0x20 || c == '\t')
+            {
+                if (m_atLineStart && m_format == Timestamped)
+                {
+                    m_buffer += QDateTime::currentDateTime().toString("[yyyy-MM-dd hh:mm:ss.zzz] ").toLatin1();
+                }
+                m_atLineStart = false;
+
+                m_buffer += c;
+            }
+            // other control characters, \r included, don't make it to the text capture
+            break;
+
+        case ESC_STARTED:
+            if (c == '[')
+            {
+                m_escState = ESC_CSI;
+            }
+            else if (c == ']')
+            {
+                m_escState = ESC_OSC;
+            }
+            else if (c == '(' || c == ')' || c == '#')
+            {
+                m_escState = ESC_ONE_MORE;
+            }
+            else
+            {
+                m_escState = ESC_NONE;
+            }
+            break;
+
+        case ESC_CSI:
+            if (c >= 0x40 && c <= 0x7E)
+            {
+                m_escState = ESC_NONE;
+            }
+            break;
+
+        case ESC_ONE_MORE:
+            m_escState = ESC_NONE;
+            break;
+
+        case ESC_OSC:
+            if (c == 0x07)
+            {
+                m_escState = ESC_NONE;
+            }
+            else if (c == 0x1B)
+            {
+                m_escState = ESC_STARTED; // ST is ESC '\'
+            }
+            break;
+        }
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef CAPTUREWRITER_H
+#define CAPTUREWRITER_H
+
+#include <QDateTime>
+#include <QFile>
+#include <QObject>
+#include <QThread>
+#include <QTimer>
+
+//
+// Appends the received stream to a file: raw bytes, plain text with the escape sequences stripped
+// or plain text with every line prefixed by the local time it has started at.
+//
+// Writers live in a dedicated background thread (see writerThread()) and are fed by queued signals,
+// so neither the port threads nor the GUI ever wait for the disk. Writes are batched: the buffer goes
+// to disk once it is big enough or on the flush timer.
+//
+// The file can be rotated by size and/or age: the closed segment gets a timestamp suffix
+// and is gzip-compressed in the global thread pool.
+//
+
+class CaptureWriter : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Format
+    {
+        Raw,
+        PlainText,
+        Timestamped
+    };
+    Q_ENUM(Format)
+
+    explicit CaptureWriter(QObject *parent = 0);
+    ~CaptureWriter();
+
+    static QThread *writerThread();
+    static bool parseFormat(const QString &name, Format *format);
+
+    void setFlushThresholds(int bytes, int intervalMs);
+    void setRotation(qint64 maxSegmentBytes, int maxSegmentSeconds, bool compress);
+
+    bool open(const QString &fileName, Format format, QString *error); // "-" stands for stdout
+
+public slots:
+    void write(const QByteArray &data);
+    void flush();
+    void close();
+
+private slots:
+    void flushTimeout();
+
+private:
+    void appendText(const QByteArray &data);
+    bool openSegment();
+    void rotate();
+
+    QFile *m_file;
+    QString m_fileName;
+    Format m_format;
+    QByteArray m_buffer;
+    QTimer *m_flushTimer;
+    int m_flushThresholdBytes;
+
+    qint64 m_maxSegmentBytes;   // 0: no size based rotation
+    int m_maxSegmentSeconds;    // 0: no time based rotation
+    bool m_compressSegments;
+    qint64 m_segmentBytes;
+    QDateTime m_segmentStart;
+
+    int m_escState;
+    bool m_atLineStart;
+};
+
+#endif // CAPTUREWRITER_H
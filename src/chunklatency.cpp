@@ -0,0 +1,171 @@
+#include "chunklatency.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QStringList>
+#include <QTextStream>
+
+#include <algorithm>
+
+ChunkLatency::ChunkLatency()
+{
+    reset();
+}
+
+static QElapsedTimer startedClock()
+{
+    QElapsedTimer clock;
+    clock.start();
+    return clock;
+}
+
+qint64 ChunkLatency::now()
+{
+    static const QElapsedTimer clock = startedClock(); // thread-safe initialization
+
+    return clock.nsecsElapsed() / 1000;
+}
+
+QString ChunkLatency::stageName(ChunkLatency::Stage stage)
+{
+    switch (stage)
+    {
+    case Delivered:
+        return "delivered";
+    case Parsed:
+        return "parsed";
+    case Painted:
+        return "painted";
+    default:
+        return QString();
+    }
+}
+
+void ChunkLatency::add(ChunkLatency::Stage stage, qint64 timestamp)
+{
+    qint64 us = qMax(now() - timestamp, Q_INT64_C(0));
+
+    QVector<qint64> &samples = m_samples[stage];
+
+    if (samples.size() < sampleCount)
+    {
+        samples.append(us);
+    }
+    else
+    {
+        samples[m_next[stage]] = us;
+        m_next[stage] = (m_next[stage] + 1) % sampleCount;
+    }
+
+    m_count[stage]++;
+    m_max[stage] = qMax(m_max[stage], us);
+}
+
+void ChunkLatency::reset()
+{
+    for (int i = 0; i < StageCount; ++i)
+    {
+        m_samples[i].clear();
+        m_samples[i].reserve(sampleCount);
+        m_next[i] = 0;
+        m_count[i] = 0;
+        m_max[i] = 0;
+    }
+}
+
+qint64 ChunkLatency::count(ChunkLatency::Stage stage) const
+{
+    return m_count[stage];
+}
+
+qint64 ChunkLatency::percentile(ChunkLatency::Stage stage, int p) const
+{
+    QVector<qint64> sorted = m_samples[stage];
+
+    if (sorted.isEmpty())
+    {
+        return 0;
+    }
+
+    int ix = qBound(0, (sorted.size() * p + 99) / 100 - 1, sorted.size() - 1);
+    std::nth_element(sorted.begin(), sorted.begin() + ix, sorted.end());
+
+    return sorted.at(ix);
+}
+
+qint64 ChunkLatency::max(ChunkLatency::Stage stage) const
+{
+    return m_max[stage];
+}
+
+QString ChunkLatency::toString() const
+{
+    QStringList lines;
+
+    lines << QString("%1 %2 %3 %4").arg("us", -10).arg("p50", 8).arg("p99", 8).arg("max", 8);
+
+    for (int i = 0; i < StageCount; ++i)
+    {
+        Stage stage = static_cast<Stage>(i);
+
+        lines << QString("%1 %2 %3 %4")
+                 .arg(stageName(stage), -10)
+                 .arg(percentile(stage, 50), 8)
+                 .arg(percentile(stage, 99), 8)
+                 .arg(max(stage), 8);
+    }
+
+    lines << QString("chunks: %1").arg(count(Painted));
+
+    return lines.join("\n");
+}
+
+bool ChunkLatency::dump(const QString &fileName, QString *error) const
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+    {
+        *error = file.errorString();
+        return false;
+    }
+
+    QTextStream out(&file);
+
+    out << toString() << "\n\n";
+
+    // raw samples of the window, oldest first, one column per stage
+
+    for (int i = 0; i < StageCount; ++i)
+    {
+        out << stageName(static_cast<Stage>(i)) << (i + 1 < StageCount ? "\t" : "\n");
+    }
+
+    int rows = 0;
+    for (int i = 0; i < StageCount; ++i)
+    {
+        rows = qMax(rows, m_samples[i].size());
+    }
+
+    for (int row = 0; row < rows; ++row)
+    {
+        for (int i = 0; i < StageCount; ++i)
+        {
+            const QVector<qint64> &samples = m_samples[i];
+            if (row < samples.size())
+            {
+                out << samples.at((m_next[i] + row) % samples.size());
+            }
+            out << (i + 1 < StageCount ? "\t" : "\n");
+        }
+    }
+
+    out.flush();
+
+    if (out.status() != QTextStream::Ok)
+    {
+        *error = file.errorString();
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,51 @@
+#ifndef CHUNKLATENCY_H
+#define CHUNKLATENCY_H
+
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+
+//
+// Receive path latency of the chunks shown by one log widget.
+//
+// Every chunk is stamped with now() in AsyncPort::readPort; the log samples it again
+// when the chunk reaches the GUI thread, when it is parsed and when the paint that shows it is done.
+// The last sampleCount samples of every stage are kept for the percentiles.
+//
+
+class ChunkLatency
+{
+public:
+    enum Stage
+    {
+        Delivered,  // readPort -> appendBytes (queued hop to the GUI thread)
+        Parsed,     // readPort -> parsing done
+        Painted,    // readPort -> first paint that shows the chunk
+        StageCount
+    };
+
+    ChunkLatency();
+
+    static const int sampleCount = 4096;
+
+    static qint64 now(); // monotonic, us, shared by all threads
+    static QString stageName(Stage stage);
+
+    void add(Stage stage, qint64 timestamp); // timestamp as taken by now()
+    void reset();
+
+    qint64 count(Stage stage) const;
+    qint64 percentile(Stage stage, int p) const;
+    qint64 max(Stage stage) const;
+
+    QString toString() const;
+    bool dump(const QString &fileName, QString *error) const;
+
+private:
+    QVector<qint64> m_samples[StageCount];
+    int m_next[StageCount];
+    qint64 m_count[StageCount];
+    qint64 m_max[StageCount];
+};
+
+#endif // CHUNKLATENCY_H
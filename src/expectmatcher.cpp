@@ -0,0 +1,234 @@
+#include "expectmatcher.h"
+
+#include <QElapsedTimer>
+#include <QMutexLocker>
+
+ExpectMatcher::ExpectMatcher() :
+    m_backlogBytes(0),
+    m_rxFrom(0),
+    m_pending(false),
+    m_useRegExp(false),
+    m_replySent(false),
+    m_aborted(false)
+{
+}
+
+QByteArray ExpectMatcher::feed(const QByteArray &data)
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (!m_pending)
+    {
+        m_backlog.append(data); // shared, not copied
+
+        m_backlogBytes += data.size();
+        while (m_backlog.size() > 1 && m_backlogBytes - m_backlog.first().size() >= bufferLimit)
+        {
+            m_backlogBytes -= m_backlog.takeFirst().size();
+        }
+
+        return QByteArray();
+    }
+
+    const int from = m_buffer.size();
+    appendBuffer(data);
+
+    if (!matchBuffer(from))
+    {
+        trimBuffer();
+        return QByteArray();
+    }
+
+    m_replySent = true;
+    m_condition.wakeAll();
+
+    return m_reply;
+}
+
+bool ExpectMatcher::expect(const QByteArray &literal, const QByteArray &reply, int timeoutMs, QByteArray *matched, bool *replySent)
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_useRegExp = false;
+    m_literal = literal;
+    m_reply = reply;
+
+    return waitForMatch(timeoutMs, matched, replySent);
+}
+
+bool ExpectMatcher::expect(const QRegularExpression &rx, const QByteArray &reply, int timeoutMs, QByteArray *matched, bool *replySent)
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_useRegExp = true;
+    m_rx = rx;
+    m_rxFrom = 0;
+    m_reply = reply;
+
+    return waitForMatch(timeoutMs, matched, replySent);
+}
+
+bool ExpectMatcher::sleep(int ms)
+{
+    QMutexLocker locker(&m_mutex);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    while (!m_aborted)
+    {
+        const qint64 left = ms - timer.elapsed();
+        if (left <= 0)
+        {
+            break;
+        }
+
+        m_condition.wait(&m_mutex, left);
+    }
+
+    return !m_aborted;
+}
+
+void ExpectMatcher::abort()
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_aborted = true;
+    m_condition.wakeAll();
+}
+
+bool ExpectMatcher::isAborted()
+{
+    QMutexLocker locker(&m_mutex);
+
+    return m_aborted;
+}
+
+bool ExpectMatcher::waitForMatch(int timeoutMs, QByteArray *matched, bool *replySent)
+{
+    // m_mutex is locked by the caller
+
+    *replySent = false;
+
+    if (m_aborted)
+    {
+        return false;
+    }
+
+    takeBacklog();
+
+    if (matchBuffer(0))
+    {
+        *matched = m_matched;
+        return true;
+    }
+
+    m_replySent = false;
+    m_pending = true;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    while (m_pending && !m_aborted)
+    {
+        if (timeoutMs < 0)
+        {
+            m_condition.wait(&m_mutex);
+            continue;
+        }
+
+        const qint64 left = timeoutMs - timer.elapsed();
+        if (left <= 0)
+        {
+            break;
+        }
+
+        m_condition.wait(&m_mutex, left);
+    }
+
+    if (m_pending)
+    {
+        m_pending = false; // timed out or aborted, the unmatched data stays for the next expect
+        return false;
+    }
+
+    *matched = m_matched;
+    *replySent = m_replySent;
+
+    return true;
+}
+
+void ExpectMatcher::takeBacklog()
+{
+    foreach (const QByteArray &data, m_backlog)
+    {
+        appendBuffer(data);
+    }
+
+    m_backlog.clear();
+    m_backlogBytes = 0;
+
+    trimBuffer();
+}
+
+void ExpectMatcher::appendBuffer(const QByteArray &data)
+{
+    m_buffer += data;
+    m_text += QString::fromLatin1(data); // only the new bytes are converted
+}
+
+void ExpectMatcher::removeBufferHead(int bytes)
+{
+    m_buffer.remove(0, bytes);
+    m_text.remove(0, bytes);
+    m_rxFrom = qMax(0, m_rxFrom - bytes);
+}
+
+void ExpectMatcher::trimBuffer()
+{
+    if (m_buffer.size() > bufferLimit)
+    {
+        removeBufferHead(m_buffer.size() - bufferLimit);
+    }
+}
+
+bool ExpectMatcher::matchBuffer(int from)
+{
+    // a literal is searched in the new data only (plus the overlap with the old one).
+    // A regular expression resumes where the previous attempt has left off: a match can only start
+    // where a partial match has started, or in the new data if there was none. The text before
+    // the offset is still seen by the lookbehinds and anchors
+
+    int start;
+    int end;
+
+    if (m_useRegExp)
+    {
+        QRegularExpressionMatch match = m_rx.match(m_text, m_rxFrom, QRegularExpression::PartialPreferCompleteMatch);
+        if (!match.hasMatch())
+        {
+            m_rxFrom = match.hasPartialMatch() ? match.capturedStart() : m_text.size();
+            return false;
+        }
+
+        start = match.capturedStart();
+        end = match.capturedEnd();
+    }
+    else
+    {
+        start = m_buffer.indexOf(m_literal, qMax(0, from - m_literal.size() + 1));
+        if (start < 0)
+        {
+            return false;
+        }
+
+        end = start + m_literal.size();
+    }
+
+    m_matched = m_buffer.mid(start, end - start);
+    removeBufferHead(end);
+    m_rxFrom = 0;
+    m_pending = false;
+
+    return true;
+}
@@ -0,0 +1,72 @@
+#ifndef EXPECTMATCHER_H
+#define EXPECTMATCHER_H
+
+#include <QByteArray>
+#include <QList>
+#include <QMetaType>
+#include <QMutex>
+#include <QRegularExpression>
+#include <QString>
+#include <QWaitCondition>
+
+//
+// The expect() side of a running script, fed by the port thread.
+//
+// AsyncPort hands every received chunk to feed() while a script is attached. With no expect
+// pending the chunk is only queued (a reference, no copy); a pending expect is matched right there
+// in the port thread, which also sends its reply at once, before the script thread even wakes up.
+// The data received since the last match is kept, bounded by bufferLimit, so an expect issued
+// after the answer has arrived still matches it.
+//
+
+class ExpectMatcher
+{
+public:
+    ExpectMatcher();
+
+    static const int bufferLimit = 64 * 1024;
+
+    // port thread
+    QByteArray feed(const QByteArray &data); // returns the reply to send right away, if any
+
+    // script thread, both return early once aborted, timeoutMs < 0 waits forever.
+    // The reply is sent by the port thread if the match happens there (*replySent),
+    // otherwise (the data had already arrived) it is left to the caller.
+    bool expect(const QByteArray &literal, const QByteArray &reply, int timeoutMs, QByteArray *matched, bool *replySent);
+    bool expect(const QRegularExpression &rx, const QByteArray &reply, int timeoutMs, QByteArray *matched, bool *replySent);
+    bool sleep(int ms);
+
+    // any thread
+    void abort();
+    bool isAborted();
+
+private:
+    bool waitForMatch(int timeoutMs, QByteArray *matched, bool *replySent);
+    void takeBacklog();
+    void appendBuffer(const QByteArray &data);
+    void removeBufferHead(int bytes);
+    void trimBuffer();
+    bool matchBuffer(int from);
+
+    QMutex m_mutex;
+    QWaitCondition m_condition;
+
+    QList<QByteArray> m_backlog; // received with no expect pending
+    int m_backlogBytes;
+    QByteArray m_buffer;         // received since the last match, searched by the pending expect
+    QString m_text;              // m_buffer as Latin-1, byte to char 1:1, for the regular expressions
+    int m_rxFrom;                // no regular expression match can start before this offset of m_text
+
+    bool m_pending;
+    bool m_useRegExp;
+    QByteArray m_literal;
+    QRegularExpression m_rx;
+    QByteArray m_reply;
+    bool m_replySent;
+    QByteArray m_matched;
+    bool m_aborted;
+};
+
+Q_DECLARE_METATYPE(ExpectMatcher *)
+
+#endif // EXPECTMATCHER_H
@@ -0,0 +1,276 @@
+#include "filterview.h"
+
+#include <QFontDatabase>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QScrollBar>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <algorithm>
+
+static const int numberColumnChars = 9;
+
+static bool lineMatches(const QRegularExpression &rx, bool exclude, const QString &text)
+{
+    return rx.match(text).hasMatch() != exclude;
+}
+
+FilterView::FilterView(PlainTextLog *log, QWidget *parent) :
+    QAbstractScrollArea(parent),
+    m_log(log),
+    m_exclude(false),
+    m_active(false),
+    m_firstIndex(0),
+    m_maxWidth(0)
+{
+    setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+
+    verticalScrollBar()->setSingleStep(1);
+    horizontalScrollBar()->setSingleStep(fontMetrics().width('0'));
+
+    connect(m_log, SIGNAL(linesChanged(qint64,qint64)), this, SLOT(linesChanged(qint64,qint64)));
+    connect(m_log, SIGNAL(linesDropped(qint64)), this, SLOT(linesDropped(qint64)));
+    connect(m_log, SIGNAL(linesTrimmed()), this, SLOT(linesTrimmed()));
+
+    updateScrollBars();
+}
+
+bool FilterView::isActive() const
+{
+    return m_active;
+}
+
+int FilterView::matchCount() const
+{
+    return m_ids.size() - m_firstIndex;
+}
+
+bool FilterView::setFilter(const QString &pattern, bool exclude, bool caseSensitive)
+{
+    QRegularExpression rx(pattern, caseSensitive ? QRegularExpression::NoPatternOption : QRegularExpression::CaseInsensitiveOption);
+
+    bool valid = rx.isValid();
+
+    m_rx = rx;
+    m_rx.optimize(); // compiled once here, not by the first pool thread while the others wait
+    m_exclude = exclude;
+    m_active = valid && !pattern.isEmpty();
+
+    rebuild();
+
+    return valid;
+}
+
+void FilterView::linesChanged(qint64 fromLine, qint64 endLine)
+{
+    Q_UNUSED(endLine);
+
+    if (!m_active || m_log->isAlternateScreenActive()) // the ids are of the alternate screen then
+    {
+        return;
+    }
+
+    const LineStore &store = m_log->lineStore();
+
+    dropLinesBefore(store.firstLineId());
+
+    // the changed lines are matched again, the ones above stay as they are
+
+    const qint64 from = qMax(fromLine, store.firstLineId());
+    m_ids.resize(int(std::lower_bound(m_ids.constBegin() + m_firstIndex, m_ids.constEnd(), from) - m_ids.constBegin()));
+
+    for (qint64 l = from; l < store.endLineId(); ++l)
+    {
+        if (lineMatches(m_rx, m_exclude, store.text(l)))
+        {
+            m_ids.append(l);
+        }
+    }
+
+    QScrollBar *bar = verticalScrollBar();
+    bool atBottom = bar->value() == bar->maximum();
+
+    updateScrollBars();
+
+    if (atBottom)
+    {
+        bar->setValue(bar->maximum());
+    }
+
+    viewport()->update();
+}
+
+void FilterView::rebuild()
+{
+    m_ids.clear();
+    m_firstIndex = 0;
+    m_maxWidth = 0;
+
+    if (m_active)
+    {
+        const LineStore &store = m_log->lineStore();
+        const qint64 first = store.firstLineId();
+        const qint64 end = store.endLineId();
+
+        QVector<int> indices(int((end - first + rangeLines - 1) / rangeLines));
+        for (int r = 0; r < indices.size(); ++r)
+        {
+            indices[r] = r;
+        }
+
+        // the store isn't modified while the GUI thread waits here, reading it from the pool is safe
+
+        QVector<QVector<qint64> > results(indices.size());
+        QVector<qint64> *out = results.data(); // detached, each thread writes its own element
+
+        const QRegularExpression rx = m_rx;
+        const bool exclude = m_exclude;
+
+        QtConcurrent::blockingMap(indices, [&store, &rx, exclude, first, end, out](const int &r)
+        {
+            QVector<qint64> &ids = out[r];
+
+            const qint64 rangeEnd = qMin(end, first + qint64(r + 1) * rangeLines);
+            for (qint64 l = first + qint64(r) * rangeLines; l < rangeEnd; ++l)
+            {
+                if (lineMatches(rx, exclude, store.text(l)))
+                {
+                    ids.append(l);
+                }
+            }
+        });
+
+        foreach (const QVector<qint64> &ids, results)
+        {
+            m_ids += ids;
+        }
+    }
+
+    updateScrollBars();
+    verticalScrollBar()->setValue(verticalScrollBar()->maximum());
+    viewport()->update();
+}
+
+void FilterView::linesDropped(qint64 firstLineId)
+{
+    if (!m_active || m_log->isAlternateScreenActive()) // the ids are of the alternate screen then
+    {
+        return;
+    }
+
+    // the rows of the dropped lines go, the ones shown stay in place
+
+    QScrollBar *bar = verticalScrollBar();
+    const int matches = matchCount();
+    const int value = bar->value();
+
+    dropLinesBefore(firstLineId);
+
+    updateScrollBars();
+    bar->setValue(value - (matches - matchCount()));
+
+    viewport()->update();
+}
+
+void FilterView::linesTrimmed()
+{
+    if (m_active)
+    {
+        rebuild(); // a trimmed line may match differently
+    }
+}
+
+void FilterView::dropLinesBefore(qint64 id)
+{
+    m_firstIndex = int(std::lower_bound(m_ids.constBegin() + m_firstIndex, m_ids.constEnd(), id) - m_ids.constBegin());
+
+    if (m_firstIndex > 1024 && m_firstIndex > m_ids.size() / 2)
+    {
+        m_ids.remove(0, m_firstIndex);
+        m_firstIndex = 0;
+    }
+}
+
+void FilterView::paintEvent(QPaintEvent *e)
+{
+    Q_UNUSED(e);
+
+    QPainter p(viewport());
+
+    const QFontMetrics &fm = fontMetrics();
+    const int charWidth = fm.width('0');
+    const int lineHeight = fm.height();
+
+    const QColor textColor = palette().color(QPalette::Text);
+    const QColor numberColor = palette().color(QPalette::Disabled, QPalette::Text);
+
+    p.translate(-horizontalScrollBar()->value(), 0);
+
+    const LineStore &store = m_log->lineStore();
+
+    const int firstRow = verticalScrollBar()->value();
+    const int rows = visibleRows() + 1; // the last one may be partially visible
+
+    int maxWidth = m_maxWidth;
+
+    for (int row = 0; row < rows && m_firstIndex + firstRow + row < m_ids.size(); ++row)
+    {
+        const qint64 id = m_ids.at(m_firstIndex + firstRow + row);
+        if (id < store.firstLineId() || id >= store.endLineId())
+        {
+            continue; // cleared since the last update
+        }
+
+        const int y = row * lineHeight + fm.ascent();
+
+        p.setPen(numberColor);
+        p.drawText(0, y, QString("%1").arg(id - store.firstLineId(), numberColumnChars - 1));
+
+        QString text = store.text(id);
+        text.replace('\t', "        ");
+
+        p.setPen(textColor);
+        p.drawText(numberColumnChars * charWidth, y, text);
+
+        maxWidth = qMax(maxWidth, (numberColumnChars + text.size()) * charWidth);
+    }
+
+    if (maxWidth > m_maxWidth)
+    {
+        m_maxWidth = maxWidth;
+        updateScrollBars();
+    }
+}
+
+void FilterView::resizeEvent(QResizeEvent *e)
+{
+    QAbstractScrollArea::resizeEvent(e);
+
+    updateScrollBars();
+}
+
+void FilterView::mouseDoubleClickEvent(QMouseEvent *e)
+{
+    const int ix = m_firstIndex + verticalScrollBar()->value() + e->pos().y() / fontMetrics().height();
+
+    if (ix < m_ids.size())
+    {
+        emit lineActivated(m_ids.at(ix));
+    }
+}
+
+void FilterView::updateScrollBars()
+{
+    int pageRows = visibleRows();
+
+    verticalScrollBar()->setPageStep(pageRows);
+    verticalScrollBar()->setRange(0, qMax(0, matchCount() - pageRows));
+
+    horizontalScrollBar()->setPageStep(viewport()->width());
+    horizontalScrollBar()->setRange(0, qMax(0, m_maxWidth - viewport()->width()));
+}
+
+int FilterView::visibleRows() const
+{
+    return qMax(1, viewport()->height() / fontMetrics().height());
+}
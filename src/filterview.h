@@ -0,0 +1,62 @@
+#ifndef FILTERVIEW_H
+#define FILTERVIEW_H
+
+#include "plaintextlog.h"
+
+#include <QAbstractScrollArea>
+#include <QRegularExpression>
+#include <QVector>
+
+//
+// grep over the log: the lines matching a regular expression (or not matching it, when excluding).
+//
+// The view keeps the ascending ids of the matching lines of the log's LineStore, not the text.
+// A new filter is applied to the whole log by the pool threads, a range of lines each; after that
+// only the lines reported by PlainTextLog::linesChanged() are matched: appended ones once,
+// the screen lines again when they change. The ids dropped from the head of the log are skipped
+// and compacted away from time to time; lines trimmed in place are all matched again.
+//
+
+class FilterView : public QAbstractScrollArea
+{
+    Q_OBJECT
+
+public:
+    explicit FilterView(PlainTextLog *log, QWidget *parent = 0);
+
+    static const int rangeLines = 16384; // per pool task of a rebuild
+
+    bool isActive() const; // a non-empty valid pattern is set
+    int matchCount() const;
+
+signals:
+    void lineActivated(qint64 line); // double-clicked
+
+public slots:
+    bool setFilter(const QString &pattern, bool exclude, bool caseSensitive); // false for an invalid pattern
+    void linesChanged(qint64 fromLine, qint64 endLine);
+    void linesDropped(qint64 firstLineId);
+    void linesTrimmed();
+
+protected:
+    void paintEvent(QPaintEvent *e);
+    void resizeEvent(QResizeEvent *e);
+    void mouseDoubleClickEvent(QMouseEvent *e);
+
+private:
+    void rebuild();
+    void dropLinesBefore(qint64 id);
+    void updateScrollBars();
+    int visibleRows() const;
+
+    PlainTextLog *m_log;
+    QRegularExpression m_rx;
+    bool m_exclude;
+    bool m_active;
+
+    QVector<qint64> m_ids; // ascending
+    int m_firstIndex;      // the ids before it are gone from the log
+    int m_maxWidth;        // of the rows painted so far, for the horizontal scroll bar
+};
+
+#endif // FILTERVIEW_H
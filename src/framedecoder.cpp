@@ -0,0 +1,383 @@
+#include "framedecoder.h"
+
+#include <QDateTime>
+
+#include <string.h>
+#include <zlib.h>
+
+static const char slipEnd = char(0xC0);
+static const char slipEsc = char(0xDB);
+static const char slipEscEnd = char(0xDC);
+static const char slipEscEsc = char(0xDD);
+
+static const char syncFirst = char(0xA5);
+static const char syncSecond = char(0x5A);
+
+static const char stx = 0x02;
+static const char etx = 0x03;
+
+// appends the text up to the mark, returns the mark or Q_NULLPTR if the text lasts till the end
+static const char *scanText(const char *p, const char *end, char mark, QByteArray *text)
+{
+    const char *found = static_cast<const char *>(memchr(p, mark, end - p));
+
+    text->append(p, (found ? found : end) - p);
+
+    return found;
+}
+
+FrameDecoder *FrameDecoder::create(FrameDecoder::Framing framing, bool checkCrc)
+{
+    switch (framing)
+    {
+    case Slip:
+        return new SlipDecoder(checkCrc);
+    case Cobs:
+        return new CobsDecoder(checkCrc, false);
+    case CobsPaired:
+        return new CobsDecoder(checkCrc, true);
+    case LengthPrefixed:
+        return new LengthPrefixedDecoder(checkCrc);
+    case Delimited:
+        return new DelimitedDecoder(checkCrc);
+    default:
+        return Q_NULLPTR;
+    }
+}
+
+FrameDecoder::FrameDecoder(bool checkCrc) :
+    m_checkCrc(checkCrc)
+{
+}
+
+FrameDecoder::~FrameDecoder()
+{
+}
+
+void FrameDecoder::finishFrame(QVector<FrameRecord> *frames, FrameRecord::Status status)
+{
+    FrameRecord record;
+    record.time = QDateTime::currentMSecsSinceEpoch();
+    record.status = status;
+    record.payload = m_payload;
+
+    if (status == FrameRecord::Ok && m_checkCrc)
+    {
+        const int size = record.payload.size() - 4;
+
+        if (size < 0)
+        {
+            record.status = FrameRecord::Malformed;
+        }
+        else
+        {
+            const uchar *crc = reinterpret_cast<const uchar *>(record.payload.constData()) + size;
+            const quint32 expected = crc[0] | (crc[1] << 8) | (crc[2] << 16) | (quint32(crc[3]) << 24);
+
+            const quint32 actual = crc32(0, reinterpret_cast<const Bytef *>(record.payload.constData()), size);
+
+            record.status = (actual == expected) ? FrameRecord::Ok : FrameRecord::BadCrc;
+            record.payload.chop(4);
+        }
+    }
+
+    frames->append(record);
+    m_payload.clear();
+}
+
+SlipDecoder::SlipDecoder(bool checkCrc) :
+    FrameDecoder(checkCrc),
+    m_state(Text)
+{
+}
+
+void SlipDecoder::decode(const QByteArray &data, QByteArray *text, QVector<FrameRecord> *frames)
+{
+    const char *p = data.constData();
+    const char *end = p + data.size();
+
+    while (p < end)
+    {
+        if (m_state == Text)
+        {
+            p = scanText(p, end, slipEnd, text);
+            if (!p)
+            {
+                break;
+            }
+
+            ++p;
+            m_state = Frame;
+            continue;
+        }
+
+        const char c = *p++;
+
+        if (m_state == Escape)
+        {
+            if (c == slipEscEnd)
+            {
+                m_payload.append(slipEnd);
+                m_state = Frame;
+            }
+            else if (c == slipEscEsc)
+            {
+                m_payload.append(slipEsc);
+                m_state = Frame;
+            }
+            else
+            {
+                finishFrame(frames, FrameRecord::Malformed);
+                m_state = Text;
+            }
+        }
+        else if (c == slipEnd)
+        {
+            // END END: the first one closed nothing (or the sender starts frames with END), keep receiving
+            if (!m_payload.isEmpty())
+            {
+                finishFrame(frames);
+                m_state = Text;
+            }
+        }
+        else if (c == slipEsc)
+        {
+            m_state = Escape;
+        }
+        else
+        {
+            m_payload.append(c);
+        }
+
+        if (m_payload.size() > maxFrameBytes)
+        {
+            finishFrame(frames, FrameRecord::Malformed);
+            m_state = Text;
+        }
+    }
+}
+
+CobsDecoder::CobsDecoder(bool checkCrc, bool paired) :
+    FrameDecoder(checkCrc),
+    m_paired(paired),
+    m_inFrame(!paired),
+    m_skipping(false)
+{
+}
+
+void CobsDecoder::decode(const QByteArray &data, QByteArray *text, QVector<FrameRecord> *frames)
+{
+    const char *p = data.constData();
+    const char *end = p + data.size();
+
+    while (p < end)
+    {
+        if (!m_inFrame)
+        {
+            p = scanText(p, end, 0, text);
+            if (!p)
+            {
+                break;
+            }
+
+            ++p;
+            m_inFrame = true;
+            continue;
+        }
+
+        const char *zero = static_cast<const char *>(memchr(p, 0, end - p));
+
+        if (m_skipping)
+        {
+            if (!zero)
+            {
+                break;
+            }
+
+            p = zero + 1;
+            m_skipping = false;
+            m_inFrame = !m_paired;
+            continue;
+        }
+
+        m_encoded.append(p, (zero ? zero : end) - p);
+
+        if (m_encoded.size() > maxFrameBytes)
+        {
+            m_encoded.clear();
+            finishFrame(frames, FrameRecord::Malformed);
+            m_skipping = true; // the rest of the oversized frame is dropped
+            continue;
+        }
+
+        if (!zero)
+        {
+            break;
+        }
+
+        p = zero + 1;
+
+        if (m_encoded.isEmpty())
+        {
+            continue; // two delimiters in a row: the second one starts the frame (paired), or an empty frame
+        }
+
+        bool ok = unstuff(m_encoded, &m_payload);
+        m_encoded.clear();
+
+        finishFrame(frames, ok ? FrameRecord::Ok : FrameRecord::Malformed);
+        m_inFrame = !m_paired;
+    }
+}
+
+bool CobsDecoder::unstuff(const QByteArray &encoded, QByteArray *decoded)
+{
+    const int n = encoded.size();
+    int i = 0;
+
+    while (i < n)
+    {
+        const int code = uchar(encoded.at(i));
+
+        if (code == 0 || i + code > n)
+        {
+            return false;
+        }
+
+        decoded->append(encoded.constData() + i + 1, code - 1);
+        i += code;
+
+        if (code < 0xFF && i < n)
+        {
+            decoded->append('\0');
+        }
+    }
+
+    return true;
+}
+
+LengthPrefixedDecoder::LengthPrefixedDecoder(bool checkCrc) :
+    FrameDecoder(checkCrc),
+    m_state(Text),
+    m_length(0)
+{
+}
+
+void LengthPrefixedDecoder::decode(const QByteArray &data, QByteArray *text, QVector<FrameRecord> *frames)
+{
+    const char *p = data.constData();
+    const char *end = p + data.size();
+
+    while (p < end)
+    {
+        switch (m_state)
+        {
+        case Text:
+            p = scanText(p, end, syncFirst, text);
+            if (!p)
+            {
+                return;
+            }
+
+            ++p;
+            m_state = Sync;
+            break;
+
+        case Sync:
+            if (*p == syncSecond)
+            {
+                ++p;
+                m_state = LengthLow;
+            }
+            else
+            {
+                text->append(syncFirst); // just a byte of the text, the current one is looked at again
+                m_state = Text;
+            }
+            break;
+
+        case LengthLow:
+            m_length = uchar(*p++);
+            m_state = LengthHigh;
+            break;
+
+        case LengthHigh:
+            m_length |= uchar(*p++) << 8;
+
+            if (m_length == 0)
+            {
+                finishFrame(frames);
+                m_state = Text;
+            }
+            else
+            {
+                m_state = Payload;
+            }
+            break;
+
+        case Payload:
+        {
+            const int take = qMin(int(end - p), m_length - m_payload.size());
+
+            m_payload.append(p, take);
+            p += take;
+
+            if (m_payload.size() == m_length)
+            {
+                finishFrame(frames);
+                m_state = Text;
+            }
+            break;
+        }
+        }
+    }
+}
+
+DelimitedDecoder::DelimitedDecoder(bool checkCrc) :
+    FrameDecoder(checkCrc),
+    m_inFrame(false)
+{
+}
+
+void DelimitedDecoder::decode(const QByteArray &data, QByteArray *text, QVector<FrameRecord> *frames)
+{
+    const char *p = data.constData();
+    const char *end = p + data.size();
+
+    while (p < end)
+    {
+        if (!m_inFrame)
+        {
+            p = scanText(p, end, stx, text);
+            if (!p)
+            {
+                break;
+            }
+
+            ++p;
+            m_inFrame = true;
+            continue;
+        }
+
+        const char *found = scanText(p, end, etx, &m_payload);
+
+        if (m_payload.size() > maxFrameBytes)
+        {
+            m_payload.truncate(maxFrameBytes);
+            finishFrame(frames, FrameRecord::Malformed);
+            m_inFrame = false;
+            p = found ? found + 1 : end;
+            continue;
+        }
+
+        if (!found)
+        {
+            break;
+        }
+
+        p = found + 1;
+
+        finishFrame(frames);
+        m_inFrame = false;
+    }
+}
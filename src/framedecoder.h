@@ -0,0 +1,127 @@
+#ifndef FRAMEDECODER_H
+#define FRAMEDECODER_H
+
+#include <QByteArray>
+#include <QVector>
+
+//
+// Splits binary frames out of the received stream, the console text around them goes on to the terminal.
+//
+// Framings (the frames are interleaved with plain text, so each one needs a start mark):
+//
+//     Slip           0xC0 <SLIP escaped payload> 0xC0
+//     CobsPaired     0x00 <COBS encoded payload> 0x00
+//     LengthPrefixed 0xA5 0x5A <length, 16 bit LE> <payload>
+//     Delimited      STX (0x02) <payload> ETX (0x03), no escaping
+//
+// Cobs is standard COBS, <COBS encoded payload> 0x00: the terminator is the only mark, so the whole
+// stream is frames and there is no text. CobsPaired is for consoles that mix text and COBS frames,
+// the sender puts a 0x00 before each frame as well.
+//
+// With the CRC check on, the last 4 bytes of a payload are the CRC32 (IEEE, as zlib computes it)
+// of the rest, little endian; the length of LengthPrefixed frames includes them.
+//
+// The text between the frames is scanned with memchr() for the next start mark and copied in spans,
+// so the decoder costs about as much as a copy of the stream.
+//
+
+struct FrameRecord
+{
+    enum Status
+    {
+        Ok,
+        BadCrc,
+        Malformed // broken encoding, too short for the CRC or too long
+    };
+
+    qint64 time; // ms since the epoch
+    Status status;
+    QByteArray payload; // without the CRC
+};
+
+class FrameDecoder
+{
+public:
+    enum Framing
+    {
+        NoFraming,
+        Slip,
+        Cobs,
+        CobsPaired,
+        LengthPrefixed,
+        Delimited
+    };
+
+    static const int maxFrameBytes = 64 * 1024;
+
+    static FrameDecoder *create(Framing framing, bool checkCrc); // Q_NULLPTR for NoFraming
+
+    virtual ~FrameDecoder();
+
+    // the bytes outside of the frames are appended to text
+    virtual void decode(const QByteArray &data, QByteArray *text, QVector<FrameRecord> *frames) = 0;
+
+protected:
+    explicit FrameDecoder(bool checkCrc);
+
+    void finishFrame(QVector<FrameRecord> *frames, FrameRecord::Status status = FrameRecord::Ok);
+
+    bool m_checkCrc;
+    QByteArray m_payload; // of the frame being received
+};
+
+class SlipDecoder : public FrameDecoder
+{
+public:
+    explicit SlipDecoder(bool checkCrc);
+
+    void decode(const QByteArray &data, QByteArray *text, QVector<FrameRecord> *frames);
+
+private:
+    enum State { Text, Frame, Escape };
+
+    State m_state;
+};
+
+class CobsDecoder : public FrameDecoder
+{
+public:
+    CobsDecoder(bool checkCrc, bool paired);
+
+    void decode(const QByteArray &data, QByteArray *text, QVector<FrameRecord> *frames);
+
+private:
+    static bool unstuff(const QByteArray &encoded, QByteArray *decoded);
+
+    bool m_paired;   // a 0x00 starts the frames, the text is in between
+    bool m_inFrame;
+    bool m_skipping; // the rest of an oversized frame, up to its 0x00
+    QByteArray m_encoded;
+};
+
+class LengthPrefixedDecoder : public FrameDecoder
+{
+public:
+    explicit LengthPrefixedDecoder(bool checkCrc);
+
+    void decode(const QByteArray &data, QByteArray *text, QVector<FrameRecord> *frames);
+
+private:
+    enum State { Text, Sync, LengthLow, LengthHigh, Payload };
+
+    State m_state;
+    int m_length;
+};
+
+class DelimitedDecoder : public FrameDecoder
+{
+public:
+    explicit DelimitedDecoder(bool checkCrc);
+
+    void decode(const QByteArray &data, QByteArray *text, QVector<FrameRecord> *frames);
+
+private:
+    bool m_inFrame;
+};
+
+#endif // FRAMEDECODER_H
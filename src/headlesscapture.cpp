@@ -0,0 +1,236 @@
+#include "headlesscapture.h"
+#include "portthreadpool.h"
+
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QSettings>
+
+#ifdef Q_OS_UNIX
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+static int s_signalFds[2] = { -1, -1 };
+
+static void terminationSignalHandler(int)
+{
+    char c = 1;
+    ssize_t r = ::write(s_signalFds[0], &c, sizeof(c));
+    Q_UNUSED(r);
+}
+#endif
+
+HeadlessCapture::HeadlessCapture(QObject *parent) :
+    QObject(parent),
+    m_port(new AsyncPort()),
+    m_writer(new CaptureWriter()),
+    m_scriptHost(new ScriptHost(m_port)),
+    m_reopenTimer(new QTimer(this)),
+    m_signalNotifier(Q_NULLPTR),
+    m_baudRate(0),
+    m_localShell(false)
+{
+    qRegisterMetaType<AsyncPort::Status>("AsyncPort::Status");
+    qRegisterMetaType<SerialTuning>("SerialTuning");
+
+    m_reopenTimer->setSingleShot(true);
+    m_reopenTimer->setInterval(1000);
+    connect(m_reopenTimer, SIGNAL(timeout()), this, SLOT(reopenPort()));
+
+    PortThreadPool::instance()->attach(m_port);
+    QMetaObject::invokeMethod(m_port, "initialize", Qt::QueuedConnection);
+    connect(m_port, SIGNAL(statusChanged(AsyncPort::Status,QString,qint32)), this, SLOT(updatePortStatus(AsyncPort::Status,QString,qint32)));
+    connect(m_port, SIGNAL(dataReceived(QByteArray,qint64)), m_writer, SLOT(write(QByteArray)));
+    connect(m_scriptHost, SIGNAL(message(QString)), this, SLOT(printScriptMessage(QString)));
+    connect(m_scriptHost, SIGNAL(finished(bool,QString)), this, SLOT(scriptFinished(bool,QString)));
+}
+
+HeadlessCapture::~HeadlessCapture()
+{
+    delete m_scriptHost; // stops the script, which may be using the port
+
+    QMetaObject::invokeMethod(m_port, "closePort", Qt::BlockingQueuedConnection);
+
+    PortThreadPool::instance()->detach(m_port);
+
+    if (m_writer->thread() == thread())
+    {
+        delete m_writer; // start() failed before handing it over
+    }
+    else
+    {
+        QMetaObject::invokeMethod(m_writer, "close", Qt::BlockingQueuedConnection);
+        m_writer->deleteLater();
+    }
+}
+
+bool HeadlessCapture::start(const QStringList &arguments)
+{
+    QSettings m_settings;
+
+    m_settings.beginGroup(QLatin1String("Port"));
+    QString defaultPortName = m_settings.value(QLatin1String("portName"), "").toString();
+    QString defaultBaudRate = m_settings.value(QLatin1String("baudRate"), QSerialPort::Baud115200).toString();
+    m_tuning.lowLatency = m_settings.value(QLatin1String("lowLatency"), false).toBool();
+    m_tuning.readBufferSize = m_settings.value(QLatin1String("lowLatencyReadBufferSize"), m_tuning.readBufferSize).toLongLong();
+    m_settings.endGroup();
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(tr("Captures a port to a file without a GUI."));
+    parser.addHelpOption();
+
+    QCommandLineOption headlessOption("headless", tr("Run without a GUI."));
+    QCommandLineOption portOption("port", tr("Serial port to capture (default: %1).").arg(defaultPortName), "name", defaultPortName);
+    QCommandLineOption baudOption("baud", tr("Baud rate (default: %1).").arg(defaultBaudRate), "rate", defaultBaudRate);
+    QCommandLineOption shellOption("shell", tr("Capture a local shell instead of a serial port."));
+    QCommandLineOption lowLatencyOption("low-latency", tr("Use the low latency serial mode."));
+    QCommandLineOption outOption("out", tr("Output file, '-' for stdout (default)."), "file", "-");
+    QCommandLineOption formatOption("format", tr("Output format: raw (default), plain or timestamped."), "format", "raw");
+    QCommandLineOption rotateSizeOption("rotate-size", tr("Start a new file after this many MiB."), "MiB", "0");
+    QCommandLineOption rotateTimeOption("rotate-time", tr("Start a new file after this many minutes."), "minutes", "0");
+    QCommandLineOption compressOption("compress", tr("gzip the rotated files."));
+    QCommandLineOption scriptOption("script", tr("Run an expect/send script, exit when it is done."), "file");
+
+    parser.addOption(headlessOption);
+    parser.addOption(portOption);
+    parser.addOption(baudOption);
+    parser.addOption(shellOption);
+    parser.addOption(lowLatencyOption);
+    parser.addOption(outOption);
+    parser.addOption(formatOption);
+    parser.addOption(rotateSizeOption);
+    parser.addOption(rotateTimeOption);
+    parser.addOption(compressOption);
+    parser.addOption(scriptOption);
+
+    parser.process(arguments); // exits on --help and unknown options
+
+    CaptureWriter::Format format;
+    if (!CaptureWriter::parseFormat(parser.value(formatOption), &format))
+    {
+        qDebug() << "ERROR Unknown format" << parser.value(formatOption);
+        return false;
+    }
+
+    bool ok = false;
+    m_portName = parser.value(portOption);
+    m_baudRate = parser.value(baudOption).toInt(&ok);
+    m_localShell = parser.isSet(shellOption);
+
+    if (parser.isSet(lowLatencyOption))
+    {
+        m_tuning.lowLatency = true;
+    }
+
+    if (!m_localShell && (m_portName.isEmpty() || !ok || m_baudRate <= 0))
+    {
+        qDebug() << "ERROR A serial port and a baud rate are required";
+        return false;
+    }
+
+    m_writer->setRotation(parser.value(rotateSizeOption).toLongLong() * 1024 * 1024,
+                          parser.value(rotateTimeOption).toInt() * 60,
+                          parser.isSet(compressOption));
+
+    QString error;
+    if (!m_writer->open(parser.value(outOption), format, &error))
+    {
+        qDebug() << "ERROR Can't open" << parser.value(outOption) << ":" << error;
+        return false;
+    }
+
+    // from now on the writer is only reached through queued calls
+    m_writer->moveToThread(CaptureWriter::writerThread());
+
+    installTerminationHandler();
+
+    reopenPort();
+
+    if (parser.isSet(scriptOption) && !m_scriptHost->start(parser.value(scriptOption)))
+    {
+        return false;
+    }
+
+    return true;
+}
+
+void HeadlessCapture::updatePortStatus(AsyncPort::Status st, const QString &pn, qint32 br)
+{
+    qDebug() << "port" << pn << br << AsyncPort::convertStatusToQString(st);
+
+    if (st == AsyncPort::Disconnected || st == AsyncPort::Error)
+    {
+        QMetaObject::invokeMethod(m_writer, "flush", Qt::QueuedConnection);
+        m_reopenTimer->start();
+    }
+}
+
+void HeadlessCapture::reopenPort()
+{
+    if (m_localShell)
+    {
+        QMetaObject::invokeMethod(m_port, "openLocalShell", Qt::QueuedConnection);
+    }
+    else
+    {
+        QMetaObject::invokeMethod(m_port, "setSerialTuning", Qt::QueuedConnection, Q_ARG(SerialTuning, m_tuning));
+        QMetaObject::invokeMethod(m_port, "openSerialPort", Qt::QueuedConnection, Q_ARG(QString, m_portName), Q_ARG(qint32, m_baudRate));
+    }
+}
+
+void HeadlessCapture::handleTerminationSignal()
+{
+#ifdef Q_OS_UNIX
+    char c;
+    ssize_t r = ::read(s_signalFds[1], &c, sizeof(c));
+    Q_UNUSED(r);
+#endif
+
+    qDebug() << "terminating";
+
+    QCoreApplication::quit();
+}
+
+void HeadlessCapture::printScriptMessage(const QString &text)
+{
+    qDebug() << "script:" << qPrintable(text);
+}
+
+void HeadlessCapture::scriptFinished(bool ok, const QString &error)
+{
+    if (ok)
+    {
+        qDebug() << "script finished";
+    }
+    else
+    {
+        qDebug() << "ERROR script failed:" << qPrintable(error);
+    }
+
+    QCoreApplication::exit(ok ? 0 : 1);
+}
+
+void HeadlessCapture::installTerminationHandler()
+{
+#ifdef Q_OS_UNIX
+    // the capture has to be flushed on SIGINT/SIGTERM, the handler just wakes up the event loop
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, s_signalFds) < 0)
+    {
+        qDebug() << "Warning: can't install signal handlers";
+        return;
+    }
+
+    m_signalNotifier = new QSocketNotifier(s_signalFds[1], QSocketNotifier::Read, this);
+    connect(m_signalNotifier, SIGNAL(activated(int)), this, SLOT(handleTerminationSignal()));
+
+    struct sigaction sa;
+    sa.sa_handler = terminationSignalHandler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+
+    sigaction(SIGINT, &sa, Q_NULLPTR);
+    sigaction(SIGTERM, &sa, Q_NULLPTR);
+    sigaction(SIGHUP, &sa, Q_NULLPTR);
+#endif
+}
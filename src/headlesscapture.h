@@ -0,0 +1,53 @@
+#ifndef HEADLESSCAPTURE_H
+#define HEADLESSCAPTURE_H
+
+#include "asyncserialport.h"
+#include "capturewriter.h"
+#include "scripthost.h"
+
+#include <QCoreApplication>
+#include <QSocketNotifier>
+#include <QTimer>
+
+//
+// qminicom --headless: no widgets, just a port and a capture file.
+//
+// The port defaults come from the same QSettings the GUI uses. A port that goes away
+// (USB adapter unplugged, board power-cycled) is reopened once per second.
+//
+// With --script the capture runs until the script is done, the exit code tells whether it succeeded.
+//
+
+class HeadlessCapture : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit HeadlessCapture(QObject *parent = 0);
+    ~HeadlessCapture();
+
+    bool start(const QStringList &arguments);
+
+private slots:
+    void updatePortStatus(AsyncPort::Status st, const QString &pn, qint32 br);
+    void reopenPort();
+    void handleTerminationSignal();
+    void printScriptMessage(const QString &text);
+    void scriptFinished(bool ok, const QString &error);
+
+private:
+    void installTerminationHandler();
+
+    AsyncPort *m_port; // lives in one of the PortThreadPool threads
+    CaptureWriter *m_writer; // lives in CaptureWriter::writerThread() once started
+    ScriptHost *m_scriptHost;
+    QTimer *m_reopenTimer;
+    QSocketNotifier *m_signalNotifier;
+
+    QString m_portName;
+    qint32 m_baudRate;
+    bool m_localShell;
+    SerialTuning m_tuning;
+};
+
+#endif // HEADLESSCAPTURE_H
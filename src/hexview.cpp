@@ -0,0 +1,291 @@
+#include "hexview.h"
+
+#include <QFontDatabase>
+#include <QPainter>
+#include <QScrollBar>
+
+#include <algorithm>
+
+static const int maxChunkSize = 64 * 1024;
+static const int offsetColumnChars = 10;  // 8 hex digits + 2 spaces
+static const int hexColumnChars = HexView::bytesPerRow * 3 + 1; // "xx " per byte, extra space in the middle
+static const int rowChars = offsetColumnChars + hexColumnChars + 1 + HexView::bytesPerRow;
+
+HexView::HexView(QWidget *parent) :
+    QAbstractScrollArea(parent),
+    m_size(0),
+    m_firstLineId(0),
+    m_indexStart(0),
+    m_lineIndexing(true),
+    m_syncing(false)
+{
+    setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+
+    verticalScrollBar()->setSingleStep(1);
+    horizontalScrollBar()->setSingleStep(fontMetrics().width('0'));
+
+    connect(verticalScrollBar(), SIGNAL(valueChanged(int)), this, SLOT(scrolled(int)));
+
+    updateScrollBars();
+}
+
+qint64 HexView::size() const
+{
+    return m_size;
+}
+
+qint64 HexView::offsetOfLine(qint64 line) const
+{
+    const qint64 n = line - m_firstLineId; // the line breaks before the line
+
+    if (!m_lineIndexing || n < 0)
+    {
+        return -1;
+    }
+
+    if (n == 0)
+    {
+        return m_indexStart;
+    }
+
+    if (n > m_newlineOffsets.size())
+    {
+        return m_size;
+    }
+
+    return m_newlineOffsets.at(int(n - 1)) + 1;
+}
+
+qint64 HexView::lineAtOffset(qint64 offset) const
+{
+    if (!m_lineIndexing || offset < m_indexStart)
+    {
+        return -1;
+    }
+
+    // the first line + the line breaks before the offset
+    return m_firstLineId + (std::lower_bound(m_newlineOffsets.constBegin(), m_newlineOffsets.constEnd(), offset) - m_newlineOffsets.constBegin());
+}
+
+bool HexView::isLineIndexing() const
+{
+    return m_lineIndexing;
+}
+
+void HexView::setLineIndexing(bool indexing, qint64 lineId)
+{
+    if (indexing == m_lineIndexing)
+    {
+        return;
+    }
+
+    m_lineIndexing = indexing;
+    m_newlineOffsets.clear();
+    m_firstLineId = lineId;
+    m_indexStart = m_size;
+}
+
+void HexView::appendReceived(const QByteArray &bytes)
+{
+    int ix = m_lineIndexing ? bytes.indexOf('\n') : -1;
+    while (ix >= 0)
+    {
+        m_newlineOffsets.append(m_size + ix);
+        ix = bytes.indexOf('\n', ix + 1);
+    }
+
+    append(bytes, Received);
+}
+
+void HexView::appendSent(const QByteArray &bytes)
+{
+    append(bytes, Sent);
+}
+
+void HexView::clear(qint64 firstLineId)
+{
+    m_chunks.clear();
+    m_newlineOffsets.clear();
+    m_size = 0;
+    m_firstLineId = firstLineId;
+    m_indexStart = 0;
+
+    updateScrollBars();
+    viewport()->update();
+}
+
+void HexView::scrollToLine(qint64 line)
+{
+    QScrollBar *bar = verticalScrollBar();
+    const qint64 offset = offsetOfLine(line);
+
+    if (offset < 0 || lineAtOffset(qint64(bar->value()) * bytesPerRow) == line)
+    {
+        return; // the top row already belongs to the line, don't fight the user scrolling the dump
+    }
+
+    m_syncing = true;
+    bar->setValue(int(offset / bytesPerRow));
+    m_syncing = false;
+}
+
+void HexView::paintEvent(QPaintEvent *e)
+{
+    Q_UNUSED(e);
+
+    QPainter p(viewport());
+
+    const QFontMetrics &fm = fontMetrics();
+    const int charWidth = fm.width('0');
+    const int lineHeight = fm.height();
+
+    const QColor receivedColor = palette().color(QPalette::Text);
+    const QColor sentColor = QColor(0x2060C0);
+    const QColor offsetColor = palette().color(QPalette::Disabled, QPalette::Text);
+
+    p.translate(-horizontalScrollBar()->value(), 0);
+
+    qint64 firstRow = verticalScrollBar()->value();
+    int rows = visibleRows() + 1; // the last one may be partially visible
+
+    int chunkIx = chunkAt(firstRow * bytesPerRow);
+
+    for (int row = 0; row < rows; ++row)
+    {
+        qint64 rowOffset = (firstRow + row) * bytesPerRow;
+        if (rowOffset >= m_size || chunkIx < 0)
+        {
+            break;
+        }
+
+        int y = row * lineHeight + fm.ascent();
+
+        p.setPen(offsetColor);
+        p.drawText(0, y, QString("%1").arg(rowOffset, 8, 16, QChar('0')));
+
+        for (int col = 0; col < bytesPerRow; ++col)
+        {
+            qint64 offset = rowOffset + col;
+            if (offset >= m_size)
+            {
+                break;
+            }
+
+            while (offset >= m_chunks.at(chunkIx).offset + m_chunks.at(chunkIx).bytes.size())
+            {
+                chunkIx++;
+            }
+
+            const Chunk &chunk = m_chunks.at(chunkIx);
+            unsigned char c = chunk.bytes.at(offset - chunk.offset);
+
+            p.setPen(chunk.direction == Sent ? sentColor : receivedColor);
+
+            int hexX = (offsetColumnChars + col * 3 + (col >= bytesPerRow / 2 ? 1 : 0)) * charWidth;
+            p.drawText(hexX, y, QString("%1").arg(c, 2, 16, QChar('0')));
+
+            int asciiX = (offsetColumnChars + hexColumnChars + 1 + col) * charWidth;
+            p.drawText(asciiX, y, QString(QChar(c >= 0x20 && c < 0x7F ? c : '.')));
+        }
+    }
+}
+
+void HexView::resizeEvent(QResizeEvent *e)
+{
+    QAbstractScrollArea::resizeEvent(e);
+
+    updateScrollBars();
+}
+
+void HexView::scrolled(int value)
+{
+    const qint64 line = lineAtOffset(qint64(value) * bytesPerRow);
+
+    if (!m_syncing && line >= 0)
+    {
+        emit topLineChanged(line);
+    }
+
+    viewport()->update();
+}
+
+void HexView::append(const QByteArray &bytes, HexView::Direction direction)
+{
+    if (bytes.isEmpty())
+    {
+        return;
+    }
+
+    QScrollBar *bar = verticalScrollBar();
+    bool atBottom = bar->value() == bar->maximum();
+
+    if (!m_chunks.isEmpty() && m_chunks.last().direction == direction && m_chunks.last().bytes.size() < maxChunkSize)
+    {
+        m_chunks.last().bytes += bytes;
+    }
+    else
+    {
+        Chunk chunk;
+        chunk.offset = m_size;
+        chunk.direction = direction;
+        chunk.bytes = bytes;
+        m_chunks.append(chunk);
+    }
+
+    m_size += bytes.size();
+
+    updateScrollBars();
+
+    if (atBottom)
+    {
+        bar->setValue(bar->maximum());
+    }
+
+    viewport()->update();
+}
+
+int HexView::chunkAt(qint64 offset) const
+{
+    if (offset < 0 || offset >= m_size)
+    {
+        return -1;
+    }
+
+    // last chunk starting at or before the offset
+
+    int lo = 0;
+    int hi = m_chunks.size() - 1;
+
+    while (lo < hi)
+    {
+        int mid = (lo + hi + 1) / 2;
+        if (m_chunks.at(mid).offset <= offset)
+        {
+            lo = mid;
+        }
+        else
+        {
+            hi = mid - 1;
+        }
+    }
+
+    return lo;
+}
+
+void HexView::updateScrollBars()
+{
+    qint64 rows = (m_size + bytesPerRow - 1) / bytesPerRow;
+    int pageRows = visibleRows();
+
+    verticalScrollBar()->setPageStep(pageRows);
+    verticalScrollBar()->setRange(0, qMax(Q_INT64_C(0), rows - pageRows));
+
+    int rowWidth = rowChars * fontMetrics().width('0');
+    horizontalScrollBar()->setPageStep(viewport()->width());
+    horizontalScrollBar()->setRange(0, qMax(0, rowWidth - viewport()->width()));
+}
+
+int HexView::visibleRows() const
+{
+    return qMax(1, viewport()->height() / fontMetrics().height());
+}
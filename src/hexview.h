@@ -0,0 +1,84 @@
+#ifndef HEXVIEW_H
+#define HEXVIEW_H
+
+#include <QAbstractScrollArea>
+#include <QByteArray>
+#include <QVector>
+
+//
+// Hex dump of everything received and sent: offset, hex and ASCII columns,
+// sent bytes in a different colour.
+//
+// The stream is kept as a list of chunks (consecutive chunks of the same direction are merged)
+// and only the rows in the viewport are formatted on paint, so the size of the capture
+// doesn't matter for the scrolling and painting speed.
+//
+// Offsets of the received '\n' are indexed to map the terminal lines onto the dump and back.
+// The lines are the ids of the log's LineStore: the stream starts in the line set by clear(),
+// so clearing the head of the log doesn't shift the mapping.
+//
+// While frames are split out of the stream its '\n' are not the log's, so indexing is turned off
+// (no mapping, -1) and restarts at the current end of the dump when it is turned back on.
+//
+
+class HexView : public QAbstractScrollArea
+{
+    Q_OBJECT
+
+public:
+    enum Direction
+    {
+        Received,
+        Sent
+    };
+
+    explicit HexView(QWidget *parent = 0);
+
+    static const int bytesPerRow = 16;
+
+    qint64 size() const;
+    qint64 offsetOfLine(qint64 line) const;   // -1 if not mapped
+    qint64 lineAtOffset(qint64 offset) const; // -1 if not mapped
+
+    bool isLineIndexing() const;
+    void setLineIndexing(bool indexing, qint64 lineId); // lineId: the line the next received bytes go to
+
+signals:
+    void topLineChanged(qint64 line); // terminal line shown at the top of the dump, follows user scrolling
+
+public slots:
+    void appendReceived(const QByteArray &bytes);
+    void appendSent(const QByteArray &bytes);
+    void clear(qint64 firstLineId = 0);
+    void scrollToLine(qint64 line);
+
+protected:
+    void paintEvent(QPaintEvent *e);
+    void resizeEvent(QResizeEvent *e);
+
+private slots:
+    void scrolled(int value);
+
+private:
+    struct Chunk
+    {
+        qint64 offset;
+        Direction direction;
+        QByteArray bytes;
+    };
+
+    void append(const QByteArray &bytes, Direction direction);
+    int chunkAt(qint64 offset) const;
+    void updateScrollBars();
+    int visibleRows() const;
+
+    QVector<Chunk> m_chunks;
+    qint64 m_size;
+    QVector<qint64> m_newlineOffsets; // received '\n' only, ascending
+    qint64 m_firstLineId;             // the line the stream starts in, or the indexing restarted in
+    qint64 m_indexStart;              // the offset m_firstLineId starts at
+    bool m_lineIndexing;
+    bool m_syncing;
+};
+
+#endif // HEXVIEW_H
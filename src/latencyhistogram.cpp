@@ -0,0 +1,85 @@
+#include "latencyhistogram.h"
+
+#include <QStringList>
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+void LatencyHistogram::add(qint64 us)
+{
+    if (us < 0)
+    {
+        us = 0;
+    }
+
+    int ix = 0;
+    while (ix < bucketCount - 1 && us > bucketUpperBound(ix))
+    {
+        ix++;
+    }
+
+    m_buckets[ix]++;
+    m_count++;
+    m_max = qMax(m_max, us);
+}
+
+void LatencyHistogram::reset()
+{
+    for (int i = 0; i < bucketCount; ++i)
+    {
+        m_buckets[i] = 0;
+    }
+    m_count = 0;
+    m_max = 0;
+}
+
+qint64 LatencyHistogram::count() const
+{
+    return m_count;
+}
+
+qint64 LatencyHistogram::max() const
+{
+    return m_max;
+}
+
+qint64 LatencyHistogram::bucket(int ix) const
+{
+    Q_ASSERT(ix >= 0 && ix < bucketCount);
+    return m_buckets[ix];
+}
+
+qint64 LatencyHistogram::bucketUpperBound(int ix)
+{
+    return Q_INT64_C(1) << ix;
+}
+
+QString LatencyHistogram::toString() const
+{
+    if (!m_count)
+    {
+        return QString();
+    }
+
+    QStringList lines;
+
+    for (int i = 0; i < bucketCount; ++i)
+    {
+        if (!m_buckets[i])
+        {
+            continue;
+        }
+
+        bool overflow = (i == bucketCount - 1);
+        qint64 bound = bucketUpperBound(overflow ? i - 1 : i);
+        QString label = (bound >= 1000) ? QString("%1ms").arg(bound / 1000.0, 0, 'f', 1) : QString("%1us").arg(bound);
+        label.prepend(overflow ? ">" : "<=");
+        lines << QString("%1: %2 (%3%)").arg(label, 10).arg(m_buckets[i]).arg(100.0 * m_buckets[i] / m_count, 0, 'f', 1);
+    }
+
+    lines << QString("max: %1us, samples: %2").arg(m_max).arg(m_count);
+
+    return lines.join("\n");
+}
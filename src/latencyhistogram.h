@@ -0,0 +1,30 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <QString>
+#include <QtGlobal>
+
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    static const int bucketCount = 21; // 1us .. ~1s, power-of-two buckets
+
+    void add(qint64 us);
+    void reset();
+
+    qint64 count() const;
+    qint64 max() const;
+    qint64 bucket(int ix) const;
+    static qint64 bucketUpperBound(int ix);
+
+    QString toString() const;
+
+private:
+    qint64 m_buckets[bucketCount];
+    qint64 m_count;
+    qint64 m_max;
+};
+
+#endif // LATENCYHISTOGRAM_H
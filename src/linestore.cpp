@@ -0,0 +1,559 @@
+#include "linestore.h"
+
+#include <QtConcurrent/QtConcurrentMap>
+#include <QtConcurrent/QtConcurrentRun>
+
+static void deleteChunks(QList<LineChunk> *chunks)
+{
+    delete chunks;
+}
+
+LogLine::LogLine() :
+    revision(0)
+{
+}
+
+TextAttr LogLine::attrAt(int index) const
+{
+    for (int i = runs.size() - 1; i >= 0; --i)
+    {
+        if (runs.at(i).start <= index)
+        {
+            return runs.at(i).attr;
+        }
+    }
+
+    return defaultTextAttr;
+}
+
+void LogLine::write(int index, const QString &str, TextAttr attr)
+{
+    if (str.isEmpty())
+    {
+        return;
+    }
+
+    if (index > text.size())
+    {
+        int from = text.size();
+        text += QString(index - from, ' ');
+        setAttr(from, index, attr);
+    }
+
+    text.replace(index, qMin(text.size() - index, str.size()), str);
+    setAttr(index, index + str.size(), attr);
+}
+
+void LogLine::truncate(int index)
+{
+    if (index >= text.size())
+    {
+        return;
+    }
+
+    text.truncate(index);
+
+    while (!runs.isEmpty() && runs.last().start >= index)
+    {
+        runs.removeLast();
+    }
+}
+
+void LogLine::clear()
+{
+    text.clear();
+    runs.clear();
+}
+
+void LogLine::setAttr(int from, int to, TextAttr attr)
+{
+    // the text is already there, [from, to) gets the new attribute
+
+    TextAttr after = attrAt(to);
+
+    QVector<AttrRun> result;
+    result.reserve(runs.size() + 2);
+
+    for (int i = 0; i < runs.size() && runs.at(i).start < from; ++i)
+    {
+        result.append(runs.at(i));
+    }
+
+    AttrRun run;
+    run.start = from;
+    run.attr = attr;
+    result.append(run);
+
+    if (to < text.size())
+    {
+        run.start = to;
+        run.attr = after;
+        result.append(run);
+
+        for (int i = 0; i < runs.size(); ++i)
+        {
+            if (runs.at(i).start > to)
+            {
+                result.append(runs.at(i));
+            }
+        }
+    }
+
+    // drop the runs that don't change anything
+
+    runs.clear();
+
+    for (int i = 0; i < result.size(); ++i)
+    {
+        if (runs.isEmpty() || runs.last().attr != result.at(i).attr)
+        {
+            runs.append(result.at(i));
+        }
+    }
+
+    runs[0].start = 0; // there is no text without a run
+}
+
+LineChunk::LineChunk() :
+    d(new LineChunkData())
+{
+    d->lineStarts.append(0);
+    d->runStarts.append(0);
+}
+
+int LineChunk::lineCount() const
+{
+    return d->lineStarts.size() - 1;
+}
+
+LogLine LineChunk::line(int ix) const
+{
+    Q_ASSERT(ix >= 0 && ix < lineCount());
+
+    int start = d->lineStarts.at(ix);
+
+    LogLine line;
+    line.text = d->text.mid(start, d->lineStarts.at(ix + 1) - start);
+    line.revision = LogLine::frozenRevision;
+
+    int firstRun = d->runStarts.at(ix);
+    int endRun = d->runStarts.at(ix + 1);
+
+    line.runs.reserve(endRun - firstRun);
+
+    for (int i = firstRun; i < endRun; ++i)
+    {
+        AttrRun run = d->runs.at(i);
+        run.start -= start;
+        line.runs.append(run);
+    }
+
+    return line;
+}
+
+QString LineChunk::text(int ix) const
+{
+    Q_ASSERT(ix >= 0 && ix < lineCount());
+
+    int start = d->lineStarts.at(ix);
+    return d->text.mid(start, d->lineStarts.at(ix + 1) - start);
+}
+
+QStringRef LineChunk::textRef(int ix) const
+{
+    Q_ASSERT(ix >= 0 && ix < lineCount());
+
+    int start = d->lineStarts.at(ix);
+    return QStringRef(&d->text, start, d->lineStarts.at(ix + 1) - start);
+}
+
+qint64 LineChunk::memoryBytes() const
+{
+    return sizeof(LineChunkData)
+            + qint64(d->text.capacity()) * sizeof(QChar)
+            + qint64(d->lineStarts.capacity()) * sizeof(int)
+            + qint64(d->runs.capacity()) * sizeof(AttrRun)
+            + qint64(d->runStarts.capacity()) * sizeof(int);
+}
+
+void LineChunk::append(const LogLine &line)
+{
+    int start = d->text.size();
+
+    d->text += line.text;
+
+    foreach (AttrRun run, line.runs)
+    {
+        run.start += start;
+        d->runs.append(run);
+    }
+
+    d->lineStarts.append(d->text.size());
+    d->runStarts.append(d->runs.size());
+}
+
+LogLine LineChunk::takeLast()
+{
+    int ix = lineCount() - 1;
+    LogLine last = line(ix);
+
+    d->text.truncate(d->lineStarts.at(ix));
+    d->runs.resize(d->runStarts.at(ix));
+    d->lineStarts.removeLast();
+    d->runStarts.removeLast();
+
+    return last;
+}
+
+void LineChunk::squeeze()
+{
+    d->text.squeeze();
+    d->lineStarts.squeeze();
+    d->runs.squeeze();
+    d->runStarts.squeeze();
+}
+
+LineStore::LineStore() :
+    m_firstLineId(0),
+    m_firstChunkSkip(0),
+    m_frozenLines(0),
+    m_revision(0)
+{
+}
+
+qint64 LineStore::firstLineId() const
+{
+    return m_firstLineId;
+}
+
+qint64 LineStore::endLineId() const
+{
+    return m_firstLineId + m_frozenLines + m_tail.size();
+}
+
+qint64 LineStore::lineCount() const
+{
+    return m_frozenLines + m_tail.size();
+}
+
+qint64 LineStore::editableLineId() const
+{
+    return m_firstLineId + m_frozenLines;
+}
+
+LogLine LineStore::line(qint64 id) const
+{
+    Q_ASSERT(id >= m_firstLineId && id < endLineId());
+
+    if (id >= editableLineId())
+    {
+        return m_tail.at(id - editableLineId());
+    }
+
+    qint64 ix = id - m_firstLineId + m_firstChunkSkip;
+    return m_chunks.at(ix / chunkLines).line(ix % chunkLines);
+}
+
+QString LineStore::text(qint64 id) const
+{
+    Q_ASSERT(id >= m_firstLineId && id < endLineId());
+
+    if (id >= editableLineId())
+    {
+        return m_tail.at(id - editableLineId()).text;
+    }
+
+    qint64 ix = id - m_firstLineId + m_firstChunkSkip;
+    return m_chunks.at(ix / chunkLines).text(ix % chunkLines);
+}
+
+QStringRef LineStore::textRef(qint64 id) const
+{
+    Q_ASSERT(id >= m_firstLineId && id < endLineId());
+
+    if (id >= editableLineId())
+    {
+        return QStringRef(&m_tail.at(id - editableLineId()).text);
+    }
+
+    qint64 ix = id - m_firstLineId + m_firstChunkSkip;
+    return m_chunks.at(ix / chunkLines).textRef(ix % chunkLines);
+}
+
+quint32 LineStore::revision(qint64 id) const
+{
+    Q_ASSERT(id >= m_firstLineId && id < endLineId());
+
+    if (id >= editableLineId())
+    {
+        return m_tail.at(id - editableLineId()).revision;
+    }
+
+    return LogLine::frozenRevision;
+}
+
+LogLine &LineStore::editableLine(qint64 id)
+{
+    Q_ASSERT(id >= editableLineId() && id < endLineId());
+
+    LogLine &line = m_tail[id - editableLineId()];
+    line.revision = nextRevision(); // the caller is about to change it
+
+    return line;
+}
+
+void LineStore::appendLine()
+{
+    LogLine line;
+    line.revision = nextRevision();
+
+    m_tail.append(line);
+}
+
+void LineStore::clearLines(qint64 from, qint64 to)
+{
+    Q_ASSERT(from >= editableLineId() && to <= endLineId());
+
+    for (qint64 id = from; id < to; ++id)
+    {
+        editableLine(id).clear();
+    }
+}
+
+void LineStore::rotateLines(qint64 from, qint64 to, int count)
+{
+    Q_ASSERT(from >= editableLineId() && to <= endLineId() && from <= to);
+
+    const int size = to - from;
+
+    if (qAbs(count) >= size)
+    {
+        clearLines(from, to);
+        return;
+    }
+
+    const int first = from - editableLineId();
+    const int last = to - 1 - editableLineId();
+
+    for (int i = 0; i < qAbs(count); ++i)
+    {
+        if (count > 0)
+        {
+            m_tail.move(first, last);
+        }
+        else
+        {
+            m_tail.move(last, first);
+        }
+    }
+
+    if (count > 0)
+    {
+        clearLines(to - count, to);
+    }
+    else
+    {
+        clearLines(from, from - count);
+    }
+
+    // the lines have new ids
+
+    for (int i = first; i <= last; ++i)
+    {
+        m_tail[i].revision = nextRevision();
+    }
+}
+
+void LineStore::removeLastLine()
+{
+    Q_ASSERT(!m_tail.isEmpty());
+
+    m_tail.removeLast();
+}
+
+void LineStore::freezeLinesBefore(qint64 id)
+{
+    while (editableLineId() < id && !m_tail.isEmpty())
+    {
+        if (m_chunks.isEmpty() || m_chunks.last().lineCount() == chunkLines)
+        {
+            m_chunks.append(LineChunk());
+        }
+
+        LineChunk &chunk = m_chunks.last();
+        chunk.append(m_tail.takeFirst());
+        m_frozenLines++;
+
+        if (chunk.lineCount() == chunkLines)
+        {
+            chunk.squeeze();
+        }
+    }
+}
+
+void LineStore::unfreezeLinesFrom(qint64 id)
+{
+    id = qMax(id, m_firstLineId);
+
+    while (editableLineId() > id)
+    {
+        LineChunk &chunk = m_chunks.last();
+
+        LogLine line = chunk.takeLast();
+        line.revision = nextRevision();
+        m_tail.prepend(line);
+        m_frozenLines--;
+
+        if (chunk.lineCount() == 0)
+        {
+            m_chunks.removeLast();
+        }
+    }
+}
+
+void LineStore::dropLinesBefore(qint64 id)
+{
+    if (id <= m_firstLineId)
+    {
+        return;
+    }
+
+    id = qMin(id, endLineId());
+
+    if (id >= editableLineId())
+    {
+        // all the frozen lines and the head of the tail
+
+        for (qint64 l = editableLineId(); l < id; ++l)
+        {
+            m_tail.removeFirst();
+        }
+
+        releaseChunks(m_chunks);
+        m_firstChunkSkip = 0;
+        m_frozenLines = 0;
+        m_firstLineId = id;
+
+        return;
+    }
+
+    // whole chunks go, the rest of the first one is skipped
+
+    qint64 drop = id - m_firstLineId;
+    qint64 skip = m_firstChunkSkip + drop;
+    int chunks = skip / chunkLines;
+
+    QList<LineChunk> dropped;
+    for (int i = 0; i < chunks; ++i)
+    {
+        dropped.append(m_chunks.takeFirst());
+    }
+    releaseChunks(dropped);
+
+    m_firstChunkSkip = skip % chunkLines;
+    m_frozenLines -= drop;
+    m_firstLineId = id;
+}
+
+void LineStore::transformLines(const std::function<void (LogLine &)> &transform)
+{
+    // the chunks are independent, each one is rebuilt by a pool thread
+
+    QVector<int> indices(m_chunks.size());
+    for (int c = 0; c < indices.size(); ++c)
+    {
+        indices[c] = c;
+    }
+
+    const QList<LineChunk> chunks = m_chunks;
+    const int firstChunkSkip = m_firstChunkSkip;
+
+    QVector<LineChunk> rebuilt(chunks.size());
+    LineChunk *out = rebuilt.data(); // detached, each thread writes its own element
+
+    QtConcurrent::blockingMap(indices, [&chunks, firstChunkSkip, &transform, out](const int &c)
+    {
+        const LineChunk &chunk = chunks.at(c);
+        LineChunk result;
+
+        for (int i = 0; i < chunk.lineCount(); ++i)
+        {
+            LogLine line = chunk.line(i);
+            if (c > 0 || i >= firstChunkSkip)
+            {
+                transform(line);
+            }
+            result.append(line); // the skipped lines are kept to preserve the chunk boundaries
+        }
+
+        if (result.lineCount() == chunkLines)
+        {
+            result.squeeze();
+        }
+
+        out[c] = result;
+    });
+
+    QList<LineChunk> replaced = rebuilt.toList();
+    m_chunks.swap(replaced);
+    releaseChunks(replaced);
+
+    for (int i = 0; i < m_tail.size(); ++i)
+    {
+        transform(m_tail[i]);
+        m_tail[i].revision = nextRevision();
+    }
+}
+
+void LineStore::clear()
+{
+    // ids are never reused
+    m_firstLineId = endLineId();
+
+    releaseChunks(m_chunks);
+    m_tail.clear();
+    m_firstChunkSkip = 0;
+    m_frozenLines = 0;
+}
+
+qint64 LineStore::memoryBytes() const
+{
+    qint64 bytes = 0;
+
+    foreach (const LineChunk &chunk, m_chunks)
+    {
+        bytes += chunk.memoryBytes();
+    }
+
+    foreach (const LogLine &line, m_tail)
+    {
+        bytes += sizeof(LogLine) + qint64(line.text.capacity()) * sizeof(QChar) + qint64(line.runs.capacity()) * sizeof(AttrRun);
+    }
+
+    return bytes;
+}
+
+void LineStore::releaseChunks(QList<LineChunk> &chunks)
+{
+    if (chunks.isEmpty())
+    {
+        return;
+    }
+
+    // a multi-gigabyte scrollback takes a while to free, don't block the GUI thread with it
+
+    QList<LineChunk> *released = new QList<LineChunk>();
+    released->swap(chunks);
+
+    QtConcurrent::run(deleteChunks, released);
+}
+
+quint32 LineStore::nextRevision()
+{
+    if (++m_revision == LogLine::frozenRevision)
+    {
+        m_revision = 0;
+    }
+
+    return m_revision;
+}
@@ -0,0 +1,143 @@
+#ifndef LINESTORE_H
+#define LINESTORE_H
+
+#include <QList>
+#include <QSharedData>
+#include <QString>
+#include <QVector>
+
+#include <functional>
+
+//
+// Scrollback storage of the terminal log.
+//
+// Lines are addressed by ids that never change: clearing a part of the log moves firstLineId()
+// instead of renumbering. The last lines (the terminal screen) are kept editable as separate
+// LogLine objects. Once a line scrolls off the screen it is frozen: appended to a LineChunk,
+// which keeps the text of chunkLines lines in one contiguous string with an offset array
+// and the attribute runs in one vector, i.e. a few allocations per thousand lines.
+//
+// Dropping the head of the log removes whole chunks and skips the dropped lines of the first one,
+// the memory of the removed chunks is released in the background.
+//
+// rotateLines() scrolls a range of the editable lines (a terminal scrolling region) by moving
+// the line objects: count > 0 moves the contents up, count < 0 down, the lines rotated in are blank.
+// It is a few pointer moves however long the lines are.
+//
+
+typedef quint16 TextAttr;
+
+// TextAttr layout: foreground and background ANSI colors (0..7) plus the flags
+enum TextAttrBits
+{
+    TextAttrFgMask = 0x0007,
+    TextAttrBgShift = 3,
+    TextAttrBgMask = 0x0038,
+    TextAttrBright = 0x0040,
+    TextAttrUnderline = 0x0080,
+    TextAttrInverse = 0x0100
+};
+
+const TextAttr defaultTextAttr = 7; // white on black
+
+inline int textAttrForeground(TextAttr attr) { return attr & TextAttrFgMask; }
+inline int textAttrBackground(TextAttr attr) { return (attr & TextAttrBgMask) >> TextAttrBgShift; }
+
+struct AttrRun
+{
+    int start; // the run lasts until the start of the next one or the end of the text
+    TextAttr attr;
+};
+
+class LogLine
+{
+public:
+    LogLine();
+
+    static const quint32 frozenRevision = 0xFFFFFFFF;
+
+    QString text;
+    QVector<AttrRun> runs; // starts are relative to the line, the first run starts at 0
+    quint32 revision;      // stamped by the store on every access for editing, frozenRevision once frozen
+
+    TextAttr attrAt(int index) const;
+
+    void write(int index, const QString &str, TextAttr attr); // overwrites, pads with spaces if needed
+    void truncate(int index);
+    void clear();
+
+private:
+    void setAttr(int from, int to, TextAttr attr);
+};
+
+class LineChunkData : public QSharedData
+{
+public:
+    QString text;
+    QVector<int> lineStarts;    // lineCount() + 1 offsets into text
+    QVector<AttrRun> runs;      // starts are relative to text
+    QVector<int> runStarts;     // lineCount() + 1 indices into runs
+};
+
+class LineChunk
+{
+public:
+    LineChunk();
+
+    int lineCount() const;
+    LogLine line(int ix) const;
+    QString text(int ix) const;
+    QStringRef textRef(int ix) const;
+    qint64 memoryBytes() const;
+
+    void append(const LogLine &line);
+    LogLine takeLast();
+    void squeeze();
+
+private:
+    QSharedDataPointer<LineChunkData> d;
+};
+
+class LineStore
+{
+public:
+    LineStore();
+
+    static const int chunkLines = 1024;
+
+    qint64 firstLineId() const;
+    qint64 endLineId() const; // one past the last line
+    qint64 lineCount() const;
+    qint64 editableLineId() const; // first line of the editable tail
+
+    LogLine line(qint64 id) const;
+    QString text(qint64 id) const;
+    QStringRef textRef(qint64 id) const; // no copy, valid until the store is modified
+    LogLine &editableLine(qint64 id);
+    quint32 revision(qint64 id) const;
+
+    void appendLine();
+    void clearLines(qint64 from, qint64 to); // editable lines only
+    void rotateLines(qint64 from, qint64 to, int count); // editable lines only, see below
+    void removeLastLine(); // editable
+    void freezeLinesBefore(qint64 id);
+    void unfreezeLinesFrom(qint64 id); // the frozen lines from id on become editable again
+    void dropLinesBefore(qint64 id);
+    void transformLines(const std::function<void (LogLine &line)> &transform); // chunks in parallel, transform must be thread-safe
+    void clear();
+
+    qint64 memoryBytes() const;
+
+private:
+    void releaseChunks(QList<LineChunk> &chunks);
+    quint32 nextRevision();
+
+    QList<LineChunk> m_chunks; // all but the last one are full
+    QList<LogLine> m_tail;
+    qint64 m_firstLineId;
+    int m_firstChunkSkip;      // dropped lines still stored at the start of the first chunk
+    qint64 m_frozenLines;
+    quint32 m_revision;        // unique across the lines, the ids of rotated lines change
+};
+
+#endif // LINESTORE_H
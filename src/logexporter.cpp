@@ -0,0 +1,272 @@
+#include "logexporter.h"
+#include "plaintextlog.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QtConcurrent/QtConcurrentRun>
+
+static const int bufferBytes = 256 * 1024; // written out whenever it fills up
+
+static QByteArray ansiSgr(TextAttr attr)
+{
+    QByteArray sgr("\x1b[0");
+
+    if (attr & TextAttrBright)
+    {
+        sgr += ";1";
+    }
+    if (attr & TextAttrUnderline)
+    {
+        sgr += ";4";
+    }
+    if (attr & TextAttrInverse)
+    {
+        sgr += ";7";
+    }
+    if (textAttrForeground(attr) != textAttrForeground(defaultTextAttr))
+    {
+        sgr += ";3" + QByteArray::number(textAttrForeground(attr));
+    }
+    if (textAttrBackground(attr) != textAttrBackground(defaultTextAttr))
+    {
+        sgr += ";4" + QByteArray::number(textAttrBackground(attr));
+    }
+
+    return sgr + 'm';
+}
+
+static QByteArray htmlClasses(TextAttr attr)
+{
+    // as PlainTextLog paints it: inverse swaps the colors, bright applies to the foreground only
+
+    int fg = textAttrForeground(attr);
+    int bg = textAttrBackground(attr);
+    if (attr & TextAttrInverse)
+    {
+        qSwap(fg, bg);
+    }
+
+    QByteArrayList classes;
+
+    if (attr & TextAttrBright)
+    {
+        classes.append("h" + QByteArray::number(fg));
+    }
+    else if (fg != textAttrForeground(defaultTextAttr))
+    {
+        classes.append("f" + QByteArray::number(fg));
+    }
+    if (bg != textAttrBackground(defaultTextAttr))
+    {
+        classes.append("b" + QByteArray::number(bg));
+    }
+    if (attr & TextAttrUnderline)
+    {
+        classes.append("u");
+    }
+
+    return classes.join(' ');
+}
+
+static QByteArray htmlHeader()
+{
+    QByteArray html("<!DOCTYPE html>\n<html>\n<head>\n<meta charset=\"utf-8\">\n<style>\n");
+
+    html += QString("pre { background: #%1; color: #%2; }\n")
+            .arg(PlainTextLog::ansiColorToRgb(PlainTextLog::AnsiColor(textAttrBackground(defaultTextAttr)), false), 6, 16, QChar('0'))
+            .arg(PlainTextLog::ansiColorToRgb(PlainTextLog::AnsiColor(textAttrForeground(defaultTextAttr)), false), 6, 16, QChar('0'))
+            .toLatin1();
+
+    for (int color = PlainTextLog::ANSI_BLACK; color <= PlainTextLog::ANSI_WHITE; ++color)
+    {
+        const QRgb normal = PlainTextLog::ansiColorToRgb(PlainTextLog::AnsiColor(color), false);
+        const QRgb bright = PlainTextLog::ansiColorToRgb(PlainTextLog::AnsiColor(color), true);
+
+        html += QString(".f%1 { color: #%2; }\n.h%1 { color: #%3; }\n.b%1 { background: #%2; }\n")
+                .arg(color)
+                .arg(normal, 6, 16, QChar('0'))
+                .arg(bright, 6, 16, QChar('0'))
+                .toLatin1();
+    }
+
+    html += ".u { text-decoration: underline; }\n</style>\n</head>\n<body>\n<pre>";
+
+    return html;
+}
+
+static void appendLine(QByteArray &out, const LogLine &line, LogExporter::Format format)
+{
+    if (format == LogExporter::PlainText)
+    {
+        out += line.text.toUtf8();
+        out += '\n';
+        return;
+    }
+
+    for (int r = 0; r < line.runs.size(); ++r)
+    {
+        const AttrRun &run = line.runs.at(r);
+        const int end = (r + 1 < line.runs.size()) ? line.runs.at(r + 1).start : line.text.size();
+
+        if (end <= run.start)
+        {
+            continue;
+        }
+
+        const QString text = line.text.mid(run.start, end - run.start);
+
+        if (format == LogExporter::AnsiText)
+        {
+            // every line starts with the default attributes, so it can be cut out on its own
+            if (run.attr != defaultTextAttr || r > 0)
+            {
+                out += ansiSgr(run.attr);
+            }
+            out += text.toUtf8();
+        }
+        else
+        {
+            const QByteArray classes = htmlClasses(run.attr);
+
+            if (classes.isEmpty())
+            {
+                out += text.toHtmlEscaped().toUtf8();
+            }
+            else
+            {
+                out += "<span class=\"" + classes + "\">" + text.toHtmlEscaped().toUtf8() + "</span>";
+            }
+        }
+    }
+
+    if (format == LogExporter::AnsiText && !line.runs.isEmpty() && line.runs.last().attr != defaultTextAttr)
+    {
+        out += "\x1b[0m";
+    }
+
+    out += '\n';
+}
+
+LogExporter::LogExporter(QObject *parent) :
+    QObject(parent)
+{
+    connect(&m_watcher, SIGNAL(finished()), this, SLOT(exportFinished()));
+}
+
+LogExporter::~LogExporter()
+{
+    cancel();
+    m_watcher.waitForFinished();
+}
+
+bool LogExporter::start(const LineStore &lines, const QString &fileName, Format format)
+{
+    if (m_watcher.isRunning())
+    {
+        qDebug() << "Warning: an export is already running:" << m_fileName;
+        return false;
+    }
+
+    m_cancelled.store(0);
+    m_fileName = fileName;
+
+    m_watcher.setFuture(QtConcurrent::run(this, &LogExporter::run, lines, fileName, format));
+
+    return true;
+}
+
+bool LogExporter::isRunning() const
+{
+    return m_watcher.isRunning();
+}
+
+bool LogExporter::isCancelled() const
+{
+    return m_cancelled.load() != 0;
+}
+
+QString LogExporter::fileName() const
+{
+    return m_fileName;
+}
+
+void LogExporter::cancel()
+{
+    m_cancelled.store(1);
+}
+
+void LogExporter::exportFinished()
+{
+    const QString error = m_watcher.result();
+
+    emit finished(error.isEmpty(), error);
+}
+
+QString LogExporter::run(const LineStore &lines, const QString &fileName, Format format)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        return file.errorString();
+    }
+
+    QByteArray buffer;
+    buffer.reserve(bufferBytes + 4096);
+
+    if (format == Html)
+    {
+        buffer += htmlHeader();
+    }
+
+    const qint64 first = lines.firstLineId();
+    const qint64 end = lines.endLineId();
+    const qint64 count = qMax(Q_INT64_C(1), end - first);
+    int lastPermille = -1;
+
+    for (qint64 id = first; id < end; ++id)
+    {
+        appendLine(buffer, lines.line(id), format);
+
+        if (buffer.size() < bufferBytes)
+        {
+            continue;
+        }
+
+        if (file.write(buffer) != buffer.size())
+        {
+            const QString error = file.errorString();
+            file.remove();
+            return error;
+        }
+        buffer.resize(0); // keeps the reserved capacity
+
+        if (m_cancelled.load())
+        {
+            file.remove();
+            return tr("Cancelled");
+        }
+
+        const int permille = int((id - first) * 1000 / count);
+        if (permille != lastPermille)
+        {
+            lastPermille = permille;
+            emit progress(permille);
+        }
+    }
+
+    if (format == Html)
+    {
+        buffer += "</pre>\n</body>\n</html>\n";
+    }
+
+    if (file.write(buffer) != buffer.size() || !file.flush())
+    {
+        const QString error = file.errorString();
+        file.remove();
+        return error;
+    }
+
+    emit progress(1000);
+
+    return QString();
+}
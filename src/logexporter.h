@@ -0,0 +1,58 @@
+#ifndef LOGEXPORTER_H
+#define LOGEXPORTER_H
+
+#include "linestore.h"
+
+#include <QAtomicInt>
+#include <QFutureWatcher>
+#include <QObject>
+
+//
+// Saves the scrollback to a file on the global thread pool: plain text, text with ANSI SGR
+// sequences or HTML with a CSS class per color and flag.
+//
+// The export works on a copy of the LineStore taken when it starts. The copy shares the frozen
+// chunks with the log, so it costs a few pointers, and the log goes on receiving meanwhile
+// (the chunk being filled is detached on its next append, the cleared ones stay alive until the end).
+// The lines are written one at a time through a small buffer: the memory doesn't grow with the log.
+//
+
+class LogExporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Format
+    {
+        PlainText,
+        AnsiText,
+        Html
+    };
+
+    explicit LogExporter(QObject *parent = 0);
+    ~LogExporter(); // cancels and waits
+
+    bool start(const LineStore &lines, const QString &fileName, Format format); // false if one is running
+    bool isRunning() const;
+    bool isCancelled() const; // the last export, by cancel()
+    QString fileName() const;
+
+signals:
+    void progress(int permille); // from the pool thread
+    void finished(bool ok, const QString &error);
+
+public slots:
+    void cancel();
+
+private slots:
+    void exportFinished();
+
+private:
+    QString run(const LineStore &lines, const QString &fileName, Format format); // the error, empty if ok
+
+    QFutureWatcher<QString> m_watcher;
+    QAtomicInt m_cancelled;
+    QString m_fileName;
+};
+
+#endif // LOGEXPORTER_H
@@ -0,0 +1,207 @@
+#include "logfileindex.h"
+
+#include <QDebug>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+struct BlockIndexer
+{
+    typedef QVector<quint32> result_type;
+
+    BlockIndexer(const char *data, qint64 size) :
+        data(data),
+        size(size)
+    {
+    }
+
+    QVector<quint32> operator()(const int &index) const
+    {
+        QVector<quint32> breaks;
+
+        const char *begin = data + qint64(index) * LogFileIndex::blockBytes;
+        const char *end = data + qMin(size, qint64(index + 1) * LogFileIndex::blockBytes);
+
+        for (const char *p = begin; p < end; ++p)
+        {
+            p = static_cast<const char *>(memchr(p, '\n', end - p));
+            if (!p)
+            {
+                break;
+            }
+
+            breaks.append(quint32(p - begin));
+        }
+
+        return breaks;
+    }
+
+    const char *data;
+    qint64 size;
+};
+
+LogFileIndex::LogFileIndex(QObject *parent) :
+    QObject(parent),
+    m_data(Q_NULLPTR),
+    m_size(0),
+    m_finished(false)
+{
+    m_breaksBefore.append(0);
+
+    connect(&m_watcher, SIGNAL(resultReadyAt(int)), this, SLOT(blockReady(int)));
+    connect(&m_watcher, SIGNAL(finished()), this, SLOT(indexingFinished()));
+}
+
+LogFileIndex::~LogFileIndex()
+{
+    // the pool threads read the mapping
+    m_watcher.cancel();
+    m_watcher.waitForFinished();
+}
+
+bool LogFileIndex::open(const QString &fileName, QString *error)
+{
+    Q_ASSERT(!m_data && !m_finished);
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly))
+    {
+        *error = m_file.errorString();
+        return false;
+    }
+
+    m_size = m_file.size();
+
+    if (m_size == 0)
+    {
+        m_finished = true;
+        return true;
+    }
+
+    m_data = reinterpret_cast<const char *>(m_file.map(0, m_size));
+    if (!m_data)
+    {
+        *error = m_file.errorString();
+        return false;
+    }
+
+    m_blockIndices.resize(int((m_size + blockBytes - 1) / blockBytes));
+    for (int b = 0; b < m_blockIndices.size(); ++b)
+    {
+        m_blockIndices[b] = b;
+    }
+
+    m_watcher.setFuture(QtConcurrent::mapped(m_blockIndices, BlockIndexer(m_data, m_size)));
+
+    return true;
+}
+
+QString LogFileIndex::fileName() const
+{
+    return m_file.fileName();
+}
+
+bool LogFileIndex::isIndexing() const
+{
+    return !m_finished;
+}
+
+qint64 LogFileIndex::fileSize() const
+{
+    return m_size;
+}
+
+qint64 LogFileIndex::indexedBytes() const
+{
+    return qMin(m_size, m_blocks.size() * blockBytes);
+}
+
+qint64 LogFileIndex::lineCount() const
+{
+    const qint64 breaks = m_breaksBefore.last();
+
+    if (m_finished && (breaks == 0 ? m_size > 0 : lineBreak(breaks - 1) + 1 < m_size))
+    {
+        return breaks + 1; // the last line has no line break
+    }
+
+    return breaks;
+}
+
+QByteArray LogFileIndex::line(qint64 n) const
+{
+    const qint64 start = lineStart(n);
+    qint64 end = (n < m_breaksBefore.last()) ? lineBreak(n) : m_size;
+
+    if (end > start && m_data[end - 1] == '\r')
+    {
+        --end;
+    }
+
+    return QByteArray::fromRawData(m_data + start, int(qMin(end - start, qint64(std::numeric_limits<int>::max()))));
+}
+
+qint64 LogFileIndex::lineStart(qint64 n) const
+{
+    return (n == 0) ? 0 : lineBreak(n - 1) + 1;
+}
+
+qint64 LogFileIndex::lineAt(qint64 offset) const
+{
+    // the line breaks before the offset
+    const int b = int(offset / blockBytes);
+    const QVector<quint32> &breaks = m_blocks.at(b);
+
+    const quint32 inBlock = quint32(offset - b * blockBytes);
+    return m_breaksBefore.at(b) + (std::lower_bound(breaks.constBegin(), breaks.constEnd(), inBlock) - breaks.constBegin());
+}
+
+const char *LogFileIndex::data() const
+{
+    return m_data;
+}
+
+qint64 LogFileIndex::lineBreak(qint64 n) const
+{
+    // the last block with fewer breaks before it than n + 1
+    const int b = int(std::upper_bound(m_breaksBefore.constBegin(), m_breaksBefore.constEnd(), n) - m_breaksBefore.constBegin()) - 1;
+
+    return b * blockBytes + m_blocks.at(b).at(int(n - m_breaksBefore.at(b)));
+}
+
+void LogFileIndex::blockReady(int index)
+{
+    m_pending.insert(index, m_watcher.resultAt(index));
+
+    const int blocks = m_blocks.size();
+
+    while (!m_pending.isEmpty() && m_pending.firstKey() == m_blocks.size())
+    {
+        m_blocks.append(m_pending.take(m_pending.firstKey()));
+        m_breaksBefore.append(m_breaksBefore.last() + m_blocks.last().size());
+    }
+
+    if (m_blocks.size() != blocks)
+    {
+        emit indexed(lineCount());
+    }
+}
+
+void LogFileIndex::indexingFinished()
+{
+    if (m_watcher.isCanceled())
+    {
+        return;
+    }
+
+    if (m_blocks.size() != m_blockIndices.size())
+    {
+        qDebug() << "ERROR Indexing" << fileName() << "ended after" << m_blocks.size() << "of" << m_blockIndices.size() << "blocks";
+    }
+
+    m_finished = true;
+
+    emit indexed(lineCount());
+}
@@ -0,0 +1,67 @@
+#ifndef LOGFILEINDEX_H
+#define LOGFILEINDEX_H
+
+#include <QFile>
+#include <QFutureWatcher>
+#include <QMap>
+#include <QObject>
+#include <QVector>
+
+//
+// Line index of a log file mapped into memory, for LogFileView.
+//
+// The file is split into blocks of blockBytes and the pool threads find the line breaks of a block
+// each with memchr(). The blocks are published in order as soon as the ones before them are done,
+// so the first lines can be shown a few milliseconds after open() while the rest is indexed.
+// A line break costs 4 bytes (its offset in the block), the text stays in the page cache.
+//
+// Line n ends at the n-th line break; while indexing only the lines with their break found are counted.
+//
+
+class LogFileIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit LogFileIndex(QObject *parent = 0);
+    ~LogFileIndex(); // cancels and waits for the pool threads
+
+    static const qint64 blockBytes = 16 * 1024 * 1024;
+
+    bool open(const QString &fileName, QString *error);
+    QString fileName() const;
+
+    bool isIndexing() const;
+    qint64 fileSize() const;
+    qint64 indexedBytes() const;
+    qint64 lineCount() const;
+
+    QByteArray line(qint64 n) const; // raw bytes without the line break, not copied: valid while the index lives
+    qint64 lineStart(qint64 n) const;
+    qint64 lineAt(qint64 offset) const; // offset < indexedBytes()
+    const char *data() const;
+
+signals:
+    void indexed(qint64 lineCount); // more lines are known
+
+private slots:
+    void blockReady(int index);
+    void indexingFinished();
+
+private:
+    qint64 lineBreak(qint64 n) const; // offset of the break ending line n
+
+    QFile m_file;
+    const char *m_data;
+    qint64 m_size;
+
+    QFutureWatcher<QVector<quint32> > m_watcher;
+    QVector<int> m_blockIndices; // the sequence the pool threads work on
+    QMap<int, QVector<quint32> > m_pending; // done out of order
+
+    QVector<QVector<quint32> > m_blocks; // the line break offsets of the indexed blocks
+    QVector<qint64> m_breaksBefore;      // the line breaks before each block, + the total
+    bool m_finished;
+};
+
+#endif // LOGFILEINDEX_H
@@ -0,0 +1,522 @@
+#include "logfileview.h"
+#include "plaintextlog.h"
+
+#include <QApplication>
+#include <QClipboard>
+#include <QFontDatabase>
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QScrollBar>
+
+#include <limits>
+
+static TextAttr applySgr(TextAttr attr, const QByteArray &params)
+{
+    // the subset PlainTextLog supports
+
+    if (params.isEmpty())
+    {
+        return defaultTextAttr;
+    }
+
+    foreach (const QByteArray &param, params.split(';'))
+    {
+        const int p = param.toInt();
+
+        if (p == 0)
+        {
+            attr = defaultTextAttr;
+        }
+        else if (p == 1)
+        {
+            attr |= TextAttrBright;
+        }
+        else if (p == 4)
+        {
+            attr |= TextAttrUnderline;
+        }
+        else if (p == 7)
+        {
+            attr |= TextAttrInverse;
+        }
+        else if (p >= 30 && p <= 37)
+        {
+            attr = TextAttr((attr & ~TextAttrFgMask) | (p - 30));
+        }
+        else if (p >= 40 && p <= 47)
+        {
+            attr = TextAttr((attr & ~TextAttrBgMask) | ((p - 40) << TextAttrBgShift));
+        }
+        else if (p == 38 || p == 48)
+        {
+            break; // extended colors, the rest are their arguments
+        }
+    }
+
+    return attr;
+}
+
+static QColor foregroundColor(TextAttr attr)
+{
+    const int color = (attr & TextAttrInverse) ? textAttrBackground(attr) : textAttrForeground(attr);
+
+    return QColor(PlainTextLog::ansiColorToRgb(PlainTextLog::AnsiColor(color), attr & TextAttrBright));
+}
+
+static QColor backgroundColor(TextAttr attr)
+{
+    const int color = (attr & TextAttrInverse) ? textAttrForeground(attr) : textAttrBackground(attr);
+
+    return QColor(PlainTextLog::ansiColorToRgb(PlainTextLog::AnsiColor(color), false));
+}
+
+static QByteArray asciiLower(const char *data, int size)
+{
+    QByteArray lower(data, size);
+
+    for (char *p = lower.data(), *end = p + size; p < end; ++p)
+    {
+        if (*p >= 'A' && *p <= 'Z')
+        {
+            *p += 'a' - 'A';
+        }
+    }
+
+    return lower;
+}
+
+LogFileView::LogFileView(QWidget *parent) :
+    QAbstractScrollArea(parent),
+    m_index(new LogFileIndex(this)),
+    m_lines(1024),
+    m_currentLine(-1),
+    m_matchOffset(-1),
+    m_maxWidth(0)
+{
+    setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+
+    verticalScrollBar()->setSingleStep(1);
+
+    connect(m_index, SIGNAL(indexed(qint64)), this, SLOT(linesIndexed()));
+}
+
+bool LogFileView::open(const QString &fileName, QString *error)
+{
+    if (!m_index->open(fileName, error))
+    {
+        return false;
+    }
+
+    updateScrollBars();
+
+    return true;
+}
+
+const LogFileIndex *LogFileView::index() const
+{
+    return m_index;
+}
+
+qint64 LogFileView::currentLine() const
+{
+    return m_currentLine;
+}
+
+LogLine LogFileView::decodeLine(const QByteArray &raw)
+{
+    LogLine line;
+    TextAttr attr = defaultTextAttr;
+    int column = 0;
+
+    const char *data = raw.constData();
+    const int size = raw.size();
+    int spanStart = 0;
+
+    for (int i = 0; i <= size; ++i)
+    {
+        const uchar c = (i < size) ? uchar(data[i]) : 0;
+
+        if (i < size && c >= 0x20 && c != 0x7F)
+        {
+            continue; // text, UTF-8 sequences have no bytes below 0x80
+        }
+
+        if (i > spanStart)
+        {
+            const QString text = QString::fromUtf8(data + spanStart, i - spanStart);
+            line.write(column, text, attr);
+            column += text.size();
+        }
+
+        if (c == '\t')
+        {
+            const int spaces = 8 - column % 8;
+            line.write(column, QString(spaces, ' '), attr);
+            column += spaces;
+        }
+        else if (c == '\r')
+        {
+            column = 0;
+        }
+        else if (c == '\b')
+        {
+            column = qMax(0, column - 1);
+        }
+        else if (c == 0x1B && i + 1 < size)
+        {
+            if (data[i + 1] == '[')
+            {
+                // CSI: parameters up to the final byte
+                int end = i + 2;
+                while (end < size && (uchar(data[end]) < 0x40 || uchar(data[end]) > 0x7E))
+                {
+                    ++end;
+                }
+
+                if (end < size && data[end] == 'm')
+                {
+                    attr = applySgr(attr, QByteArray::fromRawData(data + i + 2, end - i - 2));
+                }
+
+                i = end;
+            }
+            else if (data[i + 1] == ']')
+            {
+                // OSC (window title...): up to BEL or ST
+                int end = i + 2;
+                while (end < size && data[end] != '\a' && !(data[end] == 0x1B && end + 1 < size && data[end + 1] == '\\'))
+                {
+                    ++end;
+                }
+
+                i = (end < size && data[end] == 0x1B) ? end + 1 : end;
+            }
+            else
+            {
+                ++i; // a two byte sequence
+            }
+        }
+
+        spanStart = i + 1;
+    }
+
+    return line;
+}
+
+void LogFileView::setSearchPhrase(const QString &phrase, bool caseSensitive)
+{
+    m_highlighter.setSearchPhrase(phrase, caseSensitive);
+    m_matchOffset = -1;
+
+    viewport()->update();
+}
+
+bool LogFileView::find(bool backward)
+{
+    if (m_highlighter.isEmpty() || m_index->indexedBytes() == 0)
+    {
+        return false;
+    }
+
+    qint64 from;
+    if (m_matchOffset >= 0)
+    {
+        from = backward ? m_matchOffset - 1 : m_matchOffset + 1;
+    }
+    else
+    {
+        const qint64 line = (m_currentLine >= 0) ? m_currentLine : verticalScrollBar()->value();
+        from = backward ? m_index->lineStart(line) - 1 : m_index->lineStart(line);
+    }
+
+    qint64 offset = searchBytes(from, backward);
+    if (offset < 0)
+    {
+        offset = searchBytes(backward ? m_index->indexedBytes() - 1 : 0, backward);
+    }
+
+    if (offset < 0)
+    {
+        return false;
+    }
+
+    const qint64 line = m_index->lineAt(offset);
+    if (line >= m_index->lineCount())
+    {
+        return false; // in the last line, its end isn't indexed yet
+    }
+
+    m_matchOffset = offset;
+    setCurrentLine(line);
+    ensureLineVisible(line);
+
+    return true;
+}
+
+void LogFileView::findNext()
+{
+    find(false);
+}
+
+void LogFileView::findPrev()
+{
+    find(true);
+}
+
+void LogFileView::copy()
+{
+    if (m_currentLine < 0)
+    {
+        return;
+    }
+
+    QApplication::clipboard()->setText(decodedLine(m_currentLine)->text);
+}
+
+qint64 LogFileView::searchBytes(qint64 from, bool backward) const
+{
+    const bool caseSensitive = m_highlighter.isCaseSensitive();
+    QByteArray phrase = m_highlighter.searchPhrase().toUtf8();
+    if (!caseSensitive)
+    {
+        phrase = asciiLower(phrase.constData(), phrase.size());
+    }
+
+    const char *data = m_index->data();
+    const qint64 end = m_index->indexedBytes();
+
+    // windows of the file, overlapping by the phrase length so the matches across the borders are found
+
+    if (!backward)
+    {
+        for (qint64 pos = qMax(Q_INT64_C(0), from); pos < end; pos += searchWindowBytes)
+        {
+            const int size = int(qMin(qint64(searchWindowBytes + phrase.size() - 1), end - pos));
+            const QByteArray bytes = caseSensitive ? QByteArray::fromRawData(data + pos, size) : asciiLower(data + pos, size);
+
+            const int ix = bytes.indexOf(phrase);
+            if (ix >= 0)
+            {
+                return pos + ix;
+            }
+        }
+    }
+    else
+    {
+        for (qint64 top = qMin(from + 1, end); top > 0; top -= searchWindowBytes) // the matches starting before top
+        {
+            const qint64 pos = qMax(Q_INT64_C(0), top - searchWindowBytes);
+            const int size = int(qMin(top - pos + phrase.size() - 1, end - pos));
+            const QByteArray bytes = caseSensitive ? QByteArray::fromRawData(data + pos, size) : asciiLower(data + pos, size);
+
+            const int ix = bytes.lastIndexOf(phrase, int(top - 1 - pos));
+            if (ix >= 0)
+            {
+                return pos + ix;
+            }
+        }
+    }
+
+    return -1;
+}
+
+const LogLine *LogFileView::decodedLine(qint64 n)
+{
+    LogLine *line = m_lines.object(n);
+
+    if (!line)
+    {
+        line = new LogLine(decodeLine(m_index->line(n)));
+        m_lines.insert(n, line);
+    }
+
+    return line;
+}
+
+void LogFileView::setCurrentLine(qint64 line)
+{
+    if (line == m_currentLine)
+    {
+        viewport()->update();
+        return;
+    }
+
+    m_currentLine = line;
+    viewport()->update();
+
+    emit currentLineChanged(line);
+}
+
+void LogFileView::ensureLineVisible(qint64 line)
+{
+    QScrollBar *bar = verticalScrollBar();
+    const int rows = visibleRows();
+
+    if (line < bar->value() || line >= bar->value() + rows)
+    {
+        bar->setValue(int(qMin(line - rows / 2, qint64(std::numeric_limits<int>::max())))); // centered
+    }
+}
+
+void LogFileView::linesIndexed()
+{
+    updateScrollBars();
+    viewport()->update();
+}
+
+void LogFileView::paintEvent(QPaintEvent *e)
+{
+    Q_UNUSED(e);
+
+    QPainter p(viewport());
+
+    p.fillRect(viewport()->rect(), backgroundColor(defaultTextAttr));
+
+    const QFontMetrics &fm = fontMetrics();
+    const int charWidth = fm.width(' ');
+    const int lineHeight = fm.height();
+    const int left = numberColumnChars() * charWidth - horizontalScrollBar()->value();
+    const int right = viewport()->width();
+
+    QFont underlineFont = font();
+    underlineFont.setUnderline(true);
+    QFont boldFont = font();
+    boldFont.setBold(true);
+
+    const qint64 firstLine = verticalScrollBar()->value();
+    const qint64 lineCount = m_index->lineCount();
+    const int rows = visibleRows() + 1; // the last one may be partially visible
+
+    int maxWidth = m_maxWidth;
+
+    for (int row = 0; row < rows && firstLine + row < lineCount; ++row)
+    {
+        const qint64 n = firstLine + row;
+        const LogLine *line = decodedLine(n);
+        const int y = row * lineHeight;
+        const int baseline = y + fm.ascent();
+
+        for (int r = 0; r < line->runs.size(); ++r)
+        {
+            const AttrRun &run = line->runs.at(r);
+            const int end = (r + 1 < line->runs.size()) ? line->runs.at(r + 1).start : line->text.size();
+            const int x = left + run.start * charWidth;
+
+            if (x >= right)
+            {
+                break;
+            }
+
+            const QColor background = backgroundColor(run.attr);
+            if (background != backgroundColor(defaultTextAttr))
+            {
+                p.fillRect(QRect(x, y, (end - run.start) * charWidth, lineHeight), background);
+            }
+
+            p.setFont((run.attr & TextAttrUnderline) ? underlineFont : font());
+            p.setPen(foregroundColor(run.attr));
+            p.drawText(x, baseline, line->text.mid(run.start, end - run.start));
+        }
+
+        if (!m_highlighter.isEmpty())
+        {
+            p.setFont(boldFont);
+            p.setPen(Qt::black);
+
+            const int length = m_highlighter.searchPhrase().length();
+
+            for (int ix = m_highlighter.indexIn(line->text, 0); ix >= 0; ix = m_highlighter.indexIn(line->text, ix + length))
+            {
+                const int x = left + ix * charWidth;
+                if (x >= right)
+                {
+                    break;
+                }
+
+                p.fillRect(QRect(x, y, length * charWidth, lineHeight), QColor(0xFEF935));
+                p.drawText(x, baseline, line->text.mid(ix, length));
+            }
+        }
+
+        p.setFont(font());
+
+        if (n == m_currentLine)
+        {
+            QColor highlight = palette().color(QPalette::Highlight);
+            highlight.setAlpha(110);
+
+            p.fillRect(QRect(0, y, right, lineHeight), highlight);
+        }
+
+        // the line numbers over the text scrolled to the left
+
+        p.fillRect(QRect(0, y, (numberColumnChars() - 1) * charWidth, lineHeight), backgroundColor(defaultTextAttr));
+        p.setPen(QColor(PlainTextLog::ansiColorToRgb(PlainTextLog::ANSI_BLACK, true)));
+        p.drawText(0, baseline, QString("%1").arg(n + 1, numberColumnChars() - 1));
+
+        maxWidth = qMax(maxWidth, line->text.size() * charWidth);
+    }
+
+    if (maxWidth > m_maxWidth)
+    {
+        m_maxWidth = maxWidth;
+        updateScrollBars();
+    }
+}
+
+void LogFileView::resizeEvent(QResizeEvent *e)
+{
+    QAbstractScrollArea::resizeEvent(e);
+
+    updateScrollBars();
+}
+
+void LogFileView::mousePressEvent(QMouseEvent *e)
+{
+    const qint64 line = verticalScrollBar()->value() + e->pos().y() / fontMetrics().height();
+
+    if (line < m_index->lineCount())
+    {
+        m_matchOffset = -1; // find goes on from this line
+        setCurrentLine(line);
+    }
+}
+
+void LogFileView::keyPressEvent(QKeyEvent *e)
+{
+    if (e->matches(QKeySequence::Copy))
+    {
+        copy();
+        return;
+    }
+
+    QAbstractScrollArea::keyPressEvent(e);
+}
+
+void LogFileView::updateScrollBars()
+{
+    const int pageRows = visibleRows();
+    const qint64 lineCount = qMin(m_index->lineCount(), qint64(std::numeric_limits<int>::max()));
+
+    verticalScrollBar()->setPageStep(pageRows);
+    verticalScrollBar()->setRange(0, int(qMax(Q_INT64_C(0), lineCount - pageRows)));
+
+    const int charWidth = fontMetrics().width(' ');
+    const int width = numberColumnChars() * charWidth + m_maxWidth;
+
+    horizontalScrollBar()->setSingleStep(charWidth);
+    horizontalScrollBar()->setPageStep(viewport()->width());
+    horizontalScrollBar()->setRange(0, qMax(0, width - viewport()->width()));
+}
+
+int LogFileView::visibleRows() const
+{
+    return qMax(1, viewport()->height() / fontMetrics().height());
+}
+
+int LogFileView::numberColumnChars() const
+{
+    // the digits of the line count, and a space
+    return QString::number(qMax(Q_INT64_C(1), m_index->lineCount())).size() + 1;
+}
@@ -0,0 +1,75 @@
+#ifndef LOGFILEVIEW_H
+#define LOGFILEVIEW_H
+
+#include "linestore.h"
+#include "logfileindex.h"
+#include "searchhighlighter.h"
+
+#include <QAbstractScrollArea>
+#include <QCache>
+
+//
+// Read-only view of a log file, e.g. a capture from the field, however large.
+//
+// The file is mapped and indexed by LogFileIndex in the background; the view scrolls over the lines
+// indexed so far. Only the painted lines are decoded: UTF-8, tabs, CR/BS overwrites and the SGR
+// attributes the terminal supports, the other escape sequences are dropped. Each line is decoded
+// on its own from the default attributes, and the results are kept in a small cache.
+//
+// Find searches the mapped bytes themselves (ASCII letters only are folded when it is case insensitive),
+// so it runs at memory speed and doesn't decode the lines it skips.
+//
+
+class LogFileView : public QAbstractScrollArea
+{
+    Q_OBJECT
+
+public:
+    explicit LogFileView(QWidget *parent = 0);
+
+    static const int searchWindowBytes = 4 * 1024 * 1024;
+
+    bool open(const QString &fileName, QString *error);
+    const LogFileIndex *index() const;
+    qint64 currentLine() const; // -1 if none
+
+    static LogLine decodeLine(const QByteArray &raw);
+
+    void setSearchPhrase(const QString &phrase, bool caseSensitive);
+    bool find(bool backward); // from the current match or line, around at the ends
+
+public slots:
+    void findNext();
+    void findPrev();
+    void copy(); // the current line
+
+signals:
+    void currentLineChanged(qint64 line);
+
+protected:
+    void paintEvent(QPaintEvent *e);
+    void resizeEvent(QResizeEvent *e);
+    void mousePressEvent(QMouseEvent *e);
+    void keyPressEvent(QKeyEvent *e);
+
+private slots:
+    void linesIndexed();
+
+private:
+    const LogLine *decodedLine(qint64 n);
+    qint64 searchBytes(qint64 from, bool backward) const; // offset of the match, -1 if none
+    void setCurrentLine(qint64 line);
+    void ensureLineVisible(qint64 line);
+    void updateScrollBars();
+    int visibleRows() const;
+    int numberColumnChars() const;
+
+    LogFileIndex *m_index;
+    QCache<qint64, LogLine> m_lines; // decoded
+    SearchHighlighter m_highlighter;
+    qint64 m_currentLine;
+    qint64 m_matchOffset; // in the file, -1 if none
+    int m_maxWidth;       // of the lines painted so far, for the horizontal scroll bar
+};
+
+#endif // LOGFILEVIEW_H
@@ -0,0 +1,122 @@
+#include "logfilewindow.h"
+
+#include <QCoreApplication>
+#include <QFileInfo>
+#include <QHBoxLayout>
+#include <QShortcut>
+#include <QToolButton>
+#include <QVBoxLayout>
+
+LogFileWindow::LogFileWindow(const QFont &font, QWidget *parent) :
+    QWidget(parent, Qt::Window),
+    m_view(new LogFileView(this)),
+    m_findEdit(new QLineEdit(this)),
+    m_findCaseSensitive(new QCheckBox(tr("Aa"), this)),
+    m_labelStatus(new QLabel(this)),
+    m_notFound(false)
+{
+    setAttribute(Qt::WA_DeleteOnClose);
+
+    m_view->setFont(font);
+
+    QToolButton *findPrevBtn = new QToolButton(this);
+    findPrevBtn->setArrowType(Qt::UpArrow);
+    findPrevBtn->setToolTip(tr("Find previous"));
+
+    QToolButton *findNextBtn = new QToolButton(this);
+    findNextBtn->setArrowType(Qt::DownArrow);
+    findNextBtn->setToolTip(tr("Find next"));
+
+    QHBoxLayout *findBar = new QHBoxLayout();
+    findBar->setContentsMargins(0, 0, 0, 0);
+    findBar->addWidget(m_findEdit, 1);
+    findBar->addWidget(m_findCaseSensitive);
+    findBar->addWidget(findPrevBtn);
+    findBar->addWidget(findNextBtn);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->setSpacing(2);
+    layout->setContentsMargins(2, 2, 2, 2);
+    layout->addLayout(findBar);
+    layout->addWidget(m_view, 1);
+    layout->addWidget(m_labelStatus);
+
+    m_findEdit->setPlaceholderText(tr("Find"));
+    m_findCaseSensitive->setToolTip(tr("Case sensitive"));
+
+    connect(m_findEdit, SIGNAL(textChanged(QString)), this, SLOT(updateSearch()));
+    connect(m_findCaseSensitive, SIGNAL(toggled(bool)), this, SLOT(updateSearch()));
+    connect(m_findEdit, SIGNAL(returnPressed()), this, SLOT(findNext()));
+    connect(findNextBtn, SIGNAL(clicked(bool)), this, SLOT(findNext()));
+    connect(findPrevBtn, SIGNAL(clicked(bool)), this, SLOT(findPrev()));
+    connect(new QShortcut(QKeySequence::Find, this), SIGNAL(activated()), m_findEdit, SLOT(setFocus()));
+    connect(new QShortcut(QKeySequence::FindNext, this), SIGNAL(activated()), this, SLOT(findNext()));
+    connect(new QShortcut(QKeySequence::FindPrevious, this), SIGNAL(activated()), this, SLOT(findPrev()));
+
+    connect(m_view->index(), SIGNAL(indexed(qint64)), this, SLOT(updateStatus()));
+    connect(m_view, SIGNAL(currentLineChanged(qint64)), this, SLOT(updateStatus()));
+
+    resize(900, 600);
+}
+
+bool LogFileWindow::open(const QString &fileName, QString *error)
+{
+    if (!m_view->open(fileName, error))
+    {
+        return false;
+    }
+
+    setWindowTitle(QString("%1 - %2").arg(QFileInfo(fileName).fileName()).arg(QCoreApplication::applicationName()));
+    updateStatus();
+
+    return true;
+}
+
+void LogFileWindow::updateSearch()
+{
+    m_notFound = false;
+    m_view->setSearchPhrase(m_findEdit->text(), m_findCaseSensitive->isChecked());
+
+    updateStatus();
+}
+
+void LogFileWindow::findNext()
+{
+    find(false);
+}
+
+void LogFileWindow::findPrev()
+{
+    find(true);
+}
+
+void LogFileWindow::find(bool backward)
+{
+    m_notFound = !m_findEdit->text().isEmpty() && !m_view->find(backward);
+
+    updateStatus();
+}
+
+void LogFileWindow::updateStatus()
+{
+    const LogFileIndex *index = m_view->index();
+
+    QString status = tr("%1 lines").arg(index->lineCount());
+
+    if (index->isIndexing())
+    {
+        status += tr(", indexing %1%").arg(index->indexedBytes() * 100 / qMax(Q_INT64_C(1), index->fileSize()));
+    }
+
+    if (m_view->currentLine() >= 0)
+    {
+        status += tr(" | Line: %1").arg(m_view->currentLine() + 1);
+    }
+
+    if (m_notFound)
+    {
+        status += tr(" | Not found");
+    }
+
+    m_labelStatus->setText(status);
+}
@@ -0,0 +1,41 @@
+#ifndef LOGFILEWINDOW_H
+#define LOGFILEWINDOW_H
+
+#include "logfileview.h"
+
+#include <QCheckBox>
+#include <QLabel>
+#include <QLineEdit>
+#include <QWidget>
+
+//
+// A window of its own for a log file opened with "Open log...": the view with a find bar
+// and the indexing progress. It is deleted when closed.
+//
+
+class LogFileWindow : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit LogFileWindow(const QFont &font, QWidget *parent = 0);
+
+    bool open(const QString &fileName, QString *error);
+
+private slots:
+    void updateSearch();
+    void findNext();
+    void findPrev();
+    void updateStatus();
+
+private:
+    void find(bool backward);
+
+    LogFileView *m_view;
+    QLineEdit *m_findEdit;
+    QCheckBox *m_findCaseSensitive;
+    QLabel *m_labelStatus;
+    bool m_notFound; // by the last find
+};
+
+#endif // LOGFILEWINDOW_H
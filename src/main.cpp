@@ -1,8 +1,34 @@
+#include "headlesscapture.h"
 #include "mainwindow.h"
 #include <QApplication>
 
 int main(int argc, char *argv[])
 {
+    bool headless = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (qstrcmp(argv[i], "--headless") == 0)
+        {
+            headless = true;
+        }
+    }
+
+    if (headless)
+    {
+        // no QApplication: no display connection, no widget stack
+        QCoreApplication a(argc, argv);
+
+        QCoreApplication::setApplicationName(QLatin1String("qMinicom"));
+
+        HeadlessCapture capture;
+        if (!capture.start(a.arguments()))
+        {
+            return 1;
+        }
+
+        return a.exec();
+    }
+
     QApplication a(argc, argv);
 
     QCoreApplication::setApplicationName(QLatin1String("qMinicom"));
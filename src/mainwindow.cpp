@@ -1,59 +1,113 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
+#include "logfilewindow.h"
 
 #include <QDebug>
+#include <QActionGroup>
+#include <QFileDialog>
+#include <QFileInfo>
 #include <QGraphicsScene>
+#include <QInputDialog>
+#include <QMessageBox>
 #include <QScrollBar>
 #include <QtSerialPort/QtSerialPort>
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
-    ui(new Ui::MainWindow)
+    ui(new Ui::MainWindow),
+    m_dlgPrefs(Q_NULLPTR),
+    m_portEnumerator(new PortEnumerator(this)),
+    m_logTabStopWidth(0),
+    m_labelCounters(new QLabel(this)),
+    m_labelScript(new QLabel(this)),
+    m_exporter(new LogExporter(this)),
+    m_exportProgress(Q_NULLPTR),
+    m_countersTimer(new QTimer(this)),
+    m_searchTimer(new QTimer(this))
 {
     ui->setupUi(this);
     this->setWindowTitle(QCoreApplication::applicationName());
 
     qRegisterMetaType<AsyncPort::Status>("AsyncSerialPort::Status");
+    qRegisterMetaType<SerialTuning>("SerialTuning");
 
-    AsyncPort *port = new AsyncPort();
-    port->moveToThread(&m_asyncPortThread);
-    connect(&m_asyncPortThread, SIGNAL(started()), port, SLOT(initialize()));
-    connect(this, SIGNAL(openSerialPort(QString,qint32)), port, SLOT(openSerialPort(QString,qint32)));
-    connect(this, SIGNAL(openLocalShell()), port, SLOT(openLocalShell()));
-    connect(this, SIGNAL(closePort()), port, SLOT(closePort()));
-    connect(port, SIGNAL(statusChanged(AsyncPort::Status,QString,qint32)), this, SLOT(updatePortStatus(AsyncPort::Status,QString,qint32)));
-    connect(port, SIGNAL(dataReceived(QByteArray,bool)), ui->logWidget, SLOT(appendBytes(QByteArray,bool)));
-    connect(ui->logWidget, SIGNAL(sendBytes(QByteArray)), port, SLOT(sendData(QByteArray)));
+    connect(ui->sessionTabs, SIGNAL(currentChanged(int)), this, SLOT(currentSessionChanged()));
+    connect(ui->sessionTabs, SIGNAL(tabCloseRequested(int)), this, SLOT(closeSession(int)));
 
     ui->findWidget->setVisible(false);
-    connect(ui->findLineEdit, SIGNAL(textChanged(QString)), this, SLOT(updateSearch()));
+    m_searchTimer->setSingleShot(true);
+    m_searchTimer->setInterval(200); // the whole log is searched, not on every keystroke
+    connect(ui->findLineEdit, SIGNAL(textChanged(QString)), m_searchTimer, SLOT(start()));
+    connect(m_searchTimer, SIGNAL(timeout()), this, SLOT(updateSearch()));
     connect(ui->csFindBtn, SIGNAL(toggled(bool)), this, SLOT(updateSearch()));
-    connect(ui->findNextBtn, SIGNAL(clicked(bool)), ui->logWidget, SLOT(findNext()));
-    connect(ui->findLineEdit, SIGNAL(returnPressed()), ui->logWidget, SLOT(findNext()));
-    connect(ui->findPrevBtn, SIGNAL(clicked(bool)), ui->logWidget, SLOT(findPrev()));
+    connect(ui->findNextBtn, SIGNAL(clicked(bool)), this, SLOT(findNext()));
+    connect(ui->findLineEdit, SIGNAL(returnPressed()), this, SLOT(findNext()));
+    connect(ui->findPrevBtn, SIGNAL(clicked(bool)), this, SLOT(findPrev()));
 
-    ui->logWidget->setContextMenuPolicy(Qt::CustomContextMenu);
-    connect(ui->logWidget, SIGNAL(customContextMenuRequested(QPoint)), this, SLOT(customLogWidgetContextMenuRequested(QPoint)));
-    connect(ui->logWidget->horizontalScrollBar(), SIGNAL(rangeChanged(int,int)), this, SLOT(logWindowHorizontalBarRangeChanged(int,int)));
-
-    QGraphicsScene *m_scene = new QGraphicsScene(this);
-    ui->logWidget->setSideMarkScene(m_scene);
-    ui->sideMarkView->setScene(m_scene);
-    ui->sideMarkView->setVisible(false);
-
-    connect(ui->actionClear, SIGNAL(triggered(bool)), ui->logWidget, SLOT(clear()));
-    connect(ui->actionClearToLine, SIGNAL(triggered(bool)), ui->logWidget, SLOT(clearToCurrentContextMenuLine()));
+    connect(ui->actionClear, SIGNAL(triggered(bool)), this, SLOT(clearLog()));
+    connect(ui->actionClearToLine, SIGNAL(triggered(bool)), this, SLOT(clearLogToLine()));
 
     ui->actionPaste->setShortcut(QKeySequence(QKeySequence::Paste));
-    connect(ui->actionPaste, SIGNAL(triggered(bool)), ui->logWidget, SLOT(paste()));
+    connect(ui->actionPaste, SIGNAL(triggered(bool)), this, SLOT(paste()));
 
-    connect(ui->actionTrimContentsHorizontally, SIGNAL(triggered(bool)), ui->logWidget, SLOT(trimContentsByTheRightEdge()));
+    connect(ui->actionTrimContentsHorizontally, SIGNAL(triggered(bool)), this, SLOT(trimContentsHorizontally()));
     ui->actionTrimContentsHorizontally->setEnabled(false);
+    connect(ui->actionClipLines, SIGNAL(toggled(bool)), this, SLOT(setClipLines(bool)));
+
+    connect(ui->actionHexView, SIGNAL(toggled(bool)), this, SLOT(setHexViewVisible(bool)));
+    connect(ui->actionFilterView, SIGNAL(toggled(bool)), this, SLOT(setFilterViewVisible(bool)));
+
+    QActionGroup *framingGroup = new QActionGroup(this);
+    framingGroup->addAction(ui->actionFramingNone)->setData(FrameDecoder::NoFraming);
+    framingGroup->addAction(ui->actionFramingSlip)->setData(FrameDecoder::Slip);
+    framingGroup->addAction(ui->actionFramingCobs)->setData(FrameDecoder::Cobs);
+    framingGroup->addAction(ui->actionFramingCobsPaired)->setData(FrameDecoder::CobsPaired);
+    framingGroup->addAction(ui->actionFramingLengthPrefixed)->setData(FrameDecoder::LengthPrefixed);
+    framingGroup->addAction(ui->actionFramingDelimited)->setData(FrameDecoder::Delimited);
+    connect(framingGroup, SIGNAL(triggered(QAction*)), this, SLOT(setFraming()));
+    connect(ui->actionFramingCrc, SIGNAL(triggered(bool)), this, SLOT(setFraming()));
+    connect(ui->actionCapture, SIGNAL(triggered(bool)), this, SLOT(toggleCapture(bool)));
+    connect(ui->actionExport, SIGNAL(triggered(bool)), this, SLOT(exportLog()));
+    connect(m_exporter, SIGNAL(finished(bool,QString)), this, SLOT(exportFinished(bool,QString)));
+    connect(ui->actionRunScript, SIGNAL(triggered(bool)), this, SLOT(toggleScript(bool)));
+    connect(ui->actionLatencyOverlay, SIGNAL(toggled(bool)), this, SLOT(setLatencyOverlayVisible(bool)));
+    connect(ui->actionDumpLatency, SIGNAL(triggered(bool)), this, SLOT(dumpLatency()));
 
     ui->actionFind->setShortcut(QKeySequence(QKeySequence::Find));
     connect(ui->actionFind, SIGNAL(triggered(bool)), this, SLOT(showFindWidget()));
 
+    ui->actionToggleBookmark->setShortcut(QKeySequence(Qt::CTRL + Qt::Key_F2));
+    connect(ui->actionToggleBookmark, SIGNAL(triggered(bool)), this, SLOT(toggleBookmark()));
+    ui->actionNextBookmark->setShortcut(QKeySequence(Qt::Key_F2));
+    connect(ui->actionNextBookmark, SIGNAL(triggered(bool)), this, SLOT(nextBookmark()));
+    ui->actionPrevBookmark->setShortcut(QKeySequence(Qt::SHIFT + Qt::Key_F2));
+    connect(ui->actionPrevBookmark, SIGNAL(triggered(bool)), this, SLOT(prevBookmark()));
+    connect(ui->actionClearBookmarks, SIGNAL(triggered(bool)), this, SLOT(clearBookmarks()));
+    connect(ui->actionBookmarkRules, SIGNAL(triggered(bool)), this, SLOT(editBookmarkRules()));
+
+    ui->actionNewSession->setShortcut(QKeySequence(QKeySequence::AddTab));
+    connect(ui->actionNewSession, SIGNAL(triggered(bool)), this, SLOT(newSessionWithPrefs()));
+
+    ui->actionCloseSession->setShortcut(QKeySequence(QKeySequence::Close));
+    connect(ui->actionCloseSession, SIGNAL(triggered(bool)), this, SLOT(closeCurrentSession()));
+
+    connect(ui->actionOpenLog, SIGNAL(triggered(bool)), this, SLOT(openLog()));
+
     ui->statusBar->addPermanentWidget(ui->labelStatus, 1);
+    ui->statusBar->addPermanentWidget(m_labelScript);
+    m_labelScript->setVisible(false);
+    ui->statusBar->addPermanentWidget(m_labelCounters);
+
+    m_labelCounters->setToolTip(tr("Receive / transmit rate\n"
+                                   "Lines and escape sequences parsed per second\n"
+                                   "Dropped bytes / replaced characters of broken UTF-8\n"
+                                   "Unsupported escape sequences\n"
+                                   "Chunks queued for the terminal view\n"
+                                   "Scrollback memory (estimate)"));
+
+    m_countersTimer->setInterval(1000);
+    connect(m_countersTimer, SIGNAL(timeout()), this, SLOT(updateCounters()));
+    m_countersTimer->start();
 
     //
 
@@ -61,12 +115,15 @@ MainWindow::MainWindow(QWidget *parent) :
 
     //
 
-    m_asyncPortThread.start(QThread::HighestPriority);
+    newSession();
+
+    openLastPort();
 
     //
 
-    m_dlgPrefs = new PreferencesDialog(this);
-    connect(ui->actionPrefs, SIGNAL(triggered(bool)), m_dlgPrefs, SLOT(open()));
+    connect(ui->actionPrefs, SIGNAL(triggered(bool)), this, SLOT(openPreferences()));
+
+    m_portEnumerator->refresh(); // in the background, the dialog finds the list ready
 }
 
 MainWindow::~MainWindow()
@@ -75,23 +132,62 @@ MainWindow::~MainWindow()
 
     delete m_dlgPrefs;
 
-    emit closePort();
+    while (ui->sessionTabs->count())
+    {
+        QWidget *w = ui->sessionTabs->widget(0);
+        ui->sessionTabs->removeTab(0);
+        delete w; // closes the port
+    }
 
     delete ui;
-
-    m_asyncPortThread.quit();
-    m_asyncPortThread.wait();
 }
 
 const QFont &MainWindow::logWidgetFont()
 {
-    return ui->logWidget->font();
+    return m_logFont;
+}
+
+PortEnumerator *MainWindow::portEnumerator() const
+{
+    return m_portEnumerator;
 }
 
 void MainWindow::setLogWidgetSettings(const QFont &font, int tabStopWidthPixels)
 {
-    ui->logWidget->setFont(font);
-    ui->logWidget->setTabStopWidth(tabStopWidthPixels);
+    m_logFont = font;
+    m_logTabStopWidth = tabStopWidthPixels;
+
+    for (int i = 0; i < ui->sessionTabs->count(); ++i)
+    {
+        Session *session = qobject_cast<Session *>(ui->sessionTabs->widget(i));
+        session->log()->setFont(font);
+        session->log()->setTabStopWidth(tabStopWidthPixels);
+    }
+}
+
+void MainWindow::openSerialPort(const QString &pn, qint32 br)
+{
+    currentSession()->openSerialPort(pn, br);
+}
+
+void MainWindow::setSerialTuning(const SerialTuning &tuning)
+{
+    currentSession()->setSerialTuning(tuning);
+}
+
+void MainWindow::openLocalShell()
+{
+    currentSession()->openLocalShell();
+}
+
+void MainWindow::openVirtualPort()
+{
+    currentSession()->openVirtualPort();
+}
+
+void MainWindow::closePort()
+{
+    currentSession()->closePort();
 }
 
 void MainWindow::keyPressEvent(QKeyEvent *event)
@@ -109,8 +205,132 @@ void MainWindow::keyPressEvent(QKeyEvent *event)
     }
 }
 
-void MainWindow::updatePortStatus(AsyncPort::Status st, const QString &pn, qint32 br)
+Session *MainWindow::newSession()
+{
+    Session *session = new Session();
+
+    if (m_logTabStopWidth > 0)
+    {
+        session->log()->setFont(m_logFont);
+        session->log()->setTabStopWidth(m_logTabStopWidth);
+    }
+
+    session->setSideMarksVisible(ui->findWidget->isVisible());
+    session->log()->setBookmarkRules(m_bookmarkRules);
+    session->log()->setLatencyOverlayVisible(ui->actionLatencyOverlay->isChecked());
+    session->log()->setClipToViewport(ui->actionClipLines->isChecked());
+    session->setHexViewVisible(ui->actionHexView->isChecked());
+    if (ui->actionFilterView->isChecked())
+    {
+        session->setFilterVisible(true);
+    }
+
+    connect(session, SIGNAL(statusChanged()), this, SLOT(updatePortStatus()));
+    connect(session->log(), SIGNAL(customContextMenuRequested(QPoint)), this, SLOT(customLogWidgetContextMenuRequested(QPoint)));
+    connect(session->log()->horizontalScrollBar(), SIGNAL(rangeChanged(int,int)), this, SLOT(logWindowHorizontalBarRangeChanged()));
+    connect(session->scriptHost(), SIGNAL(message(QString)), this, SLOT(showScriptMessage(QString)));
+    connect(session->scriptHost(), SIGNAL(finished(bool,QString)), this, SLOT(scriptFinished(bool,QString)));
+
+    int ix = ui->sessionTabs->addTab(session, session->title());
+    ui->sessionTabs->setCurrentIndex(ix);
+    ui->sessionTabs->setTabBarAutoHide(true);
+
+    updateSearch();
+
+    return session;
+}
+
+void MainWindow::newSessionWithPrefs()
+{
+    newSession();
+    openPreferences();
+}
+
+void MainWindow::openPreferences()
+{
+    // the dialog has its own demo log and reads the whole settings, none of it is needed before it is opened
+    if (!m_dlgPrefs)
+    {
+        m_dlgPrefs = new PreferencesDialog(this);
+    }
+
+    m_dlgPrefs->open();
+}
+
+void MainWindow::openLog()
+{
+    QString fileName = QFileDialog::getOpenFileName(this, tr("Open log"), QDir::homePath());
+
+    if (fileName.isEmpty())
+    {
+        return;
+    }
+
+    // a window of its own, read-only: the sessions stay as they are
+    LogFileWindow *window = new LogFileWindow(m_logFont, this);
+
+    QString error;
+    if (!window->open(fileName, &error))
+    {
+        qDebug() << "ERROR Can't open" << fileName << error;
+        delete window;
+
+        QMessageBox::warning(this, tr("Open log"), tr("Can't open %1:\n%2")
+                             .arg(QDir::toNativeSeparators(fileName)).arg(error));
+        return;
+    }
+
+    window->show();
+}
+
+void MainWindow::closeSession(int index)
+{
+    if (ui->sessionTabs->count() <= 1)
+    {
+        currentSession()->closePort();
+        return; // keep at least one session around
+    }
+
+    QWidget *w = ui->sessionTabs->widget(index);
+    ui->sessionTabs->removeTab(index);
+    delete w;
+}
+
+void MainWindow::closeCurrentSession()
+{
+    closeSession(ui->sessionTabs->currentIndex());
+}
+
+void MainWindow::currentSessionChanged()
+{
+    if (!currentSession())
+    {
+        return;
+    }
+
+    updatePortStatus();
+    updateSearch();
+    logWindowHorizontalBarRangeChanged();
+
+    ui->actionCapture->setChecked(currentSession()->isCapturing());
+    ui->actionRunScript->setChecked(currentSession()->scriptHost()->isRunning());
+    updateFramingActions();
+}
+
+void MainWindow::updatePortStatus()
 {
+    for (int i = 0; i < ui->sessionTabs->count(); ++i)
+    {
+        Session *session = qobject_cast<Session *>(ui->sessionTabs->widget(i));
+        ui->sessionTabs->setTabText(i, session->title());
+    }
+
+    Session *session = currentSession();
+
+    AsyncPort::Status st = session->status();
+    const QString &pn = session->portName();
+    qint32 br = session->baudRate();
+
     QString msg;
 
     if (!pn.isEmpty())
@@ -133,22 +353,73 @@ void MainWindow::updatePortStatus(AsyncPort::Status st, const QString &pn, qint3
     }
 
     ui->labelStatus->setText(msg);
+
+    if (session->readLatency().isEmpty())
+    {
+        ui->labelStatus->setToolTip(QString());
+    }
+    else
+    {
+        ui->labelStatus->setToolTip(tr("Read latency (measured read intervals of a busy line):\n%1").arg(session->readLatency()));
+    }
+}
+
+static QString formatBytes(double bytes)
+{
+    if (bytes < 1024)
+    {
+        return QString("%1 B").arg(qRound64(bytes));
+    }
+    if (bytes < 1024 * 1024)
+    {
+        return QString("%1 KiB").arg(bytes / 1024, 0, 'f', 1);
+    }
+    return QString("%1 MiB").arg(bytes / (1024 * 1024), 0, 'f', 1);
+}
+
+void MainWindow::updateCounters()
+{
+    Session *session = currentSession();
+    if (!session)
+    {
+        return;
+    }
+
+    SessionCounters c = session->sampleCounters();
+
+    m_labelCounters->setText(tr("RX %1/s TX %2/s | %3 l/s %4 seq/s | utf8 %5/%6 | unsup %7 | queue %8 | %9")
+                             .arg(formatBytes(c.rxBytesRate))
+                             .arg(formatBytes(c.txBytesRate))
+                             .arg(qRound(c.linesRate))
+                             .arg(qRound(c.sequencesRate))
+                             .arg(c.droppedUtf8Bytes)
+                             .arg(c.replacedUtf8Chars)
+                             .arg(c.unsupportedSequences)
+                             .arg(c.backlogChunks)
+                             .arg(formatBytes(c.scrollbackBytes)));
 }
 
 void MainWindow::customLogWidgetContextMenuRequested(const QPoint &pos)
 {
-    const QPoint gpos = QWidget::mapToGlobal(pos);
+    PlainTextLog *log = currentLog();
 
-    QMenu *menu = ui->logWidget->createStandardContextMenu();
+    const QPoint gpos = log->viewport()->mapToGlobal(pos);
+
+    QMenu *menu = log->createContextMenu();
     menu->addSeparator();
     menu->addAction(ui->actionPaste);
     menu->addSeparator();
     menu->addAction(ui->actionClear);
     menu->addAction(ui->actionClearToLine);
     menu->addAction(ui->actionTrimContentsHorizontally);
+    menu->addSeparator();
+    menu->addAction(ui->actionNextBookmark);
+    menu->addAction(ui->actionPrevBookmark);
+
+    log->setContextMenuLine(log->lineAt(pos));
 
-    QTextCursor cur = ui->logWidget->cursorForPosition(pos);
-    ui->logWidget->setContextMenuTextCursor(cur);
+    // the alternate screen has no history to drop, its ids are not the ones of the bookmarks
+    ui->actionClearToLine->setEnabled(!log->isAlternateScreenActive());
 
     menu->exec(gpos); // blocking operation
 
@@ -157,11 +428,15 @@ void MainWindow::customLogWidgetContextMenuRequested(const QPoint &pos)
 
 void MainWindow::setFindWidgetVisible(bool visible)
 {
-    QScrollBar *p_scroll_bar = ui->logWidget->verticalScrollBar();
+    QScrollBar *p_scroll_bar = currentLog()->verticalScrollBar();
     bool was_at_bottom = (p_scroll_bar->value() == p_scroll_bar->maximum());
 
     ui->findWidget->setVisible(visible);
-    ui->sideMarkView->setVisible(visible);
+
+    for (int i = 0; i < ui->sessionTabs->count(); ++i)
+    {
+        qobject_cast<Session *>(ui->sessionTabs->widget(i))->setSideMarksVisible(visible);
+    }
 
     if (visible)
     {
@@ -183,19 +458,344 @@ void MainWindow::showFindWidget()
 
 void MainWindow::updateSearch()
 {
+    m_searchTimer->stop();
+
     if (ui->findWidget->isVisible())
     {
-        ui->logWidget->setSearchPhrase(ui->findLineEdit->text(), ui->csFindBtn->isChecked());
+        currentLog()->setSearchPhrase(ui->findLineEdit->text(), ui->csFindBtn->isChecked());
     }
     else
     {
-        ui->logWidget->setSearchPhrase(QString(), ui->csFindBtn->isChecked());
+        currentLog()->setSearchPhrase(QString(), ui->csFindBtn->isChecked());
+    }
+}
+
+void MainWindow::findNext()
+{
+    if (m_searchTimer->isActive())
+    {
+        updateSearch();
+    }
+
+    currentLog()->findNext();
+}
+
+void MainWindow::findPrev()
+{
+    if (m_searchTimer->isActive())
+    {
+        updateSearch();
+    }
+
+    currentLog()->findPrev();
+}
+
+void MainWindow::toggleBookmark()
+{
+    currentLog()->toggleBookmark();
+}
+
+void MainWindow::nextBookmark()
+{
+    currentLog()->nextBookmark();
+}
+
+void MainWindow::prevBookmark()
+{
+    currentLog()->prevBookmark();
+}
+
+void MainWindow::clearBookmarks()
+{
+    currentLog()->clearBookmarks();
+}
+
+void MainWindow::editBookmarkRules()
+{
+    bool ok;
+    const QString text = QInputDialog::getMultiLineText(this, tr("Bookmark rules"),
+                                                        tr("Lines matching any of these regular expressions\n"
+                                                           "are bookmarked, one expression per line:"),
+                                                        m_bookmarkRules.join('\n'), &ok);
+    if (!ok)
+    {
+        return;
+    }
+
+    m_bookmarkRules.clear();
+    foreach (const QString &rule, text.split('\n', QString::SkipEmptyParts))
+    {
+        const QString pattern = rule.trimmed();
+        if (!pattern.isEmpty())
+        {
+            m_bookmarkRules.append(pattern);
+        }
+    }
+
+    // the lines already in the logs stay as they are
+    for (int i = 0; i < ui->sessionTabs->count(); ++i)
+    {
+        qobject_cast<Session *>(ui->sessionTabs->widget(i))->log()->setBookmarkRules(m_bookmarkRules);
     }
+
+    QSettings m_settings;
+    m_settings.setValue(QLatin1String("Bookmarks/rules"), m_bookmarkRules);
 }
 
-void MainWindow::logWindowHorizontalBarRangeChanged(int min, int max)
+void MainWindow::clearLog()
 {
-    ui->actionTrimContentsHorizontally->setEnabled(min != max);
+    currentLog()->clear();
+    currentSession()->hexView()->clear(currentLog()->lineStore().firstLineId());
+    currentSession()->packetView()->clear();
+}
+
+void MainWindow::clearLogToLine()
+{
+    currentLog()->clearToCurrentContextMenuLine();
+}
+
+void MainWindow::paste()
+{
+    currentLog()->paste();
+}
+
+void MainWindow::trimContentsHorizontally()
+{
+    currentLog()->trimContentsByTheRightEdge();
+}
+
+void MainWindow::setClipLines(bool clip)
+{
+    for (int i = 0; i < ui->sessionTabs->count(); ++i)
+    {
+        Session *session = qobject_cast<Session *>(ui->sessionTabs->widget(i));
+        session->log()->setClipToViewport(clip);
+    }
+}
+
+void MainWindow::setHexViewVisible(bool visible)
+{
+    for (int i = 0; i < ui->sessionTabs->count(); ++i)
+    {
+        Session *session = qobject_cast<Session *>(ui->sessionTabs->widget(i));
+        session->setHexViewVisible(visible);
+    }
+}
+
+void MainWindow::setFilterViewVisible(bool visible)
+{
+    for (int i = 0; i < ui->sessionTabs->count(); ++i)
+    {
+        Session *session = qobject_cast<Session *>(ui->sessionTabs->widget(i));
+        session->setFilterVisible(visible);
+    }
+}
+
+void MainWindow::setFraming()
+{
+    // per session, like the capture
+    QAction *checked = ui->actionFramingNone->actionGroup()->checkedAction();
+
+    currentSession()->setFraming(FrameDecoder::Framing(checked->data().toInt()), ui->actionFramingCrc->isChecked());
+}
+
+void MainWindow::updateFramingActions()
+{
+    Session *session = currentSession();
+
+    foreach (QAction *action, ui->actionFramingNone->actionGroup()->actions())
+    {
+        action->setChecked(action->data().toInt() == session->framing());
+    }
+
+    ui->actionFramingCrc->setChecked(session->isFrameCrcChecked());
+}
+
+void MainWindow::toggleCapture(bool checked)
+{
+    Session *session = currentSession();
+
+    if (!checked)
+    {
+        session->stopCapture();
+        return;
+    }
+
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Capture to file"),
+                                                    QDir::home().filePath(session->title() + ".log"));
+
+    if (fileName.isEmpty())
+    {
+        ui->actionCapture->setChecked(false);
+        return;
+    }
+
+    QString error;
+    if (!session->startCapture(fileName, &error))
+    {
+        ui->actionCapture->setChecked(false);
+        QMessageBox::warning(this, tr("Capture"), error);
+    }
+}
+
+void MainWindow::exportLog()
+{
+    Session *session = currentSession();
+
+    const QString plainFilter = tr("Plain text (*.txt *.log)");
+    const QString ansiFilter = tr("Text with ANSI colors (*.ans)");
+    const QString htmlFilter = tr("HTML (*.html *.htm)");
+    QString filter;
+
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Export"),
+                                                    QDir::home().filePath(session->title() + ".txt"),
+                                                    plainFilter + ";;" + ansiFilter + ";;" + htmlFilter, &filter);
+
+    if (fileName.isEmpty())
+    {
+        return;
+    }
+
+    LogExporter::Format format = LogExporter::PlainText;
+    if (filter == ansiFilter)
+    {
+        format = LogExporter::AnsiText;
+    }
+    else if (filter == htmlFilter)
+    {
+        format = LogExporter::Html;
+    }
+
+    // the lines as they are now, the log goes on receiving meanwhile
+    if (!m_exporter->start(session->log()->lineStore(), fileName, format))
+    {
+        return;
+    }
+
+    ui->actionExport->setEnabled(false);
+
+    m_exportProgress = new QProgressDialog(tr("Exporting to %1...").arg(QFileInfo(fileName).fileName()),
+                                           tr("Cancel"), 0, 1000, this);
+    m_exportProgress->setWindowModality(Qt::NonModal);
+    m_exportProgress->setMinimumDuration(500);
+    connect(m_exporter, SIGNAL(progress(int)), m_exportProgress, SLOT(setValue(int)));
+    connect(m_exportProgress, SIGNAL(canceled()), m_exporter, SLOT(cancel()));
+}
+
+void MainWindow::exportFinished(bool ok, const QString &error)
+{
+    if (!ok)
+    {
+        qDebug() << "ERROR Can't export to" << m_exporter->fileName() << error;
+    }
+
+    delete m_exportProgress;
+    m_exportProgress = Q_NULLPTR;
+
+    ui->actionExport->setEnabled(true);
+
+    if (!ok && !m_exporter->isCancelled()) // the user knows about that one
+    {
+        QMessageBox::warning(this, tr("Export"), tr("Can't export to %1:\n%2")
+                             .arg(QDir::toNativeSeparators(m_exporter->fileName())).arg(error));
+    }
+}
+
+void MainWindow::toggleScript(bool checked)
+{
+    Session *session = currentSession();
+
+    if (!checked)
+    {
+        session->scriptHost()->stop(); // unchecked once it has finished
+        ui->actionRunScript->setChecked(true);
+        return;
+    }
+
+    QSettings m_settings;
+    const QString dir = m_settings.value(QLatin1String("Script/lastDir"), QDir::homePath()).toString();
+
+    QString fileName = QFileDialog::getOpenFileName(this, tr("Run script"), dir, tr("Scripts (*.js);;All files (*)"));
+
+    if (fileName.isEmpty() || !session->scriptHost()->start(fileName))
+    {
+        ui->actionRunScript->setChecked(false);
+        return;
+    }
+
+    m_settings.setValue(QLatin1String("Script/lastDir"), QFileInfo(fileName).absolutePath());
+
+    showScriptMessage(tr("Running %1").arg(QFileInfo(fileName).fileName()));
+}
+
+void MainWindow::showScriptMessage(const QString &text)
+{
+    m_labelScript->setText(text);
+    m_labelScript->setVisible(true);
+}
+
+void MainWindow::scriptFinished(bool ok, const QString &error)
+{
+    ScriptHost *host = qobject_cast<ScriptHost *>(sender());
+
+    if (host == currentSession()->scriptHost())
+    {
+        ui->actionRunScript->setChecked(false);
+    }
+
+    if (ok)
+    {
+        showScriptMessage(tr("%1 finished").arg(QFileInfo(host->fileName()).fileName()));
+    }
+    else
+    {
+        showScriptMessage(tr("%1 failed: %2").arg(QFileInfo(host->fileName()).fileName()).arg(error));
+    }
+}
+
+void MainWindow::setLatencyOverlayVisible(bool visible)
+{
+    for (int i = 0; i < ui->sessionTabs->count(); ++i)
+    {
+        Session *session = qobject_cast<Session *>(ui->sessionTabs->widget(i));
+        session->log()->setLatencyOverlayVisible(visible);
+    }
+}
+
+void MainWindow::dumpLatency()
+{
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Save latency samples"),
+                                                    QDir::home().filePath("qminicom-latency.txt"));
+
+    if (fileName.isEmpty())
+    {
+        return;
+    }
+
+    QString error;
+    if (!currentLog()->chunkLatency().dump(fileName, &error))
+    {
+        qDebug() << "ERROR Can't write" << fileName << error;
+
+        QMessageBox::warning(this, tr("Save latency samples"), tr("Can't write %1:\n%2")
+                             .arg(QDir::toNativeSeparators(fileName)).arg(error));
+    }
+}
+
+void MainWindow::logWindowHorizontalBarRangeChanged()
+{
+    QScrollBar *bar = currentLog()->horizontalScrollBar();
+    ui->actionTrimContentsHorizontally->setEnabled(bar->minimum() != bar->maximum());
+}
+
+Session *MainWindow::currentSession() const
+{
+    return qobject_cast<Session *>(ui->sessionTabs->currentWidget());
+}
+
+PlainTextLog *MainWindow::currentLog() const
+{
+    return currentSession()->log();
 }
 
 void MainWindow::readSettings()
@@ -212,6 +812,84 @@ void MainWindow::readSettings()
             setWindowState(Qt::WindowMaximized);
     }
     m_settings.endGroup();
+
+    m_settings.beginGroup(QLatin1String("LogWidget"));
+    {
+        const QString &font_str_default =
+        #if defined(Q_OS_MAC)
+                "Monaco"
+        #elif defined(Q_OS_WIN)
+                "fixed"
+        #else
+                "Monospace"
+        #endif
+                ;
+
+        const QString &font_str = m_settings.value(QLatin1String("font"), font_str_default).toString();
+
+        QFont font; // only the family is taken from the setting, see PreferencesDialog::readSettings()
+        QFont saved;
+        if (saved.fromString(font_str))
+        {
+            font.setFamily(saved.family());
+        }
+        else
+        {
+            qDebug() << "WARNING Can't pick up font setting:" << font_str;
+        }
+#ifdef Q_OS_MAC
+        font.setStyleStrategy(QFont::ForceIntegerMetrics); // see PreferencesDialog::pickUpFont()
+#endif
+        font.setPixelSize(QFontInfo(font).pixelSize());
+
+        int tabSize = m_settings.value(QLatin1String("tabSize"), 8).toInt();
+
+        m_logFont = font;
+        m_logTabStopWidth = QFontMetrics(font).width(QString(tabSize, ' '));
+    }
+    m_settings.endGroup();
+
+    m_settings.beginGroup(QLatin1String("Bookmarks"));
+    {
+        const QStringList defaultRules = QStringList() << QLatin1String("\\b(ERROR|FATAL|PANIC|Oops|Kernel panic)\\b");
+
+        m_bookmarkRules = m_settings.value(QLatin1String("rules"), defaultRules).toStringList();
+    }
+    m_settings.endGroup();
+}
+
+void MainWindow::openLastPort()
+{
+    // straight from the settings, without enumerating the ports: the first bytes shouldn't wait for
+    // the device list or the preferences dialog
+
+    QSettings m_settings;
+
+    m_settings.beginGroup(QLatin1String("Port"));
+    {
+        bool isSerial = m_settings.value(QLatin1String("isSerial"), true).toBool();
+        bool isVirtual = m_settings.value(QLatin1String("isVirtual"), false).toBool();
+
+        if (isSerial)
+        {
+            SerialTuning tuning;
+            tuning.lowLatency = m_settings.value(QLatin1String("lowLatency"), false).toBool();
+            tuning.readBufferSize = m_settings.value(QLatin1String("lowLatencyReadBufferSize"), tuning.readBufferSize).toLongLong();
+
+            setSerialTuning(tuning);
+            openSerialPort(m_settings.value(QLatin1String("portName"), "").toString(),
+                           m_settings.value(QLatin1String("baudRate"), QSerialPort::Baud115200).toInt());
+        }
+        else if (isVirtual)
+        {
+            openVirtualPort();
+        }
+        else
+        {
+            openLocalShell();
+        }
+    }
+    m_settings.endGroup();
 }
 
 void MainWindow::writeSettings()
@@ -2,11 +2,16 @@
 #define MAINWINDOW_H
 
 #include "asyncserialport.h"
+#include "logexporter.h"
+#include "portenumerator.h"
 #include "preferencesdialog.h"
+#include "session.h"
 
+#include <QLabel>
 #include <QMainWindow>
+#include <QProgressDialog>
 #include <QSettings>
-#include <QThread>
+#include <QTimer>
 
 namespace Ui {
 class MainWindow;
@@ -21,33 +26,80 @@ public:
     ~MainWindow();
 
     const QFont &logWidgetFont();
-
-signals:
-    void closePort();
-    void openSerialPort(const QString &pn, qint32 br);
-    void openLocalShell();
+    PortEnumerator *portEnumerator() const;
 
 public slots:
     void setLogWidgetSettings(const QFont &font, int tabStopWidthPixels);
 
+    // applied to the current session
+    void openSerialPort(const QString &pn, qint32 br);
+    void setSerialTuning(const SerialTuning &tuning);
+    void openLocalShell();
+    void openVirtualPort();
+    void closePort();
+
 protected:
     void keyPressEvent(QKeyEvent* event);
 
 private slots:
-    void updatePortStatus(AsyncPort::Status st, const QString &pn, qint32 br);
+    Session *newSession();
+    void newSessionWithPrefs();
+    void openPreferences();
+    void closeSession(int index);
+    void closeCurrentSession();
+    void openLog();
+    void currentSessionChanged();
+    void updatePortStatus();
+    void updateCounters();
     void customLogWidgetContextMenuRequested(const QPoint &pos);
     void setFindWidgetVisible(bool visible);
     void showFindWidget(void);
     void updateSearch();
-    void logWindowHorizontalBarRangeChanged(int min, int max);
+    void findNext();
+    void findPrev();
+    void toggleBookmark();
+    void nextBookmark();
+    void prevBookmark();
+    void clearBookmarks();
+    void editBookmarkRules();
+    void clearLog();
+    void clearLogToLine();
+    void paste();
+    void trimContentsHorizontally();
+    void setClipLines(bool clip);
+    void setHexViewVisible(bool visible);
+    void setFilterViewVisible(bool visible);
+    void setFraming();
+    void toggleCapture(bool checked);
+    void exportLog();
+    void exportFinished(bool ok, const QString &error);
+    void toggleScript(bool checked);
+    void showScriptMessage(const QString &text);
+    void scriptFinished(bool ok, const QString &error);
+    void setLatencyOverlayVisible(bool visible);
+    void dumpLatency();
+    void logWindowHorizontalBarRangeChanged();
 
 private:
     void writeSettings();
     void readSettings();
+    void updateFramingActions();
+    void openLastPort();
+    Session *currentSession() const;
+    PlainTextLog *currentLog() const;
 
     Ui::MainWindow *ui;
-    PreferencesDialog *m_dlgPrefs;
-    QThread m_asyncPortThread;
+    PreferencesDialog *m_dlgPrefs; // created when first opened
+    PortEnumerator *m_portEnumerator;
+    QFont m_logFont;
+    int m_logTabStopWidth;
+    QStringList m_bookmarkRules; // regular expressions, applied to all the sessions
+    QLabel *m_labelCounters;
+    QLabel *m_labelScript; // the last message of a script
+    LogExporter *m_exporter;
+    QProgressDialog *m_exportProgress; // while exporting
+    QTimer *m_countersTimer;
+    QTimer *m_searchTimer; // debounces the find phrase
 };
 
 #endif // MAINWINDOW_H
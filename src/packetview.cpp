@@ -0,0 +1,128 @@
+#include "packetview.h"
+
+#include <QDateTime>
+#include <QFontDatabase>
+#include <QPainter>
+#include <QScrollBar>
+
+static const int rowChars = 8 + 14 + 7 + 7 + PacketView::previewBytes * 3 + 1 + PacketView::previewBytes;
+
+PacketView::PacketView(QWidget *parent) :
+    QAbstractScrollArea(parent)
+{
+    setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+
+    verticalScrollBar()->setSingleStep(1);
+    horizontalScrollBar()->setSingleStep(fontMetrics().width('0'));
+
+    updateScrollBars();
+}
+
+int PacketView::frameCount() const
+{
+    return m_frames.size();
+}
+
+void PacketView::appendFrames(const QVector<FrameRecord> &frames)
+{
+    if (frames.isEmpty())
+    {
+        return;
+    }
+
+    QScrollBar *bar = verticalScrollBar();
+    bool atBottom = bar->value() == bar->maximum();
+
+    m_frames += frames;
+
+    updateScrollBars();
+
+    if (atBottom)
+    {
+        bar->setValue(bar->maximum());
+    }
+
+    viewport()->update();
+}
+
+void PacketView::clear()
+{
+    m_frames.clear();
+
+    updateScrollBars();
+    viewport()->update();
+}
+
+void PacketView::paintEvent(QPaintEvent *e)
+{
+    Q_UNUSED(e);
+
+    QPainter p(viewport());
+
+    const QFontMetrics &fm = fontMetrics();
+    const int charWidth = fm.width('0');
+    const int lineHeight = fm.height();
+
+    const QColor textColor = palette().color(QPalette::Text);
+    const QColor errorColor = QColor(0xC02020);
+    const QColor numberColor = palette().color(QPalette::Disabled, QPalette::Text);
+
+    p.translate(-horizontalScrollBar()->value(), 0);
+
+    const int firstRow = verticalScrollBar()->value();
+    const int rows = visibleRows() + 1; // the last one may be partially visible
+
+    for (int row = 0; row < rows && firstRow + row < m_frames.size(); ++row)
+    {
+        const FrameRecord &frame = m_frames.at(firstRow + row);
+        const int y = row * lineHeight + fm.ascent();
+
+        p.setPen(numberColor);
+        p.drawText(0, y, QString("%1").arg(firstRow + row, 7));
+
+        p.setPen(frame.status == FrameRecord::Ok ? textColor : errorColor);
+
+        QString status = (frame.status == FrameRecord::Ok) ? "ok" : (frame.status == FrameRecord::BadCrc) ? "crc" : "bad";
+
+        QString hex;
+        QString ascii;
+        const int shown = qMin(frame.payload.size(), int(previewBytes));
+        for (int i = 0; i < shown; ++i)
+        {
+            const uchar c = frame.payload.at(i);
+            hex += QString("%1 ").arg(c, 2, 16, QChar('0'));
+            ascii += QChar(c >= 0x20 && c < 0x7F ? c : '.');
+        }
+
+        p.drawText(8 * charWidth, y, QString("%1 %2 %3 %4 %5")
+                   .arg(QDateTime::fromMSecsSinceEpoch(frame.time).toString("hh:mm:ss.zzz"))
+                   .arg(frame.payload.size(), 6)
+                   .arg(status, -6)
+                   .arg(hex, -previewBytes * 3)
+                   .arg(ascii));
+    }
+}
+
+void PacketView::resizeEvent(QResizeEvent *e)
+{
+    QAbstractScrollArea::resizeEvent(e);
+
+    updateScrollBars();
+}
+
+void PacketView::updateScrollBars()
+{
+    int pageRows = visibleRows();
+
+    verticalScrollBar()->setPageStep(pageRows);
+    verticalScrollBar()->setRange(0, qMax(0, m_frames.size() - pageRows));
+
+    int rowWidth = rowChars * fontMetrics().width('0');
+    horizontalScrollBar()->setPageStep(viewport()->width());
+    horizontalScrollBar()->setRange(0, qMax(0, rowWidth - viewport()->width()));
+}
+
+int PacketView::visibleRows() const
+{
+    return qMax(1, viewport()->height() / fontMetrics().height());
+}
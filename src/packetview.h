@@ -0,0 +1,42 @@
+#ifndef PACKETVIEW_H
+#define PACKETVIEW_H
+
+#include "framedecoder.h"
+
+#include <QAbstractScrollArea>
+#include <QVector>
+
+//
+// List of the frames split out of the stream by a FrameDecoder: number, time, length, status
+// and the first bytes of the payload in hex and ASCII, broken frames in red.
+//
+// Only the rows in the viewport are formatted on paint, like in HexView.
+//
+
+class PacketView : public QAbstractScrollArea
+{
+    Q_OBJECT
+
+public:
+    explicit PacketView(QWidget *parent = 0);
+
+    static const int previewBytes = 32;
+
+    int frameCount() const;
+
+public slots:
+    void appendFrames(const QVector<FrameRecord> &frames);
+    void clear();
+
+protected:
+    void paintEvent(QPaintEvent *e);
+    void resizeEvent(QResizeEvent *e);
+
+private:
+    void updateScrollBars();
+    int visibleRows() const;
+
+    QVector<FrameRecord> m_frames;
+};
+
+#endif // PACKETVIEW_H
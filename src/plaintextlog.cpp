@@ -2,742 +2,2152 @@
 
 #include <QScrollBar>
 #include <QDebug>
-#include <QTextBlock>
 #include <QCursor>
 #include <QPainter>
 #include <QRegExpValidator>
 #include <QClipboard>
 #include <QApplication>
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <limits>
+
+static const int marksToWidgetBorder = 1;
+static const int markWidth = 8;
+static const int markHeight = 4;
+
+static int markYOffset(qint64 row, qint64 lineCount, int projection)
+{
+    return qRound(((row + 0.5) * projection) / lineCount);
+}
 
 PlainTextLog::PlainTextLog(QWidget *parent) :
-    QPlainTextEdit(parent),
-    m_highlighter(new SearchHighlighter(this)),
+    QAbstractScrollArea(parent),
+    m_store(&m_mainStore),
+    m_maxColumns(0),
+    m_tabStopWidth(0),
+    m_layoutCache(layoutCacheLines),
+    m_layoutCacheLookups(0),
+    m_layoutCacheHits(0),
+    m_clipToViewport(false),
+    m_editTransaction(false),
+    m_changedFromLine(std::numeric_limits<qint64>::max()),
     m_sideMarkScene(Q_NULLPTR),
+    m_contextMenuLine(-1),
+    m_latencyOverlayVisible(false),
+    m_latencyOverlayTimer(new QTimer(this)),
     m_decoder(Q_NULLPTR),
-    m_caret(QTextCursor(document()->lastBlock()))
+    m_caretLine(0),
+    m_caretColumn(0),
+    m_caretAttr(defaultTextAttr),
+    m_savedCaretLine(0),
+    m_savedCaretColumn(0),
+    m_terminalColumns(80),
+    m_terminalRows(24)
 {
-    const QString rx = "\\^\\[(?:\\[(?:(\\d*)(H)|(?:(\\d*)(?:;(\\d*))*)(m)|(?:(r))|(?:(\\d+);(\\d+)([rfH]))|(?:(\\d*)([ABCD]))|(?:([012]*)([JK]))|(?:\\?(\\d+)([hl]))|(?:([0]?)(c)))|([=>])|([()][0B])|([78M])|(#8))(.*)";
+    m_latencyOverlayTimer->setInterval(1000);
+    connect(m_latencyOverlayTimer, SIGNAL(timeout()), viewport(), SLOT(update()));
+
+    const QString rx = "\\^\\[(?:\\[(?:(\\d*)(H)|(?:(\\d*)(?:;(\\d*))*)(m)|(?:(r))|(?:(\\d+);(\\d+)([rfH]))|(?:(\\d*)([ABCDLM]))|(?:([012]*)([JK]))|(?:\\?(\\d+)([hl]))|(?:([0]?)(c)))|([=>])|([()][0B])|([78DEM])|(#8))(.*)";
 
     m_vt100escReV = new QRegularExpressionValidator(QRegularExpression(rx), this);
 
     this->setFocusPolicy(Qt::StrongFocus); // helps catching 'Control' key events on macOS
-    this->setUndoRedoEnabled(false);
-    this->setLineWrapMode(QPlainTextEdit::NoWrap);
-    this->setReadOnly(true);
-    this->setTextInteractionFlags(Qt::TextSelectableByMouse);
+    viewport()->setCursor(Qt::IBeamCursor);
+    verticalScrollBar()->setSingleStep(1);
 
     clear();
 
     QPalette palette = this->palette();
-    palette.setColor(QPalette::Text, m_caret.blockCharFormat().foreground().color());
-    palette.setColor(QPalette::Base, m_caret.blockCharFormat().background().color());
+    palette.setColor(QPalette::Text, attrForeground(defaultTextAttr));
+    palette.setColor(QPalette::Base, attrBackground(defaultTextAttr));
     setPalette(palette);
+}
 
-    // tests
-
-    //appendBytes("\x1B[2J@\x1B[12B@\x1B[12C@\x1B[2J");
-    //appendBytes("\x1B[2J@\x1B[D\x1B[12B@\x1B[D\x1B[12C@\x1B[D\x1B[6B$\x1B[D\x1B[0J\x1B[6A\x1B[0J");
-    //appendBytes("\x1B[2J@\x1B[D\x1B[12B@\x1B[D\x1B[12C@\x1B[D\x1B[D\x1B[1J");
-    //appendBytes("\x1B[H\x1B#8\x1B[2J");
+const ChunkLatency &PlainTextLog::chunkLatency() const
+{
+    return m_chunkLatency;
 }
 
-void PlainTextLog::setSideMarkScene(QGraphicsScene *sideMarkScene)
+bool PlainTextLog::isLatencyOverlayVisible() const
 {
-    m_sideMarkScene = sideMarkScene;
+    return m_latencyOverlayVisible;
 }
 
-LogBlockCustomData *PlainTextLog::highlightBlock(const QTextBlock &block)
+void PlainTextLog::setLatencyOverlayVisible(bool visible)
 {
-    if (!m_sideMarkScene)
+    m_latencyOverlayVisible = visible;
+
+    if (visible)
     {
-        return Q_NULLPTR;
+        m_latencyOverlayTimer->start();
+    }
+    else
+    {
+        m_latencyOverlayTimer->stop();
     }
 
-    QGraphicsRectItem *rect = new QGraphicsRectItem();
-    rect->setPen(QPen(Qt::darkYellow));
-    rect->setBrush(QBrush(Qt::yellow));
-    rect->setToolTip(tr("%1 (Line: %2)").arg(block.text()).arg(block.firstLineNumber()));
-
-    resizeMark(rect, block);
+    viewport()->update();
+}
 
-    m_sideMarkScene->addItem(rect);
+const PlainTextLog::ParserCounters &PlainTextLog::counters() const
+{
+    return m_counters;
+}
 
-    //TODO rect->setCursor(Qt::PointingHandCursor);
+qint64 PlainTextLog::scrollbackBytes() const
+{
+    return m_mainStore.memoryBytes() + m_altStore.memoryBytes();
+}
 
-    LogBlockCustomData *lbData = new LogBlockCustomData(rect);
+void PlainTextLog::setSideMarkScene(QGraphicsScene *sideMarkScene)
+{
+    m_sideMarkScene = sideMarkScene;
+}
 
-    return lbData;
+int PlainTextLog::terminalScreenWidth() const
+{
+    return m_terminalColumns;
 }
 
-void PlainTextLog::setContextMenuTextCursor(const QTextCursor &cur)
+int PlainTextLog::terminalScreenHeight() const
 {
-    m_contextMenuTextCursor = cur;
+    return m_terminalRows;
 }
 
-void PlainTextLog::setSearchPhrase(const QString &phrase, bool caseSensitive)
+#ifdef QMINICOM_TESTS
+QString PlainTextLog::screenSnapshot() const
 {
-    if (m_sideMarkScene)
-    {
-        m_sideMarkScene->clear();
-    }
+    // one row per line, '|' marks the end of the text so the trailing spaces show;
+    // the rows with non-default attributes are followed by their runs as column:attr
 
-    m_highlighter->setSearchPhrase(phrase, caseSensitive);
+    QString snapshot = QString("caret %1,%2\n").arg(caretRow()).arg(m_caretColumn);
 
-    if (m_sideMarkScene)
+    const qint64 top = screenTopLine();
+
+    for (int row = 0; row < m_terminalRows; ++row)
     {
-        m_sideMarkScene->setSceneRect(0,0,0,height()); // sync scene coordinates
+        const qint64 id = top + row;
+        LogLine line = (id < m_store->endLineId()) ? m_store->line(id) : LogLine();
+
+        snapshot += QString("%1 %2|\n").arg(row, 2, 10, QChar('0')).arg(line.text);
+
+        if (line.runs.size() > 1 || (line.runs.size() == 1 && line.runs.first().attr != defaultTextAttr))
+        {
+            QStringList runs;
+            foreach (const AttrRun &run, line.runs)
+            {
+                runs.append(QString("%1:%2").arg(run.start).arg(run.attr, 3, 16, QChar('0')));
+            }
+            snapshot += "   " + runs.join(' ') + '\n';
+        }
     }
+
+    return snapshot;
 }
+#endif
 
-void PlainTextLog::find(bool backward)
+int PlainTextLog::tabStopWidth() const
 {
-    QTextCursor cur = textCursor();
-    QTextBlock currentBlock = cur.block();
+    return m_tabStopWidth;
+}
 
-    for (int i = 0; i < document()->blockCount(); ++i) // protection against eternal cycle
-    {
-        if (currentBlock.userData() && (!backward || (backward && !cur.atBlockStart()))) // todo store a search selection cursor list in UserData
-        {
-            //LogBlockCustomData *lbData = dynamic_cast<LogBlockCustomData*>(uData);
-            //Q_ASSERT(lbData);
+void PlainTextLog::setTabStopWidth(int pixels)
+{
+    m_tabStopWidth = pixels;
 
-            int offset;
+    invalidateLayouts();
+    updateScrollBars();
+    viewport()->update();
+}
 
-            if (backward)
-            {
-                int from = (cur.positionInBlock() + cur.anchor() - cur.position()) - currentBlock.text().length() - 1;
-                offset = currentBlock.text().lastIndexOf(m_highlighter->searchPhrase(), from, m_highlighter->isCaseSensitive() ? Qt::CaseSensitive : Qt::CaseInsensitive);
-            }
-            else
-            {
-                int from = cur.positionInBlock();
-                offset = currentBlock.text().indexOf(m_highlighter->searchPhrase(), from, m_highlighter->isCaseSensitive() ? Qt::CaseSensitive : Qt::CaseInsensitive);
-            }
+qint64 PlainTextLog::lineAt(const QPoint &viewportPos) const
+{
+    return positionAt(viewportPos).line;
+}
 
-            if (offset >= 0)
-            {
-                cur.movePosition(QTextCursor::StartOfBlock);
+void PlainTextLog::setContextMenuLine(qint64 line)
+{
+    m_contextMenuLine = line;
+}
 
-                offset += cur.position();
+QMenu *PlainTextLog::createContextMenu()
+{
+    QMenu *menu = new QMenu(this);
 
-                cur.setPosition(offset);
-                cur.setPosition(offset + m_highlighter->searchPhrase().length(), QTextCursor::KeepAnchor);
+    QAction *copyAction = menu->addAction(tr("&Copy"), this, SLOT(copy()), QKeySequence::Copy);
+    copyAction->setEnabled(m_selectionAnchor < m_selectionEnd || m_selectionEnd < m_selectionAnchor);
 
-                setTextCursor(cur);
+    menu->addAction(tr("Select All"), this, SLOT(selectAll()), QKeySequence::SelectAll);
 
-                return;
-            }
-        }
+    if (!isAlternateScreenActive())
+    {
+        menu->addSeparator();
+        menu->addAction(tr("Toggle bookmark"), this, SLOT(toggleBookmarkAtContextMenuLine()));
+    }
 
-        if (backward)
-        {
-            currentBlock = currentBlock.previous();
-        }
-        else
-        {
-            currentBlock = currentBlock.next();
-        }
+    return menu;
+}
 
-        if (!currentBlock.isValid())
-        {
-            if (backward)
-            {
-                currentBlock = document()->lastBlock();
-            }
-            else
-            {
-                currentBlock = document()->firstBlock();
-            }
-        }
+QString PlainTextLog::selectedText() const
+{
+    TextPosition from = qMin(m_selectionAnchor, m_selectionEnd);
+    TextPosition to = qMax(m_selectionAnchor, m_selectionEnd);
 
-        cur = QTextCursor(currentBlock);
+    from.line = qMax(from.line, m_store->firstLineId());
+    to.line = qMin(to.line, m_store->endLineId() - 1);
 
-        if (backward)
-        {
-            cur.movePosition(QTextCursor::EndOfBlock);
-        }
+    QStringList lines;
+
+    for (qint64 l = from.line; l <= to.line; ++l)
+    {
+        QString text = m_store->text(l);
+
+        int start = (l == from.line) ? qMin(from.index, text.size()) : 0;
+        int end = (l == to.line) ? qMin(to.index, text.size()) : text.size();
+
+        lines.append(text.mid(start, qMax(0, end - start)));
     }
+
+    return lines.join('\n');
 }
 
-void PlainTextLog::sendVT100EscSeq(PlainTextLog::VT100EscapeCode code)
+void PlainTextLog::addSearchMark(qint64 line, const QString &text)
 {
-    if (code >= VT100_EC_FN_START && code <= VT100_EC_FN_END && !m_cursorMode)
+    if (!m_sideMarkScene)
     {
-        qDebug() << "Error:" << code << "is not supported for Cursor Mode = Cursor";
         return;
     }
 
-    QByteArray ba;
-    ba.append(0x1B); // <ESC>
+    // one mark per pixel row of the mark bar, the first line that lands on it gets it
 
-    switch(code)
+    QMap<qint64, QGraphicsRectItem *>::const_iterator prev = m_searchMarks.lowerBound(line);
+    if (prev != m_searchMarks.constBegin())
     {
-    case VT100_EC_DA_VT102:
-        ba.append('[');
-        ba.append('?');
-        ba.append('6');
-        ba.append('c');
-        break;
+        --prev;
 
-    case VT100_EC_ESC:
-        ba.append('[');
-        break;
+        const qint64 first = m_mainStore.firstLineId();
+        const qint64 lineCount = qMax(Q_INT64_C(1), m_mainStore.lineCount());
+        const int projection = markProjection();
 
-    case VT100_EC_UP:
-        ba.append(m_cursorMode ? 'O' : '[');
-        ba.append('A');
-        break;
+        if (markYOffset(prev.key() - first, lineCount, projection) == markYOffset(line - first, lineCount, projection))
+        {
+            return;
+        }
+    }
 
-    case VT100_EC_DOWN:
-        ba.append(m_cursorMode ? 'O' : '[');
-        ba.append('B');
-        break;
+    QGraphicsRectItem *rect = new QGraphicsRectItem();
+    rect->setPen(QPen(Qt::darkYellow));
+    rect->setBrush(QBrush(Qt::yellow));
+    rect->setToolTip(tr("%1 (Line: %2)").arg(text).arg(line - m_mainStore.firstLineId()));
 
-    case VT100_EC_RIGHT:
-        ba.append(m_cursorMode ? 'O' : '[');
-        ba.append('C');
-        break;
+    resizeMark(rect, line);
 
-    case VT100_EC_LEFT:
-        ba.append(m_cursorMode ? 'O' : '[');
-        ba.append('D');
-        break;
+    m_sideMarkScene->addItem(rect);
 
-    case VT100_EC_F1:
-        ba.append('O');
-        ba.append('P');
-        break;
+    //TODO rect->setCursor(Qt::PointingHandCursor);
 
-    case VT100_EC_F2:
-        ba.append('O');
-        ba.append('Q');
-        break;
+    m_searchMarks.insert(line, rect);
+}
 
-    case VT100_EC_F3:
-        ba.append('O');
-        ba.append('R');
-        break;
+void PlainTextLog::linesFinalized(qint64 from, qint64 to)
+{
+    // the lines won't change anymore, the marks of the screen lines are rechecked once
 
-    case VT100_EC_F4:
-        ba.append('O');
-        ba.append('S');
-        break;
+    for (qint64 l = from; l < to; ++l)
+    {
+        QGraphicsRectItem *mark = m_searchMarks.take(l);
+        if (mark)
+        {
+            delete mark;
+        }
 
-    default:
+        if (m_highlighter.isEmpty() && m_bookmarkRules.isEmpty())
         {
-            qDebug() << "Error: unknown VT100EscapeCode" << code;
-            return;
+            continue;
         }
-        break;
-    }
 
-    emit sendBytes(ba);
-}
+        QString text = m_store->text(l);
 
-void PlainTextLog::moveCaretToTheStartOfTheScreen()
-{
-    QTextBlock tb = document()->findBlockByNumber(m_cursorRelativeCoordinates ? m_screenScrollingRegionTop : m_screenTopLine);
-    if (!tb.isValid())
-    {
-        if (m_cursorRelativeCoordinates)
+        if (m_highlighter.matches(text))
         {
-            qDebug() << "Error: m_screenScrollingRegionTop =" << m_screenScrollingRegionTop << "block count = " << document()->blockCount();
+            addSearchMark(l, text);
         }
-        else
+
+        QMap<qint64, Bookmark>::iterator b = m_bookmarks.find(l);
+
+        if (b == m_bookmarks.end())
+        {
+            if (matchesBookmarkRule(text))
+            {
+                addBookmark(l, true);
+            }
+        }
+        else if (b->automatic)
         {
-            qDebug() << "Error: m_screenTopLine =" << m_screenTopLine << "block count = " << document()->blockCount();
+            // added while the line was on the screen, maybe before it was complete
+            b->text = text.trimmed();
+            if (b->mark)
+            {
+                b->mark->setToolTip(bookmarkToolTip(l, *b));
+            }
         }
-        tb = document()->lastBlock();
     }
-
-    m_caret = QTextCursor(tb);
 }
 
-void PlainTextLog::findNext()
+bool PlainTextLog::matchesBookmarkRule(const QString &text) const
 {
-    find(false);
-}
+    foreach (const QRegularExpression &rx, m_bookmarkRules)
+    {
+        if (rx.match(text).hasMatch())
+        {
+            return true;
+        }
+    }
 
-void PlainTextLog::findPrev()
-{
-    find(true);
+    return false;
 }
 
-void PlainTextLog::caretBackspace()
+QString PlainTextLog::bookmarkToolTip(qint64 line, const Bookmark &bookmark) const
 {
-    moveCaretToTheLeftBy(1);
+    return tr("%1 %2 (Line: %3)").arg(bookmark.time.toString("hh:mm:ss"))
+            .arg(bookmark.text).arg(line - m_mainStore.firstLineId());
 }
 
-void PlainTextLog::setCaretBrightness(bool bright)
+void PlainTextLog::setBookmarkRules(const QStringList &patterns)
 {
-    m_caretBrightness = bright;
-    updateCaretAttributes();
-}
+    m_bookmarkRules.clear();
 
-void PlainTextLog::setCaretInvertedColors(bool invert)
-{
-    m_caretInvertedColors = invert;
-    updateCaretAttributes();
+    foreach (const QString &pattern, patterns)
+    {
+        QRegularExpression rx(pattern);
+        if (pattern.isEmpty() || !rx.isValid())
+        {
+            qDebug() << "Warning: bad bookmark rule" << pattern << rx.errorString();
+            continue;
+        }
+
+        m_bookmarkRules.append(rx);
+    }
 }
 
-void PlainTextLog::setCaretUnderline(bool underline)
+int PlainTextLog::bookmarkCount() const
 {
-    m_caretUnderline = underline;
-    updateCaretAttributes();
+    return m_bookmarks.size();
 }
 
-void PlainTextLog::setCaretForeground(PlainTextLog::AnsiColor ansiColor)
+void PlainTextLog::addBookmark(qint64 line, bool automatic)
 {
-    m_caretFgColor = ansiColor;
-    updateCaretAttributes();
+    Bookmark bookmark;
+    bookmark.time = QTime::currentTime();
+    bookmark.text = m_mainStore.text(line).trimmed();
+    bookmark.automatic = automatic;
+    bookmark.mark = Q_NULLPTR;
+
+    if (m_sideMarkScene)
+    {
+        bookmark.mark = new QGraphicsRectItem();
+        bookmark.mark->setPen(QPen(automatic ? Qt::darkRed : Qt::darkBlue));
+        bookmark.mark->setBrush(QBrush(automatic ? Qt::red : QColor(0x4080FF)));
+        bookmark.mark->setToolTip(bookmarkToolTip(line, bookmark));
+        bookmark.mark->setZValue(1); // above the search marks
+
+        resizeMark(bookmark.mark, line);
+
+        m_sideMarkScene->addItem(bookmark.mark);
+    }
+
+    m_bookmarks.insert(line, bookmark);
 }
 
-void PlainTextLog::setCaretBackround(PlainTextLog::AnsiColor ansiColor)
+void PlainTextLog::removeBookmark(qint64 line)
 {
-    m_caretBgColor = ansiColor;
-    updateCaretAttributes();
+    delete m_bookmarks.take(line).mark;
 }
 
-bool PlainTextLog::setScrollingRegion(int top, int bottom)
+void PlainTextLog::toggleBookmark()
 {
-    if (bottom > top && top >= 0 && bottom < terminalScreenHeight)
+    if (isAlternateScreenActive())
     {
-        m_screenScrollingRegionTop = top;
-        m_screenScrollingRegionBottom = bottom;
-        moveCaretToTheStartOfTheScreen();
-        return true;
+        return;
+    }
+
+    if (m_selectionAnchor < m_selectionEnd || m_selectionEnd < m_selectionAnchor)
+    {
+        m_contextMenuLine = m_selectionEnd.line;
     }
     else
     {
-        return false;
+        m_contextMenuLine = m_caretLine;
     }
-}
 
-void PlainTextLog::resetCaretAttributes()
-{
-    m_caretBrightness = false;
-    m_caretUnderline = false;
-    m_caretInvertedColors = false;
-    m_caretFgColor = ANSI_WHITE;
-    m_caretBgColor = ANSI_BLACK;
-    updateCaretAttributes();
+    toggleBookmarkAtContextMenuLine();
 }
 
-void PlainTextLog::updateCaretAttributes()
+void PlainTextLog::toggleBookmarkAtContextMenuLine()
 {
-    m_tcfm.setFontUnderline(m_caretUnderline);
-    if (m_caretInvertedColors)
+    const qint64 line = m_contextMenuLine;
+
+    if (isAlternateScreenActive() || line < m_mainStore.firstLineId() || line >= m_mainStore.endLineId())
+    {
+        return;
+    }
+
+    if (m_bookmarks.contains(line))
     {
-        m_tcfm.setForeground(QBrush(QColor(ansiColorToRgb(m_caretBgColor, m_caretBrightness))));
-        m_tcfm.setBackground(QBrush(QColor(ansiColorToRgb(m_caretFgColor, false))));
+        removeBookmark(line);
     }
     else
     {
-        m_tcfm.setForeground(QBrush(QColor(ansiColorToRgb(m_caretFgColor, m_caretBrightness))));
-        m_tcfm.setBackground(QBrush(QColor(ansiColorToRgb(m_caretBgColor, false))));
+        addBookmark(line, false);
     }
+
+    viewport()->update();
+
+    emit bookmarksChanged(m_bookmarks.size());
 }
 
-void PlainTextLog::resetTextDecoder()
+void PlainTextLog::nextBookmark()
 {
-    if (m_decoder)
-    {
-        delete m_decoder;
-    }
-    m_decoder = new QTextDecoder(QTextCodec::codecForName("UTF-8")); // everyone should use utf8, right?
+    jumpToBookmark(false);
 }
 
-QRgb PlainTextLog::ansiColorToRgb(PlainTextLog::AnsiColor ansiColor, bool isBright)
+void PlainTextLog::prevBookmark()
 {
-    QRgb rgb;
+    jumpToBookmark(true);
+}
 
-    switch (ansiColor)
+void PlainTextLog::jumpToBookmark(bool backward)
+{
+    if (m_bookmarks.isEmpty() || isAlternateScreenActive())
     {
-    case ANSI_BLACK:    rgb = isBright ? 0x686868 : 0x000000;      break;
-    case ANSI_RED:      rgb = isBright ? 0xFF6F6B : 0xC91B00;      break;
-    case ANSI_GREEN:    rgb = isBright ? 0x67F86F : 0x00C120;      break;
-    case ANSI_YELLOW:   rgb = isBright ? 0xFFFA72 : 0xC7C327;      break;
-    case ANSI_BLUE:     rgb = isBright ? 0x6A76FC : 0x0A2FC4;      break;
-    case ANSI_MAGENTA:  rgb = isBright ? 0xFF7CFD : 0xC839C5;      break;
-    case ANSI_CYAN:     rgb = isBright ? 0x68FDFE : 0x01C5C6;      break;
-    case ANSI_WHITE:    rgb = isBright ? 0xFFFFFF : 0xC7C7C7;      break;
+        return;
     }
 
-    return rgb;
+    // from the selected line (a jump selects the line) or the top of the view, around at the ends
+
+    qint64 from = m_selectionEnd.line;
+    if (from < m_mainStore.firstLineId() || from >= m_mainStore.endLineId())
+    {
+        from = m_mainStore.firstLineId() + verticalScrollBar()->value();
+    }
+
+    QMap<qint64, Bookmark>::const_iterator i;
+
+    if (backward)
+    {
+        i = m_bookmarks.lowerBound(from);
+        i = (i == m_bookmarks.constBegin()) ? m_bookmarks.constEnd() - 1 : i - 1;
+    }
+    else
+    {
+        i = m_bookmarks.upperBound(from);
+        if (i == m_bookmarks.constEnd())
+        {
+            i = m_bookmarks.constBegin();
+        }
+    }
+
+    showLine(i.key());
+}
+
+void PlainTextLog::clearBookmarks()
+{
+    foreach (const Bookmark &bookmark, m_bookmarks)
+    {
+        delete bookmark.mark;
+    }
+    m_bookmarks.clear();
+
+    viewport()->update();
+
+    emit bookmarksChanged(0);
+}
+
+void PlainTextLog::setSearchPhrase(const QString &phrase, bool caseSensitive)
+{
+    qDeleteAll(m_searchMarks); // the bookmarks share the scene
+    m_searchMarks.clear();
+
+    m_highlighter.setSearchPhrase(phrase, caseSensitive);
+
+    if (!m_highlighter.isEmpty() && m_sideMarkScene)
+    {
+        // the marks belong to the main log, the alternate screen is transient
+
+        const LineStore &store = m_mainStore;
+        const qint64 first = store.firstLineId();
+        const qint64 end = store.endLineId();
+        const qint64 lineCount = qMax(Q_INT64_C(1), store.lineCount());
+        const int projection = markProjection();
+
+        QVector<int> indices(int((end - first + searchRangeLines - 1) / searchRangeLines));
+        for (int r = 0; r < indices.size(); ++r)
+        {
+            indices[r] = r;
+        }
+
+        // the store isn't modified while the GUI thread waits here, reading it from the pool is safe;
+        // each range keeps the first match of each mark row only
+
+        QVector<QVector<qint64> > results(indices.size());
+        QVector<qint64> *out = results.data(); // detached, each thread writes its own element
+
+        const SearchHighlighter &highlighter = m_highlighter;
+
+        QtConcurrent::blockingMap(indices, [&store, &highlighter, first, end, lineCount, projection, out](const int &r)
+        {
+            QVector<qint64> &ids = out[r];
+            int lastY = -1;
+
+            const qint64 rangeEnd = qMin(end, first + qint64(r + 1) * searchRangeLines);
+            for (qint64 l = first + qint64(r) * searchRangeLines; l < rangeEnd; ++l)
+            {
+                const int y = markYOffset(l - first, lineCount, projection);
+                if (y != lastY && highlighter.matches(store.textRef(l)))
+                {
+                    ids.append(l);
+                    lastY = y;
+                }
+            }
+        });
+
+        foreach (const QVector<qint64> &ids, results)
+        {
+            foreach (qint64 l, ids)
+            {
+                addSearchMark(l, store.text(l)); // skips the rows the previous range ended on
+            }
+        }
+    }
+
+    if (m_sideMarkScene)
+    {
+        m_sideMarkScene->setSceneRect(0,0,0,height()); // sync scene coordinates
+    }
+
+    viewport()->update();
+}
+
+void PlainTextLog::find(bool backward)
+{
+    if (m_highlighter.isEmpty())
+    {
+        return;
+    }
+
+    TextPosition selStart = qMin(m_selectionAnchor, m_selectionEnd);
+    TextPosition selEnd = qMax(m_selectionAnchor, m_selectionEnd);
+
+    qint64 line = backward ? selStart.line : selEnd.line;
+    int from = backward ? selStart.index - 1 : selEnd.index; // the last allowed match start when backward
+
+    if (line < m_store->firstLineId() || line >= m_store->endLineId())
+    {
+        line = backward ? m_store->endLineId() - 1 : m_store->firstLineId();
+        from = backward ? -1 : 0;
+    }
+
+    const qint64 lineCount = m_store->lineCount();
+
+    for (qint64 i = 0; i <= lineCount; ++i) // the starting line is searched again after the wrap
+    {
+        QString text = m_store->text(line);
+        int offset;
+
+        if (backward)
+        {
+            if (i == 0 && from < 0)
+            {
+                offset = -1; // the selection starts at the line start, nothing before it
+            }
+            else
+            {
+                offset = m_highlighter.lastIndexIn(text, i == 0 ? from : -1);
+            }
+        }
+        else
+        {
+            offset = m_highlighter.indexIn(text, i == 0 ? from : 0);
+        }
+
+        if (offset >= 0)
+        {
+            m_selectionAnchor.line = line;
+            m_selectionAnchor.index = offset;
+            m_selectionEnd.line = line;
+            m_selectionEnd.index = offset + m_highlighter.searchPhrase().length();
+
+            ensureLineVisible(line);
+
+            const int charWidth = fontMetrics().width(' ');
+            int x = columnOf(text, offset) * charWidth;
+            QScrollBar *hbar = horizontalScrollBar();
+            if (x < hbar->value() || x > hbar->value() + viewport()->width() - charWidth)
+            {
+                hbar->setValue(x - viewport()->width() / 2);
+            }
+
+            viewport()->update();
+
+            return;
+        }
+
+        if (backward)
+        {
+            line = (line == m_store->firstLineId()) ? m_store->endLineId() - 1 : line - 1;
+        }
+        else
+        {
+            line = (line == m_store->endLineId() - 1) ? m_store->firstLineId() : line + 1;
+        }
+    }
+}
+
+void PlainTextLog::findNext()
+{
+    find(false);
+}
+
+void PlainTextLog::findPrev()
+{
+    find(true);
+}
+
+void PlainTextLog::sendVT100EscSeq(PlainTextLog::VT100EscapeCode code)
+{
+    if (code >= VT100_EC_FN_START && code <= VT100_EC_FN_END && !m_cursorMode)
+    {
+        qDebug() << "Error:" << code << "is not supported for Cursor Mode = Cursor";
+        return;
+    }
+
+    QByteArray ba;
+    ba.append(0x1B); // <ESC>
+
+    switch(code)
+    {
+    case VT100_EC_DA_VT102:
+        ba.append('[');
+        ba.append('?');
+        ba.append('6');
+        ba.append('c');
+        break;
+
+    case VT100_EC_ESC:
+        ba.append('[');
+        break;
+
+    case VT100_EC_UP:
+        ba.append(m_cursorMode ? 'O' : '[');
+        ba.append('A');
+        break;
+
+    case VT100_EC_DOWN:
+        ba.append(m_cursorMode ? 'O' : '[');
+        ba.append('B');
+        break;
+
+    case VT100_EC_RIGHT:
+        ba.append(m_cursorMode ? 'O' : '[');
+        ba.append('C');
+        break;
+
+    case VT100_EC_LEFT:
+        ba.append(m_cursorMode ? 'O' : '[');
+        ba.append('D');
+        break;
+
+    case VT100_EC_F1:
+        ba.append('O');
+        ba.append('P');
+        break;
+
+    case VT100_EC_F2:
+        ba.append('O');
+        ba.append('Q');
+        break;
+
+    case VT100_EC_F3:
+        ba.append('O');
+        ba.append('R');
+        break;
+
+    case VT100_EC_F4:
+        ba.append('O');
+        ba.append('S');
+        break;
+
+    default:
+        {
+            qDebug() << "Error: unknown VT100EscapeCode" << code;
+            return;
+        }
+        break;
+    }
+
+    emit sendBytes(ba);
+}
+
+qint64 PlainTextLog::screenTopLine() const
+{
+    return qMax(m_store->firstLineId(), m_store->endLineId() - m_terminalRows);
+}
+
+LogLine &PlainTextLog::screenLine(int row)
+{
+    return m_store->editableLine(screenTopLine() + row);
+}
+
+LogLine &PlainTextLog::caretLine()
+{
+    return m_store->editableLine(m_caretLine);
+}
+
+void PlainTextLog::moveCaretToTheStartOfTheScreen()
+{
+    qint64 line = screenTopLine() + (m_cursorRelativeCoordinates ? m_screenScrollingRegionTop : 0);
+    if (line >= m_store->endLineId())
+    {
+        qDebug() << "Error: screen line" << line - screenTopLine() << "line count = " << m_store->endLineId() - screenTopLine();
+        line = m_store->endLineId() - 1;
+    }
+
+    m_caretLine = line;
+    m_caretColumn = 0;
 }
 
 void PlainTextLog::clear()
 {
     m_escSeq.clear();
+    m_pendingBytes.clear();
 
     resetTextDecoder();
 
-    QPlainTextEdit::clear();
+    m_altStore.clear();
+    m_store = &m_mainStore;
+
+    m_store->clear();
+    m_store->appendLine();
+    m_maxColumns = 0;
+    invalidateLayouts();
+
+    if (m_sideMarkScene)
+    {
+        m_sideMarkScene->clear();
+    }
+    m_searchMarks.clear();
+    m_bookmarks.clear();
+
+    m_caretLine = m_store->firstLineId();
+    m_caretColumn = 0;
+
+    m_selectionAnchor.line = m_caretLine;
+    m_selectionAnchor.index = 0;
+    m_selectionEnd = m_selectionAnchor;
+    m_contextMenuLine = -1;
 
-    m_screenTopLine = 0;
     m_cursorRelativeCoordinates = false;
 
-    setScrollingRegion(0, terminalScreenHeight - 1);
+    setScrollingRegion(0, m_terminalRows - 1);
 
     m_cursorMode = false;
 
     resetCaretAttributes();
+
+    updateScrollBars();
+    viewport()->update();
+
+    emit linesChanged(m_store->firstLineId(), m_store->endLineId());
+    emit bookmarksChanged(0);
 }
 
 void PlainTextLog::moveCaretToTheRightBy(int chars)
 {
     Q_ASSERT(chars >= 0);
 
-    int blockLength = m_caret.block().text().length();
-    int pos = m_caret.positionInBlock();
+    int lineLength = caretLine().text.length();
 
-    // qDebug() << "pos:" << pos << "chars:" << chars << "blockLength:" << blockLength;
+    // qDebug() << "pos:" << m_caretColumn << "chars:" << chars << "lineLength:" << lineLength;
 
-    if (pos + chars <= blockLength)
+    if (m_caretColumn + chars <= lineLength)
     {
-        m_caret.movePosition(QTextCursor::NextCharacter, QTextCursor::MoveAnchor, chars);
+        m_caretColumn += chars;
     }
     else
     {
-        m_caret.movePosition(QTextCursor::EndOfBlock); // fixme force repaint caret
-
-        int append = pos + chars - blockLength;
+        int append = m_caretColumn + chars - lineLength;
+        m_caretColumn = lineLength;
 
         //qDebug() << "appending symbols:" << append;
 
-        insertTextAtCaret(QString(append, ' '));
+        insertTextAtCaret(QString(append, ' '));
+    }
+}
+
+void PlainTextLog::moveCaretToTheLeftBy(int chars)
+{
+    Q_ASSERT(chars >= 0);
+
+    if (m_caretColumn < chars)
+    {
+        qDebug() << "Warning: attempt to cross the text block start boundary by" << chars - m_caretColumn << "symbols";
+        moveCaretToTheFirstColumn();
+    }
+    else
+    {
+        m_caretColumn -= chars;
+    }
+}
+
+void PlainTextLog::moveCaretToTheFirstColumn()
+{
+    m_caretColumn = 0;
+}
+
+void PlainTextLog::moveCaretUpwardsBy(int lines)
+{
+    Q_ASSERT(lines >= 0);
+
+    // stops at the top margin, or at the top of the screen when already above it
+
+    int row = caretRow();
+    int topRow = (row >= m_screenScrollingRegionTop) ? m_screenScrollingRegionTop : 0;
+    int target = qMax(topRow, row - lines);
+
+    if (target == row)
+    {
+        return;
+    }
+
+    int col_was = m_caretColumn;
+
+    m_caretLine -= row - target;
+    m_caretColumn = 0;
+    moveCaretToTheRightBy(col_was);
+}
+
+void PlainTextLog::moveCaretDownwardsWithinScreenBy(int lines)
+{
+    Q_ASSERT(lines >= 0);
+
+    // stops at the bottom margin, or at the bottom of the screen when already below it
+
+    int row = caretRow();
+    int bottomRow = (row <= m_screenScrollingRegionBottom) ? m_screenScrollingRegionBottom : m_terminalRows - 1;
+    int target = qMin(bottomRow, row + lines);
+
+    if (target > row)
+    {
+        moveCaretDownwardsBy(target - row);
+    }
+}
+
+int PlainTextLog::caretRow() const
+{
+    return m_caretLine - screenTopLine();
+}
+
+bool PlainTextLog::isScrollingRegionFullScreen() const
+{
+    return m_screenScrollingRegionTop == 0 && m_screenScrollingRegionBottom == m_terminalRows - 1;
+}
+
+void PlainTextLog::ensureScreenRows(int rows)
+{
+    // the screen fills up from the top, rows below the last line don't exist yet
+
+    qint64 end = m_store->endLineId();
+
+    while (m_store->endLineId() - screenTopLine() < rows)
+    {
+        m_store->appendLine();
+    }
+
+    if (m_store->endLineId() != end)
+    {
+        contentsChanged(end);
+    }
+}
+
+void PlainTextLog::updateTerminalSize()
+{
+    const int columns = qMax(2, viewport()->width() / fontMetrics().width(' '));
+    const int rows = qMax(2, viewport()->height() / fontMetrics().height());
+
+    if (columns == m_terminalColumns && rows == m_terminalRows)
+    {
+        return;
+    }
+
+    const bool fullScreenRegion = isScrollingRegionFullScreen();
+
+    if (rows > m_terminalRows)
+    {
+        // the screen grows into the scrollback, those lines become editable again
+        m_store->unfreezeLinesFrom(m_store->endLineId() - rows);
+    }
+    else
+    {
+        // keep the caret on the screen: the blank lines below it go first, then the top lines scroll away
+
+        while (m_caretLine < m_store->endLineId() - rows
+               && m_store->endLineId() - 1 > m_caretLine
+               && m_store->text(m_store->endLineId() - 1).isEmpty())
+        {
+            m_store->removeLastLine();
+        }
+    }
+
+    m_terminalColumns = columns;
+    m_terminalRows = rows;
+
+    if (fullScreenRegion || m_screenScrollingRegionBottom >= rows)
+    {
+        m_screenScrollingRegionTop = 0;
+        m_screenScrollingRegionBottom = rows - 1;
+    }
+
+    if (m_caretLine < screenTopLine())
+    {
+        m_caretLine = screenTopLine();
+        m_caretColumn = 0;
+    }
+
+    contentsChanged(screenTopLine());
+
+    emit terminalSizeChanged(columns, rows);
+}
+
+const LineStore &PlainTextLog::lineStore() const
+{
+    return m_mainStore;
+}
+
+bool PlainTextLog::isAlternateScreenActive() const
+{
+    return m_store == &m_altStore;
+}
+
+void PlainTextLog::setAlternateScreen(bool active, bool saveCaret)
+{
+    if (active == isAlternateScreenActive())
+    {
+        return;
+    }
+
+    if (m_changedFromLine != std::numeric_limits<qint64>::max())
+    {
+        applyContentsChanges(); // the ids are of the store being left
+    }
+
+    const int row = caretRow();
+    const int column = m_caretColumn;
+
+    if (active)
+    {
+        if (saveCaret)
+        {
+            m_savedCaretLine = m_caretLine;
+            m_savedCaretColumn = m_caretColumn;
+        }
+
+        m_altStore.clear();
+        m_store = &m_altStore;
+
+        ensureScreenRows(m_terminalRows);
+
+        m_caretLine = screenTopLine() + qMin(row, m_terminalRows - 1);
+    }
+    else
+    {
+        m_store = &m_mainStore;
+        m_altStore.clear();
+
+        if (saveCaret)
+        {
+            m_caretLine = qBound(screenTopLine(), m_savedCaretLine, m_store->endLineId() - 1);
+        }
+        else
+        {
+            m_caretLine = qMin(screenTopLine() + row, m_store->endLineId() - 1);
+        }
+    }
+
+    m_caretColumn = 0;
+    moveCaretToTheRightBy(saveCaret && !active ? m_savedCaretColumn : column);
+
+    m_selectionAnchor.line = m_caretLine;
+    m_selectionAnchor.index = 0;
+    m_selectionEnd = m_selectionAnchor;
+
+    invalidateLayouts(); // the ids of the two stores overlap
+
+    contentsChanged(screenTopLine());
+}
+
+void PlainTextLog::scrollRegion(int top, int bottom, int lines)
+{
+    // lines > 0 scrolls the contents up, lines < 0 down, the lines leaving the region are lost
+
+    ensureScreenRows(bottom + 1);
+
+    qint64 screenTop = screenTopLine();
+    m_store->rotateLines(screenTop + top, screenTop + bottom + 1, lines);
+
+    contentsChanged(screenTop + top);
+}
+
+void PlainTextLog::lineFeed()
+{
+    int row = caretRow();
+
+    if (row == m_screenScrollingRegionBottom && !isScrollingRegionFullScreen())
+    {
+        scrollRegion(m_screenScrollingRegionTop, m_screenScrollingRegionBottom, 1);
+    }
+    else
+    {
+        moveCaretDownwardsBy(1); // at the bottom of the screen the top line goes to the scrollback
+    }
+}
+
+void PlainTextLog::reverseLineFeed()
+{
+    int row = caretRow();
+
+    if (row == m_screenScrollingRegionTop)
+    {
+        scrollRegion(m_screenScrollingRegionTop, m_screenScrollingRegionBottom, -1);
+    }
+    else if (row > 0)
+    {
+        int col_was = m_caretColumn;
+
+        m_caretLine--;
+        m_caretColumn = 0;
+        moveCaretToTheRightBy(col_was);
+    }
+}
+
+void PlainTextLog::moveCaretDownwardsBy(int lines)
+{
+    Q_ASSERT(lines >= 0);
+
+
+    int col_was = m_caretColumn;
+
+    qint64 append = m_caretLine + lines - (m_store->endLineId() - 1);
+
+    for (qint64 i = 0; i < append; ++i)
+    {
+        m_store->appendLine();
+    }
+
+    m_caretLine += lines;
+    m_caretColumn = 0;
+    moveCaretToTheRightBy(col_was);
+
+    if (append > 0)
+    {
+        contentsChanged(m_store->endLineId() - append); // scrolls down if the view was at the bottom
+    }
+}
+
+void PlainTextLog::clearToCurrentContextMenuLine()
+{
+    // the ids of the alternate screen are not the ones of the bookmarks and of linesDropped()
+    if (isAlternateScreenActive() || m_contextMenuLine <= m_store->firstLineId())
+    {
+        return;
+    }
+
+    QScrollBar *vbar = verticalScrollBar();
+    const bool atBottom = vbar->value() == vbar->maximum();
+    const qint64 topLine = m_store->firstLineId() + vbar->value();
+
+    // whole chunks are dropped, ids of the remaining lines don't change,
+    // so the caret, the selection and the marks only need clamping
+
+    m_store->dropLinesBefore(m_contextMenuLine);
+
+    const qint64 first = m_store->firstLineId();
+
+    if (m_caretLine < first)
+    {
+        m_caretLine = first;
+        m_caretColumn = 0;
+    }
+
+    if (m_selectionAnchor.line < first)
+    {
+        m_selectionAnchor.line = first;
+        m_selectionAnchor.index = 0;
+    }
+
+    if (m_selectionEnd.line < first)
+    {
+        m_selectionEnd.line = first;
+        m_selectionEnd.index = 0;
+    }
+
+    while (!m_searchMarks.isEmpty() && m_searchMarks.firstKey() < first)
+    {
+        delete m_searchMarks.take(m_searchMarks.firstKey());
+    }
+
+    const int bookmarks = m_bookmarks.size();
+    while (!m_bookmarks.isEmpty() && m_bookmarks.firstKey() < first)
+    {
+        removeBookmark(m_bookmarks.firstKey());
+    }
+    if (m_bookmarks.size() != bookmarks)
+    {
+        emit bookmarksChanged(m_bookmarks.size());
+    }
+
+    resizeMarks();
+    contentsChanged(m_store->endLineId()); // nothing to re-measure
+
+    if (!atBottom)
+    {
+        vbar->setValue(int(qMax(Q_INT64_C(0), topLine - first))); // keep the same line at the top
+    }
+
+    emit linesDropped(first);
+}
+
+bool PlainTextLog::isClippedToViewport() const
+{
+    return m_clipToViewport;
+}
+
+void PlainTextLog::setClipToViewport(bool clip)
+{
+    m_clipToViewport = clip;
+
+    updateScrollBars();
+    viewport()->update();
+}
+
+static int trimIndex(const QString &text, int maxColumns, int tabs)
+{
+    // one pass over the monospace columns: the index to cut at or -1 if the line fits
+
+    int column = 0;
+
+    for (int i = 0; i < text.size(); ++i)
+    {
+        column = (text.at(i) == '\t') ? (column / tabs + 1) * tabs : column + 1;
+
+        if (column > maxColumns)
+        {
+            return qMax(0, i - 1);
+        }
+    }
+
+    return -1;
+}
+
+void PlainTextLog::trimContentsByTheRightEdge()
+{
+    const int maxColumns = viewport()->width() / fontMetrics().width(' ');
+    if (maxColumns < 2)
+    {
+        return;
+    }
+
+    const int tabs = tabColumns();
+
+    // the chunks are trimmed in parallel, the lambda must not touch the widget
+
+    m_store->transformLines([maxColumns, tabs](LogLine &line)
+    {
+        int cut = trimIndex(line.text, maxColumns, tabs);
+        if (cut >= 0)
+        {
+            line.truncate(cut);
+        }
+    });
+
+    m_maxColumns = qMin(m_maxColumns, maxColumns);
+    invalidateLayouts(); // the frozen lines have changed under their ids
+
+    if (m_caretColumn > caretLine().text.size())
+    {
+        m_caretColumn = caretLine().text.size();
+    }
+
+    updateScrollBars();
+    viewport()->update();
+
+    emit linesTrimmed();
+}
+
+void PlainTextLog::caretBackspace()
+{
+    moveCaretToTheLeftBy(1);
+}
+
+void PlainTextLog::setCaretBrightness(bool bright)
+{
+    m_caretBrightness = bright;
+    updateCaretAttributes();
+}
+
+void PlainTextLog::setCaretInvertedColors(bool invert)
+{
+    m_caretInvertedColors = invert;
+    updateCaretAttributes();
+}
+
+void PlainTextLog::setCaretUnderline(bool underline)
+{
+    m_caretUnderline = underline;
+    updateCaretAttributes();
+}
+
+void PlainTextLog::setCaretForeground(PlainTextLog::AnsiColor ansiColor)
+{
+    m_caretFgColor = ansiColor;
+    updateCaretAttributes();
+}
+
+void PlainTextLog::setCaretBackround(PlainTextLog::AnsiColor ansiColor)
+{
+    m_caretBgColor = ansiColor;
+    updateCaretAttributes();
+}
+
+bool PlainTextLog::setScrollingRegion(int top, int bottom)
+{
+    if (bottom > top && top >= 0 && bottom < m_terminalRows)
+    {
+        m_screenScrollingRegionTop = top;
+        m_screenScrollingRegionBottom = bottom;
+        moveCaretToTheStartOfTheScreen();
+        return true;
+    }
+    else
+    {
+        return false;
+    }
+}
+
+void PlainTextLog::resetCaretAttributes()
+{
+    m_caretBrightness = false;
+    m_caretUnderline = false;
+    m_caretInvertedColors = false;
+    m_caretFgColor = ANSI_WHITE;
+    m_caretBgColor = ANSI_BLACK;
+    updateCaretAttributes();
+}
+
+void PlainTextLog::updateCaretAttributes()
+{
+    m_caretAttr = TextAttr(m_caretFgColor | (m_caretBgColor << TextAttrBgShift));
+
+    if (m_caretBrightness)
+    {
+        m_caretAttr |= TextAttrBright;
+    }
+    if (m_caretUnderline)
+    {
+        m_caretAttr |= TextAttrUnderline;
+    }
+    if (m_caretInvertedColors)
+    {
+        m_caretAttr |= TextAttrInverse;
+    }
+}
+
+void PlainTextLog::resetTextDecoder()
+{
+    if (m_decoder)
+    {
+        delete m_decoder;
+    }
+    m_decoder = new QTextDecoder(QTextCodec::codecForName("UTF-8")); // everyone should use utf8, right?
+}
+
+QRgb PlainTextLog::ansiColorToRgb(PlainTextLog::AnsiColor ansiColor, bool isBright)
+{
+    QRgb rgb;
+
+    switch (ansiColor)
+    {
+    case ANSI_BLACK:    rgb = isBright ? 0x686868 : 0x000000;      break;
+    case ANSI_RED:      rgb = isBright ? 0xFF6F6B : 0xC91B00;      break;
+    case ANSI_GREEN:    rgb = isBright ? 0x67F86F : 0x00C120;      break;
+    case ANSI_YELLOW:   rgb = isBright ? 0xFFFA72 : 0xC7C327;      break;
+    case ANSI_BLUE:     rgb = isBright ? 0x6A76FC : 0x0A2FC4;      break;
+    case ANSI_MAGENTA:  rgb = isBright ? 0xFF7CFD : 0xC839C5;      break;
+    case ANSI_CYAN:     rgb = isBright ? 0x68FDFE : 0x01C5C6;      break;
+    case ANSI_WHITE:    rgb = isBright ? 0xFFFFFF : 0xC7C7C7;      break;
+    }
+
+    return rgb;
+}
+
+void PlainTextLog::paste()
+{
+    // TODO handle multiline/large content with care
+    sendBytes(QApplication::clipboard()->text().toUtf8()); // TODO other encodings
+}
+
+void PlainTextLog::keyPressEvent(QKeyEvent *e)
+{
+    if (e->matches(QKeySequence::Copy))
+    {
+        copy();
+        return;
+    }
+
+    if (e->matches(QKeySequence::SelectAll))
+    {
+        selectAll();
+        return;
+    }
+
+    QString t = e->text();
+
+    switch (e->key())
+    {
+    case Qt::Key_F1: sendVT100EscSeq(VT100_EC_F1); return;
+    case Qt::Key_F2: sendVT100EscSeq(VT100_EC_F2); return;
+    case Qt::Key_F3: sendVT100EscSeq(VT100_EC_F3); return;
+    case Qt::Key_F4: sendVT100EscSeq(VT100_EC_F4); return;
+    case Qt::Key_F5: sendVT100EscSeq(VT100_EC_F5); return;
+    case Qt::Key_F6: sendVT100EscSeq(VT100_EC_F6); return;
+    case Qt::Key_F7: sendVT100EscSeq(VT100_EC_F7); return;
+    case Qt::Key_F8: sendVT100EscSeq(VT100_EC_F8); return;
+    case Qt::Key_F9: sendVT100EscSeq(VT100_EC_F9); return;
+    case Qt::Key_F10:sendVT100EscSeq(VT100_EC_F10); return;
+    }
+
+    //qDebug() << e->key() << e->modifiers() << t;
+
+    const Qt::KeyboardModifier ctrlKeyModifier =
+#ifdef Q_OS_MAC
+    Qt::MetaModifier
+#else
+    Qt::ControlModifier
+#endif
+    ;
+
+    if (e->modifiers() == ctrlKeyModifier)
+    {
+        // for some reason, Qt5@macOS doesn't trigger this function upon Ctrl+<key> sequences
+        //
+        // solution: use Cmd+<key>
+
+        if (e->key() >= 'A' && e->key() <= 'Z')
+        {
+            if (e->matches(QKeySequence::Copy)
+                    || e->matches(QKeySequence::Paste)
+                    || e->matches(QKeySequence::Cut)
+                    || e->matches(QKeySequence::Find)
+                    || e->matches(QKeySequence::FindNext)
+                    || e->matches(QKeySequence::FindPrevious)
+                    || e->matches(QKeySequence::SelectAll))
+            {
+                qDebug() << QString("Not processing ^%1 (standard action)").arg(QChar(e->key()).toUpper());
+            }
+            else
+            {
+                // (0x41) -> ^A -> 01
+                // ..................
+                // (0x5A) -> ^Z -> 26
+
+                //qDebug() << QString("sending ctrl-seq: ^%1").arg((char) e->key());
+                char code = e->key() - 0x40;
+
+                emit sendBytes(QByteArray().append(code));
+
+                return; // we've handled that
+            }
+        }
+    }
+    else if (t.length() == 1)
+    {
+        QChar ch = t.at(0);
+
+        //qDebug() << "char:" << (int) ch.toLatin1() << ch.toLatin1();
+
+        if (e->key() == Qt::Key_Backspace)
+        {
+            //TODO add an option to send Ctrl+H instead
+            //qDebug() << "bksp";
+        }
+
+        emit sendBytes(QByteArray().append(ch.toLatin1()));
+
+        return; // we've handled that
+    }
+    else
+    {
+        switch (e->key())
+        {
+        case Qt::Key_Up:
+            sendVT100EscSeq(VT100_EC_UP);
+            return;
+
+        case Qt::Key_Down:
+            sendVT100EscSeq(VT100_EC_DOWN);
+            return;
+
+        case Qt::Key_Right:
+            sendVT100EscSeq(VT100_EC_RIGHT);
+            return;
+
+        case Qt::Key_Left:
+            sendVT100EscSeq(VT100_EC_LEFT);
+            return;
+
+        default:
+            break;
+        }
+    }
+
+    QAbstractScrollArea::keyPressEvent(e);
+}
+
+void PlainTextLog::copy()
+{
+    QString text = selectedText();
+
+    if (!text.isEmpty())
+    {
+        QApplication::clipboard()->setText(text);
+    }
+}
+
+void PlainTextLog::selectAll()
+{
+    m_selectionAnchor.line = m_store->firstLineId();
+    m_selectionAnchor.index = 0;
+    m_selectionEnd.line = m_store->endLineId() - 1;
+    m_selectionEnd.index = m_store->text(m_selectionEnd.line).size();
+
+    viewport()->update();
+}
+
+void PlainTextLog::resizeEvent(QResizeEvent *e)
+{
+    QAbstractScrollArea::resizeEvent(e);
+
+    updateTerminalSize();
+    updateScrollBars();
+    resizeMarks();
+
+    if (m_sideMarkScene)
+    {
+        m_sideMarkScene->setSceneRect(0,0,0,height()); // sync scene coordinates
+    }
+}
+
+void PlainTextLog::changeEvent(QEvent *e)
+{
+    QAbstractScrollArea::changeEvent(e);
+
+    if (e->type() == QEvent::FontChange)
+    {
+        horizontalScrollBar()->setSingleStep(fontMetrics().width(' '));
+
+        invalidateLayouts();
+        updateTerminalSize();
+        updateScrollBars();
+        resizeMarks();
+        viewport()->update();
+    }
+}
+
+void PlainTextLog::scrollContentsBy(int dx, int dy)
+{
+    Q_UNUSED(dx);
+    Q_UNUSED(dy);
+
+    viewport()->update(); // the lines are painted from the scroll bar values
+}
+
+void PlainTextLog::mousePressEvent(QMouseEvent *e)
+{
+    if (e->button() != Qt::LeftButton)
+    {
+        QAbstractScrollArea::mousePressEvent(e);
+        return;
+    }
+
+    m_selectionEnd = positionAt(e->pos());
+
+    if (!(e->modifiers() & Qt::ShiftModifier))
+    {
+        m_selectionAnchor = m_selectionEnd;
+    }
+
+    viewport()->update();
+}
+
+void PlainTextLog::mouseMoveEvent(QMouseEvent *e)
+{
+    if (!(e->buttons() & Qt::LeftButton))
+    {
+        QAbstractScrollArea::mouseMoveEvent(e);
+        return;
+    }
+
+    // drag past the edge scrolls
+
+    if (e->pos().y() < 0)
+    {
+        verticalScrollBar()->triggerAction(QAbstractSlider::SliderSingleStepSub);
+    }
+    else if (e->pos().y() > viewport()->height())
+    {
+        verticalScrollBar()->triggerAction(QAbstractSlider::SliderSingleStepAdd);
+    }
+
+    m_selectionEnd = positionAt(e->pos());
+
+    viewport()->update();
+}
+
+void PlainTextLog::mouseDoubleClickEvent(QMouseEvent *e)
+{
+    if (e->button() != Qt::LeftButton)
+    {
+        QAbstractScrollArea::mouseDoubleClickEvent(e);
+        return;
+    }
+
+    TextPosition pos = positionAt(e->pos());
+    QString text = m_store->text(pos.line);
+
+    int start = qMin(pos.index, text.size());
+    int end = start;
+
+    while (start > 0 && (text.at(start - 1).isLetterOrNumber() || text.at(start - 1) == '_'))
+    {
+        start--;
+    }
+
+    while (end < text.size() && (text.at(end).isLetterOrNumber() || text.at(end) == '_'))
+    {
+        end++;
+    }
+
+    m_selectionAnchor.line = pos.line;
+    m_selectionAnchor.index = start;
+    m_selectionEnd.line = pos.line;
+    m_selectionEnd.index = end;
+
+    viewport()->update();
+}
+
+void PlainTextLog::paintEvent(QPaintEvent *e)
+{
+    Q_UNUSED(e);
+
+    QPainter p(viewport());
+
+    p.fillRect(viewport()->rect(), attrBackground(defaultTextAttr));
+
+    if (m_clipToViewport)
+    {
+        // whole columns only, like the trim would leave them
+
+        const int charWidth = fontMetrics().width(' ');
+        p.setClipRect(0, 0, (viewport()->width() / charWidth) * charWidth, viewport()->height());
+    }
+
+    const int lineHeight = fontMetrics().height();
+    const qint64 firstLine = m_store->firstLineId() + verticalScrollBar()->value();
+    const int rows = viewport()->height() / lineHeight + 1; // the last one may be partially visible
+
+    for (int row = 0; row < rows; ++row)
+    {
+        qint64 line = firstLine + row;
+        if (line >= m_store->endLineId())
+        {
+            break;
+        }
+
+        paintLine(p, line, row * lineHeight);
+    }
+
+    if (m_caretLine >= firstLine && m_caretLine < firstLine + rows)
+    {
+        int x = columnOf(m_store->text(m_caretLine), m_caretColumn) * fontMetrics().width(' ') - horizontalScrollBar()->value();
+        int y = (m_caretLine - firstLine) * lineHeight;
+
+        p.fillRect(QRect(x, y, 2, lineHeight), attrForeground(m_caretAttr));
+    }
+
+    // the chunk is on the screen once the frame is composed, close enough for the purpose
+
+    foreach (qint64 timestamp, m_unpaintedChunks)
+    {
+        m_chunkLatency.add(ChunkLatency::Painted, timestamp);
+    }
+    m_unpaintedChunks.clear();
+
+    if (m_latencyOverlayVisible)
+    {
+        QFont overlayFont = font();
+        overlayFont.setPointSizeF(overlayFont.pointSizeF() * 0.8);
+        p.setFont(overlayFont);
+
+        const int margin = 4;
+
+        const QString stats = m_chunkLatency.toString() + "\n" + layoutCacheStats();
+
+        QRect textRect = p.fontMetrics().boundingRect(QRect(), Qt::AlignLeft | Qt::TextDontClip, stats);
+        textRect.moveTopRight(viewport()->rect().topRight() + QPoint(-2 * margin, 2 * margin));
+
+        p.fillRect(textRect.adjusted(-margin, -margin, margin, margin), QColor(0, 0, 0, 180));
+        p.setPen(Qt::green);
+        p.drawText(textRect, Qt::AlignLeft | Qt::TextDontClip, stats);
+    }
+}
+
+const PlainTextLog::LineLayout *PlainTextLog::lineLayout(qint64 line)
+{
+    const quint32 revision = m_store->revision(line);
+
+    m_layoutCacheLookups++;
+
+    LineLayout *layout = m_layoutCache.object(line);
+    if (layout && layout->revision == revision)
+    {
+        m_layoutCacheHits++;
+        return layout;
+    }
+
+    // attribute runs, tabs split them into pieces laid out at their own columns
+
+    const LogLine logLine = m_store->line(line);
+    const QString &text = logLine.text;
+    const int tabs = tabColumns();
+
+    QFont underlineFont = font();
+    underlineFont.setUnderline(true);
+
+    layout = new LineLayout();
+    layout->revision = revision;
+
+    int column = 0;
+
+    for (int r = 0; r < logLine.runs.size(); ++r)
+    {
+        const TextAttr attr = logLine.runs.at(r).attr;
+        const int start = logLine.runs.at(r).start;
+        const int end = (r + 1 < logLine.runs.size()) ? logLine.runs.at(r + 1).start : text.size();
+
+        int pieceStart = start;
+        int pieceColumn = column;
+
+        for (int i = start; i <= end; ++i)
+        {
+            bool tab = i < end && text.at(i) == '\t';
+
+            if (i == end || tab)
+            {
+                if (i > pieceStart)
+                {
+                    LinePiece piece;
+                    piece.column = pieceColumn;
+                    piece.columns = column - pieceColumn;
+                    piece.attr = attr;
+                    piece.text.setTextFormat(Qt::PlainText);
+                    piece.text.setPerformanceHint(QStaticText::AggressiveCaching);
+                    piece.text.setText(text.mid(pieceStart, i - pieceStart));
+                    piece.text.prepare(QTransform(), (attr & TextAttrUnderline) ? underlineFont : font());
+                    layout->pieces.append(piece);
+                }
+
+                if (tab)
+                {
+                    LinePiece gap;
+                    gap.column = column;
+                    column = (column / tabs + 1) * tabs;
+                    gap.columns = column - gap.column;
+                    gap.attr = attr;
+                    layout->pieces.append(gap);
+                }
+
+                pieceStart = i + 1;
+                pieceColumn = column;
+            }
+            else
+            {
+                column++;
+            }
+        }
+    }
+
+    layout->columns = column;
+
+    m_layoutCache.insert(line, layout);
+
+    return layout;
+}
+
+void PlainTextLog::invalidateLayouts()
+{
+    m_layoutCache.clear();
+}
+
+QString PlainTextLog::layoutCacheStats() const
+{
+    if (m_layoutCacheLookups == 0)
+    {
+        return QString("layout cache: no lookups");
+    }
+
+    return QString("layout cache: %1% hits, %2 lines")
+            .arg(100.0 * m_layoutCacheHits / m_layoutCacheLookups, 0, 'f', 1)
+            .arg(m_layoutCache.size());
+}
+
+void PlainTextLog::paintLine(QPainter &p, qint64 line, int y)
+{
+    const LineLayout *layout = lineLayout(line);
+
+    const QFontMetrics &fm = fontMetrics();
+    const int charWidth = fm.width(' ');
+    const int lineHeight = fm.height();
+    const int left = -horizontalScrollBar()->value();
+    const int right = viewport()->width();
+    const QColor defaultBackground = attrBackground(defaultTextAttr);
+
+    if (m_store == &m_mainStore && m_bookmarks.contains(line))
+    {
+        p.fillRect(QRect(0, y, right, lineHeight), QColor(0x20, 0x30, 0x60));
+    }
+
+    QFont underlineFont = font();
+    underlineFont.setUnderline(true);
+
+    foreach (const LinePiece &piece, layout->pieces)
+    {
+        int x = left + piece.column * charWidth;
+        int width = piece.columns * charWidth;
+
+        if (x >= right)
+        {
+            break; // the rest is out of the viewport
+        }
+
+        if (x + width <= 0)
+        {
+            continue;
+        }
+
+        QColor background = attrBackground(piece.attr);
+        if (background != defaultBackground)
+        {
+            p.fillRect(QRect(x, y, width, lineHeight), background);
+        }
+
+        if (!piece.text.text().isEmpty())
+        {
+            p.setPen(attrForeground(piece.attr));
+            p.setFont((piece.attr & TextAttrUnderline) ? underlineFont : font());
+            p.drawStaticText(x, y, piece.text);
+        }
+    }
+
+    p.setFont(font());
+
+    TextPosition selStart = qMin(m_selectionAnchor, m_selectionEnd);
+    TextPosition selEnd = qMax(m_selectionAnchor, m_selectionEnd);
+    const bool selected = selStart < selEnd && line >= selStart.line && line <= selEnd.line;
+
+    if (m_highlighter.isEmpty() && !selected)
+    {
+        return;
+    }
+
+    const QString text = m_store->text(line);
+
+    // search matches
+
+    if (!m_highlighter.isEmpty())
+    {
+        QFont boldFont = font();
+        boldFont.setBold(true);
+        p.setFont(boldFont);
+        p.setPen(Qt::black);
+
+        const int baseline = y + fm.ascent();
+        const int length = m_highlighter.searchPhrase().length();
+
+        for (int ix = m_highlighter.indexIn(text, 0); ix >= 0; ix = m_highlighter.indexIn(text, ix + length))
+        {
+            int x = left + columnOf(text, ix) * charWidth;
+            int width = (columnOf(text, ix + length) - columnOf(text, ix)) * charWidth;
+
+            if (x >= right)
+            {
+                break;
+            }
+
+            p.fillRect(QRect(x, y, width, lineHeight), QColor(0xFEF935));
+            p.drawText(x, baseline, text.mid(ix, length));
+        }
+
+        p.setFont(font());
+    }
+
+    // selection
+
+    if (selected)
+    {
+        int fromColumn = (line == selStart.line) ? columnOf(text, selStart.index) : 0;
+        int toColumn = (line == selEnd.line) ? columnOf(text, selEnd.index) : layout->columns + 1; // + the line break
+
+        QColor highlight = palette().color(QPalette::Highlight);
+        highlight.setAlpha(110);
+
+        p.fillRect(QRect(left + fromColumn * charWidth, y, (toColumn - fromColumn) * charWidth, lineHeight), highlight);
+    }
+}
+
+void PlainTextLog::showEvent(QShowEvent *e)
+{
+    QAbstractScrollArea::showEvent(e);
+
+    if (!m_pendingBytes.isEmpty())
+    {
+        QByteArray bytes;
+        bytes.swap(m_pendingBytes);
+        processBytes(bytes);
+    }
+}
+
+void PlainTextLog::updateScrollBars()
+{
+    QScrollBar *vbar = verticalScrollBar();
+    bool atBottom = vbar->value() == vbar->maximum();
+
+    const int pageLines = qMax(1, viewport()->height() / fontMetrics().height());
+
+    vbar->setPageStep(pageLines);
+    vbar->setRange(0, int(qMax(Q_INT64_C(0), m_store->lineCount() - pageLines)));
+
+    if (atBottom)
+    {
+        vbar->setValue(vbar->maximum());
     }
+
+    QScrollBar *hbar = horizontalScrollBar();
+    int contentsWidth = (m_maxColumns + 1) * fontMetrics().width(' '); // + the caret
+
+    hbar->setPageStep(viewport()->width());
+    hbar->setRange(0, m_clipToViewport ? 0 : qMax(0, contentsWidth - viewport()->width()));
 }
 
-void PlainTextLog::moveCaretToTheLeftBy(int chars)
+void PlainTextLog::contentsChanged(qint64 fromLine)
 {
-    Q_ASSERT(chars >= 0);
+    m_changedFromLine = qMin(m_changedFromLine, fromLine);
 
-    if (m_caret.positionInBlock() < chars)
-    {
-        qDebug() << "Warning: attempt to cross the text block start boundary by" << chars - m_caret.positionInBlock() << "symbols";
-        moveCaretToTheFirstColumn();
-    }
-    else
+    if (m_editTransaction)
     {
-        m_caret.movePosition(QTextCursor::Left, QTextCursor::MoveAnchor, chars);
+        return; // applied once at the end of the chunk
     }
+
+    applyContentsChanges();
 }
 
-void PlainTextLog::moveCaretToTheFirstColumn()
+void PlainTextLog::beginEditTransaction()
 {
-    m_caret.movePosition(QTextCursor::StartOfBlock);
+    m_editTransaction = true;
 }
 
-void PlainTextLog::moveCaretUpwardsBy(int lines)
+void PlainTextLog::endEditTransaction()
 {
-    Q_ASSERT(lines >= 0);
+    m_editTransaction = false;
 
-    int col_was = m_caret.positionInBlock();
-
-    if (m_caret.blockNumber() + (m_cursorRelativeCoordinates ? m_screenScrollingRegionTop : m_screenTopLine) < lines)
-    {
-        qDebug() << "Warning: attempt to cross the screen start boundary by" << lines - (m_caret.blockNumber() + (m_cursorRelativeCoordinates ? m_screenScrollingRegionTop : m_screenTopLine)) << "lines";
-        qDebug() << "TODO implement sticky edge";
-    }
-    else
+    if (m_changedFromLine != std::numeric_limits<qint64>::max())
     {
-        QTextBlock tb = document()->findBlockByNumber(m_caret.blockNumber() + (m_cursorRelativeCoordinates ? m_screenScrollingRegionTop : m_screenTopLine) - lines);
-        Q_ASSERT(tb.isValid());
-        m_caret = QTextCursor(tb);
-        moveCaretToTheRightBy(col_was);
+        applyContentsChanges();
     }
 }
 
-void PlainTextLog::moveCaretDownwardsBy(int lines)
+void PlainTextLog::applyContentsChanges()
 {
-    Q_ASSERT(lines >= 0);
-
-    // scroll -- take old scrollbar value
-    QScrollBar *p_scroll_bar = this->verticalScrollBar();
-    bool bool_at_bottom = (p_scroll_bar->value() == p_scroll_bar->maximum());
-
-    // TODO check for terminalScreenHeight
-
-    int blocks = document()->blockCount();
-    int blockIx = m_caret.blockNumber();
+    qint64 changedFrom = qMax(m_changedFromLine, m_store->firstLineId());
+    m_changedFromLine = std::numeric_limits<qint64>::max();
 
-    //qDebug() << blockIx << lines << blocks;
+    const int bookmarks = m_bookmarks.size();
 
-    int col_was = m_caret.positionInBlock();
+    // the rules see the screen lines as they change, e.g. a status line redrawn in place never scrolls off;
+    // the bookmarks belong to the main log
+    const bool checkRules = !m_bookmarkRules.isEmpty() && !isAlternateScreenActive();
 
-    if (blockIx + lines >= blocks)
+    for (qint64 line = changedFrom; line < m_store->endLineId(); ++line)
     {
-        int append = blockIx + lines - blocks + 1;
-
-        QTextCursor cur(document()->lastBlock());
-        cur.movePosition(QTextCursor::EndOfBlock);
-
-        for (int i = 0; i < append; ++i)
+        const QString text = m_store->text(line);
+        if (text.size() > m_maxColumns || text.contains('\t'))
         {
-            cur.insertBlock();
+            m_maxColumns = qMax(m_maxColumns, columnOf(text, text.size()));
         }
 
-        if (document()->blockCount() != blockIx + lines + 1)
+        if (checkRules && !m_bookmarks.contains(line) && matchesBookmarkRule(text))
         {
-            qDebug() << "Error: appended" << append << "but got" << document()->blockCount() << "blockIx" << blockIx << lines;
+            addBookmark(line, true);
         }
     }
 
-    QTextBlock tb = document()->findBlockByNumber(blockIx + lines);
-    if (!tb.isValid())
+    // the lines above the screen are final: frozen into the chunks and checked for the side marks,
+    // the alternate screen has no scrollback
+
+    qint64 screenTop = screenTopLine();
+    qint64 editable = m_store->editableLineId();
+
+    if (editable < screenTop)
     {
-        qDebug() << "Error:" << __FUNCTION__ << lines << "invalid block at" << blockIx + lines << "document()->blockCount() = " << document()->blockCount();
-        tb = document()->lastBlock();
+        if (isAlternateScreenActive())
+        {
+            m_store->dropLinesBefore(screenTop);
+        }
+        else
+        {
+            m_store->freezeLinesBefore(screenTop);
+            linesFinalized(editable, screenTop);
+        }
     }
-    m_caret = QTextCursor(tb);
-    moveCaretToTheRightBy(col_was);
 
-    // scroll down if needed
-    if (bool_at_bottom)
+    if (m_bookmarks.size() != bookmarks)
     {
-        p_scroll_bar->setValue(p_scroll_bar->maximum());
+        emit bookmarksChanged(m_bookmarks.size());
     }
+
+    updateScrollBars();
+    viewport()->update();
+
+    emit linesChanged(changedFrom, m_store->endLineId());
 }
 
-void PlainTextLog::clearToCurrentContextMenuLine()
+void PlainTextLog::showLine(qint64 line)
 {
-    QTextCursor cur(document());
-    cur.beginEditBlock();
+    if (isAlternateScreenActive() || line < m_store->firstLineId() || line >= m_store->endLineId())
     {
-        cur.movePosition(QTextCursor::Start);
-        cur.movePosition(QTextCursor::NextCharacter, QTextCursor::KeepAnchor, m_contextMenuTextCursor.block().position());
-        cur.removeSelectedText();
+        return;
     }
-    cur.endEditBlock();
-}
-
-void PlainTextLog::trimContentsByTheRightEdge()
-{
-    int maxBlockWidth = viewport()->width();
 
-    QTextBlock currentBlock = document()->begin();
-    while (currentBlock.isValid())
-    {
-        if (blockBoundingRect(currentBlock).right() > maxBlockWidth)
-        {
-            int i = 0;
-            QString str;
-            QFontMetrics fm(font());
+    ensureLineVisible(line);
 
-            for (i = 0; i < currentBlock.text().size(); )
-            {
-                str += currentBlock.text().at(i);
-                if (fm.size(Qt::TextExpandTabs, str, this->tabStopWidth()).width() > maxBlockWidth)
-                {
-                    break;
-                }
-                i++;
-            }
+    m_selectionAnchor.line = line;
+    m_selectionAnchor.index = 0;
+    m_selectionEnd.line = line;
+    m_selectionEnd.index = m_store->text(line).size();
 
-            Q_ASSERT(i > 1);
+    viewport()->update();
+}
 
-            QTextCursor cur(currentBlock);
-            cur.beginEditBlock();
-            {
-                cur.movePosition(QTextCursor::NextCharacter, QTextCursor::MoveAnchor, i - 1);
-                cur.movePosition(QTextCursor::EndOfBlock, QTextCursor::KeepAnchor);
-                cur.removeSelectedText();
-            }
-            cur.endEditBlock();
-        }
+void PlainTextLog::ensureLineVisible(qint64 line)
+{
+    QScrollBar *vbar = verticalScrollBar();
+    qint64 row = line - m_store->firstLineId();
 
-        currentBlock = currentBlock.next();
+    if (row < vbar->value())
+    {
+        vbar->setValue(row);
+    }
+    else if (row >= vbar->value() + vbar->pageStep())
+    {
+        vbar->setValue(row - vbar->pageStep() + 1);
     }
 }
 
-void PlainTextLog::paste()
+PlainTextLog::TextPosition PlainTextLog::positionAt(const QPoint &viewportPos) const
 {
-    // TODO handle multiline/large content with care
-    sendBytes(QApplication::clipboard()->text().toUtf8()); // TODO other encodings
-}
+    const int charWidth = fontMetrics().width(' ');
 
-void PlainTextLog::resizeEvent(QResizeEvent *e)
-{
-    QPlainTextEdit::resizeEvent(e);
+    qint64 line = m_store->firstLineId() + verticalScrollBar()->value() + qMax(0, viewportPos.y()) / fontMetrics().height();
+    line = qBound(m_store->firstLineId(), line, m_store->endLineId() - 1);
 
-    QTextBlock currentBlock = document()->begin();
-    while (currentBlock.isValid())
-    {
-        QTextBlockUserData *uData = currentBlock.userData();
+    int column = qMax(0, (viewportPos.x() + horizontalScrollBar()->value() + charWidth / 2) / charWidth);
 
-        if (uData)
-        {
-            LogBlockCustomData *lbData = dynamic_cast<LogBlockCustomData*>(uData);
-            Q_ASSERT(lbData);
+    TextPosition pos;
+    pos.line = line;
+    pos.index = indexAtColumn(m_store->text(line), column);
 
-            if (lbData->m_item)
-            {
-                resizeMark(lbData->m_item, currentBlock);
-            }
-        }
-        currentBlock = currentBlock.next();
-    }
+    return pos;
+}
 
-    if (m_sideMarkScene)
+int PlainTextLog::tabColumns() const
+{
+    if (m_tabStopWidth <= 0)
     {
-        m_sideMarkScene->setSceneRect(0,0,0,height()); // sync scene coordinates
+        return 8;
     }
+
+    return qMax(1, qRound(qreal(m_tabStopWidth) / fontMetrics().width(' ')));
 }
 
-void PlainTextLog::keyPressEvent(QKeyEvent *e)
+int PlainTextLog::columnOf(const QString &text, int index) const
 {
-    QString t = e->text();
+    const int tabs = tabColumns();
+    const int end = qMin(index, text.size());
 
-    switch (e->key())
+    int column = 0;
+
+    for (int i = 0; i < end; ++i)
     {
-    case Qt::Key_F1: sendVT100EscSeq(VT100_EC_F1); return;
-    case Qt::Key_F2: sendVT100EscSeq(VT100_EC_F2); return;
-    case Qt::Key_F3: sendVT100EscSeq(VT100_EC_F3); return;
-    case Qt::Key_F4: sendVT100EscSeq(VT100_EC_F4); return;
-    case Qt::Key_F5: sendVT100EscSeq(VT100_EC_F5); return;
-    case Qt::Key_F6: sendVT100EscSeq(VT100_EC_F6); return;
-    case Qt::Key_F7: sendVT100EscSeq(VT100_EC_F7); return;
-    case Qt::Key_F8: sendVT100EscSeq(VT100_EC_F8); return;
-    case Qt::Key_F9: sendVT100EscSeq(VT100_EC_F9); return;
-    case Qt::Key_F10:sendVT100EscSeq(VT100_EC_F10); return;
+        column = (text.at(i) == '\t') ? (column / tabs + 1) * tabs : column + 1;
     }
 
-    //qDebug() << e->key() << e->modifiers() << t;
+    return column + qMax(0, index - text.size());
+}
 
-    const Qt::KeyboardModifier ctrlKeyModifier =
-#ifdef Q_OS_MAC
-    Qt::MetaModifier
-#else
-    Qt::ControlModifier
-#endif
-    ;
+int PlainTextLog::indexAtColumn(const QString &text, int column) const
+{
+    const int tabs = tabColumns();
 
-    if (e->modifiers() == ctrlKeyModifier)
-    {
-        // for some reason, Qt5@macOS doesn't trigger this function upon Ctrl+<key> sequences
-        //
-        // solution: use Cmd+<key>
+    int c = 0;
 
-        if (e->key() >= 'A' && e->key() <= 'Z')
+    for (int i = 0; i < text.size(); ++i)
+    {
+        if (c >= column)
         {
-            if (e->matches(QKeySequence::Copy)
-                    || e->matches(QKeySequence::Paste)
-                    || e->matches(QKeySequence::Cut)
-                    || e->matches(QKeySequence::Find)
-                    || e->matches(QKeySequence::FindNext)
-                    || e->matches(QKeySequence::FindPrevious)
-                    || e->matches(QKeySequence::SelectAll))
-            {
-                qDebug() << QString("Not processing ^%1 (standard action)").arg(QChar(e->key()).toUpper());
-            }
-            else
-            {
-                // (0x41) -> ^A -> 01
-                // ..................
-                // (0x5A) -> ^Z -> 26
+            return i;
+        }
 
-                //qDebug() << QString("sending ctrl-seq: ^%1").arg((char) e->key());
-                char code = e->key() - 0x40;
+        c = (text.at(i) == '\t') ? (c / tabs + 1) * tabs : c + 1;
+    }
 
-                emit sendBytes(QByteArray().append(code));
+    return text.size();
+}
 
-                return; // we've handled that
-            }
-        }
-    }
-    else if (t.length() == 1)
-    {
-        QChar ch = t.at(0);
+void PlainTextLog::resizeMark(QGraphicsRectItem *item, qint64 line)
+{
+    Q_ASSERT(item);
 
-        //qDebug() << "char:" << (int) ch.toLatin1() << ch.toLatin1();
+    qint64 lineCount = qMax(Q_INT64_C(1), m_mainStore.lineCount());
+    int yOffset = markYOffset(line - m_mainStore.firstLineId(), lineCount, markProjection());
 
-        if (e->key() == Qt::Key_Backspace)
-        {
-            //TODO add an option to send Ctrl+H instead
-            //qDebug() << "bksp";
-        }
+    item->setRect(-markWidth/2, marksToWidgetBorder + yOffset, markWidth, markHeight);
+}
 
-        emit sendBytes(QByteArray().append(ch.toLatin1()));
+int PlainTextLog::markProjection() const
+{
+    // the height the mark offsets spread over
 
-        return; // we've handled that
-    }
-    else
-    {
-        switch (e->key())
-        {
-        case Qt::Key_Up:
-            sendVT100EscSeq(VT100_EC_UP);
-            return;
+    qint64 contentsHeight = qMax(Q_INT64_C(1), m_mainStore.lineCount()) * fontMetrics().height();
+    return int(qMin(qint64(height() - 2*marksToWidgetBorder), contentsHeight) - markHeight);
+}
 
-        case Qt::Key_Down:
-            sendVT100EscSeq(VT100_EC_DOWN);
-            return;
+void PlainTextLog::resizeMarks()
+{
+    QMap<qint64, QGraphicsRectItem *>::const_iterator i;
 
-        case Qt::Key_Right:
-            sendVT100EscSeq(VT100_EC_RIGHT);
-            return;
+    for (i = m_searchMarks.constBegin(); i != m_searchMarks.constEnd(); ++i)
+    {
+        resizeMark(i.value(), i.key());
+    }
 
-        case Qt::Key_Left:
-            sendVT100EscSeq(VT100_EC_LEFT);
-            return;
+    QMap<qint64, Bookmark>::const_iterator b;
 
-        default:
-            break;
+    for (b = m_bookmarks.constBegin(); b != m_bookmarks.constEnd(); ++b)
+    {
+        if (b.value().mark)
+        {
+            resizeMark(b.value().mark, b.key());
         }
     }
-
-    QPlainTextEdit::keyPressEvent(e);
 }
 
-void PlainTextLog::paintEvent(QPaintEvent *e)
+QColor PlainTextLog::attrForeground(TextAttr attr) const
 {
-    QPlainTextEdit::paintEvent(e);
+    bool bright = attr & TextAttrBright;
 
-    if (m_caret.block().isVisible())
+    if (attr & TextAttrInverse)
     {
-        QPainter p(viewport());
-        p.fillRect(this->cursorRect(m_caret), m_tcfm.foreground());
+        return QColor(ansiColorToRgb(AnsiColor(textAttrBackground(attr)), bright));
     }
+
+    return QColor(ansiColorToRgb(AnsiColor(textAttrForeground(attr)), bright));
 }
 
-int PlainTextLog::getLastBlockBottom()
+QColor PlainTextLog::attrBackground(TextAttr attr) const
 {
-    const QTextBlock &lastBlock = document()->lastBlock();
-    const QTextBlock &firstBlock = document()->firstBlock();
-    return blockBoundingGeometry(lastBlock).bottom() - blockBoundingGeometry(firstBlock).top();
+    if (attr & TextAttrInverse)
+    {
+        return QColor(ansiColorToRgb(AnsiColor(textAttrForeground(attr)), false));
+    }
+
+    return QColor(ansiColorToRgb(AnsiColor(textAttrBackground(attr)), false));
 }
 
-void PlainTextLog::resizeMark(QGraphicsRectItem *item, const QTextBlock &block)
+void PlainTextLog::appendBytes(const QByteArray &bytes, qint64 timestamp)
 {
-    Q_ASSERT(item);
+    // a hidden log (background session) has nothing to render: don't even parse
+    // until it is shown, unless too much has piled up. Such chunks are not traced,
+    // their latency is the time the tab stayed in the background.
+
+    const int pendingBytesLimit = 4 * 1024 * 1024;
+
+    if (!isVisible())
+    {
+        m_pendingBytes += bytes;
+
+        if (m_pendingBytes.size() < pendingBytesLimit)
+        {
+            return;
+        }
 
-    const int marksToWidgetBorder = 1;
-    const int markWidth = 8;
-    const int markHeight = 4;
+        QByteArray pending;
+        pending.swap(m_pendingBytes);
+        processBytes(pending);
+        return;
+    }
 
-    int rootFrameHeight = getLastBlockBottom();
-    int maxLine = document()->lineCount();
-    int documentYProjection = qMin(height() - 2*marksToWidgetBorder, rootFrameHeight) - markHeight;
+    if (timestamp >= 0)
+    {
+        m_chunkLatency.add(ChunkLatency::Delivered, timestamp);
+    }
 
-    //qDebug() << rootFrameHeight << maxLine << documentYProjection << height();
+    if (!m_pendingBytes.isEmpty())
+    {
+        m_pendingBytes += bytes;
 
-    qreal blockLine = block.firstLineNumber() + ((qreal) block.lineCount()) / 2;
-    int markYOffset = qRound(((qreal) blockLine * documentYProjection) / maxLine);
+        QByteArray pending;
+        pending.swap(m_pendingBytes);
+        processBytes(pending);
+    }
+    else
+    {
+        processBytes(bytes);
+    }
 
-    item->setRect(-markWidth/2, marksToWidgetBorder + markYOffset, markWidth, markHeight);
+    if (timestamp >= 0)
+    {
+        m_chunkLatency.add(ChunkLatency::Parsed, timestamp);
 
-    //qDebug() << markYOffset << block.text();
+        if (m_unpaintedChunks.size() >= ChunkLatency::sampleCount) // nothing visible has changed for a while
+        {
+            m_unpaintedChunks.remove(0, m_unpaintedChunks.size() / 2);
+        }
+        m_unpaintedChunks.append(timestamp);
+    }
 }
 
-void PlainTextLog::appendBytes(const QByteArray &bytes, bool insertCR)
+void PlainTextLog::processBytes(const QByteArray &bytes)
 {
     //
     // With a great help of: http://www.vt100.net/docs/vt102-ug/appendixc.html
     //                       http://www.vt100.net/docs/vt100-ug
     //
 
-    QRect caretWasRect = this->cursorRect(m_caret);
+    m_counters.bytes += bytes.size();
+
+    // everything the chunk changes is applied to the view at once
+
+    beginEditTransaction();
 
     //qDebug() << bytes;
 
@@ -768,11 +2178,14 @@ void PlainTextLog::appendBytes(const QByteArray &bytes, bool insertCR)
             if (st == QRegExpValidator::Invalid)
             {
                 insertTextAtCaret(m_escSeq);
+                m_counters.unsupportedSequences++;
                 qDebug() << QString("Warning: unknown VT100 sequence %1%2").arg(m_escSeq).arg(QString(bytes.right(bytes.size() - i).left(16)));
                 m_escSeq.clear();
             }
             else if (st == QRegExpValidator::Acceptable)
             {
+                m_counters.sequences++;
+
                 //qDebug() << m_escSeq;
 
                 QRegularExpressionMatch m = m_vt100escReV->regularExpression().match(m_escSeq);
@@ -814,22 +2227,31 @@ void PlainTextLog::appendBytes(const QByteArray &bytes, bool insertCR)
 
                     //qDebug() << "Detected" << cmd << "command, args:" << args;
 
+                    const bool isCsi = m_escSeq.startsWith("^[[");
+
                     if (cmd == "K")
                     {
                         if (args.isEmpty() || args.at(0) == "0")
                         {
                             // clear eol
-                            m_caret.movePosition(QTextCursor::EndOfBlock, QTextCursor::KeepAnchor);
-                            m_caret.removeSelectedText();
+                            caretLine().truncate(m_caretColumn);
+                            contentsChanged(m_caretLine);
                         }
                         else if (args.at(0) == "1")
                         {
-                            int pos = m_caret.positionInBlock();
-                            moveCaretToTheRightBy(pos);
-                            insertTextAtCaret(QString(pos, ' '));
+                            // clear from the start of the line up to the caret, inclusive
+                            caretLine().write(0, QString(m_caretColumn + 1, ' '), m_caretAttr);
+                            contentsChanged(m_caretLine);
+                        }
+                        else if (args.at(0) == "2")
+                        {
+                            // clear the whole line, the caret stays
+                            caretLine().truncate(0);
+                            contentsChanged(m_caretLine);
                         }
                         else
                         {
+                            m_counters.unsupportedSequences++;
                             qDebug() << "Not supported:" << m_escSeq;
                         }
                     }
@@ -838,91 +2260,35 @@ void PlainTextLog::appendBytes(const QByteArray &bytes, bool insertCR)
                         if (args.isEmpty() || (args.size() == 1 && args.at(0) == "0"))
                         {
                             // clear eol
-                            m_caret.movePosition(QTextCursor::EndOfBlock, QTextCursor::KeepAnchor);
-                            m_caret.removeSelectedText();
-
-                            // clear all the lines below (XXX only down to the screen?)
-                            QTextBlock bl = m_caret.block().next();
-                            while (bl.isValid()) {
-                                QTextCursor cur(bl);
-                                cur.select(QTextCursor::BlockUnderCursor);
-                                cur.removeSelectedText();
-                                bl = bl.next();
-                            }
+                            caretLine().truncate(m_caretColumn);
+
+                            // clear all the screen lines below
+                            m_store->clearLines(m_caretLine + 1, m_store->endLineId());
+
+                            contentsChanged(m_caretLine);
                         }
                         else if (args.size() == 1 && args.at(0) == "1")
                         {
-                            int col_was = m_caret.positionInBlock();
-                            int row_was = m_caret.blockNumber() - m_screenTopLine;
-                            Q_ASSERT(row_was >= 0);
-
-                            //qDebug() << "was #" << col_was << row_was;
+                            Q_ASSERT(m_caretLine >= screenTopLine());
 
-                            QTextBlock block = document()->findBlockByNumber(m_screenTopLine);
-                            Q_ASSERT(block.isValid());
+                            m_store->clearLines(screenTopLine(), m_caretLine);
 
-                            for (int line = 0; line < row_was; ++line)
-                            {
-                                Q_ASSERT(block.isValid());
-
-                                QTextCursor cur(block);
-                                cur.insertText(" ");
-                                cur.movePosition(QTextCursor::EndOfBlock, QTextCursor::KeepAnchor);
-                                cur.removeSelectedText();
-
-                                block = block.next();
-                            }
-
-                            int col_is = m_caret.positionInBlock();
-                            int row_is = m_caret.blockNumber() - m_screenTopLine;
-                            Q_ASSERT(col_is == col_was);
-                            Q_ASSERT(row_is == row_was);
-
-                            moveCaretToTheFirstColumn();
-
-                            QString s;
-                            for (int i = 0; i < col_was + 1; ++i) // erase including the cursor position
-                            {
-                                s += " ";
-                            }
-                            insertTextAtCaret(s);
+                            // erase including the caret position
+                            caretLine().write(0, QString(m_caretColumn + 1, ' '), m_caretAttr);
 
-                            moveCaretToTheLeftBy(1);
+                            contentsChanged(screenTopLine());
                         }
                         else if (args.size() == 1 && args.at(0) == "2")
                         {
-                            int col_was = m_caret.positionInBlock();
-                            int row_was = m_caret.blockNumber() - m_screenTopLine;
-                            Q_ASSERT(row_was >= 0);
-
-                            QTextBlock block = document()->findBlockByNumber(m_screenTopLine);
-                            Q_ASSERT(block.isValid());
-
-                            for (int line = 0; line < terminalScreenHeight; ++line)
-                            {
-                                if (!block.isValid())
-                                {
-                                    break;
-                                }
-
-                                QTextCursor cur(block);
-                                cur.insertText(" ");
-                                cur.movePosition(QTextCursor::EndOfBlock, QTextCursor::KeepAnchor);
-                                cur.removeSelectedText();
+                            qint64 top = screenTopLine();
 
-                                block = block.next();
-                            }
-
-                            moveCaretToTheFirstColumn();
-                            moveCaretToTheRightBy(col_was);
+                            m_store->clearLines(top, qMin(top + m_terminalRows, m_store->endLineId()));
 
-                            int col_is = m_caret.positionInBlock();
-                            int row_is = m_caret.blockNumber() - m_screenTopLine;
-                            Q_ASSERT(col_is == col_was);
-                            Q_ASSERT(row_is == row_was);
+                            contentsChanged(top);
                         }
                         else
                         {
+                            m_counters.unsupportedSequences++;
                             qDebug() << "Not supported:" << m_escSeq;
                         }
                     }
@@ -935,6 +2301,7 @@ void PlainTextLog::appendBytes(const QByteArray &bytes, bool insertCR)
                         else if (args.at(0) == "38")
                         {
                             // extended color table
+                            m_counters.unsupportedSequences++;
                             qDebug() << "Not supported:" << m_escSeq;
                         }
                         else
@@ -972,6 +2339,7 @@ void PlainTextLog::appendBytes(const QByteArray &bytes, bool insertCR)
                                 case 5: //Blink
                                 case 8: //Hidden
                                 default:
+                                    m_counters.unsupportedSequences++;
                                     qDebug() << "Not supported: m-sequence param" << p << "of" << m_escSeq << "escape sequence";
                                     break;
                                 }
@@ -986,18 +2354,22 @@ void PlainTextLog::appendBytes(const QByteArray &bytes, bool insertCR)
 
                         if (cmd == "=")
                         {
+                            m_counters.unsupportedSequences++;
                             qDebug() << QString("Not supported: 'Application Keypad Mode' %1").arg(m_escSeq);
                         }
                         else if (cmd == ">")
                         {
+                            m_counters.unsupportedSequences++;
                             qDebug() << QString("Not supported: 'Numeric Keypad Mode' %1").arg(m_escSeq);
                         }
                         else if (cmd == ")0")
                         {
+                            m_counters.unsupportedSequences++;
                             qDebug() << QString("Not supported: 'Set G1 special chars. & line set' %1").arg(m_escSeq);
                         }
                         else if (cmd == "(B")
                         {
+                            m_counters.unsupportedSequences++;
                             qDebug() << QString("Not supported: 'Set United States G0 character set' %1").arg(m_escSeq);
                         }
                         else if (cmd == "H" || cmd == "f")
@@ -1008,6 +2380,7 @@ void PlainTextLog::appendBytes(const QByteArray &bytes, bool insertCR)
                             }
                             else if (args.length() == 1)
                             {
+                                m_counters.unsupportedSequences++;
                                 qDebug() << QString("Not supported: '?fH' %1").arg(m_escSeq);
                             }
                             else
@@ -1026,8 +2399,9 @@ void PlainTextLog::appendBytes(const QByteArray &bytes, bool insertCR)
                                 }
                                 else
                                 {
-                                    //qDebug() << m_escSeq << "m_screenTopLine = " << m_screenTopLine;
-                                    moveCaretToTheStartOfTheScreen();
+                                    //qDebug() << m_escSeq << "screenTopLine() = " << screenTopLine();
+                                    m_caretLine = screenTopLine();
+                                    m_caretColumn = 0;
 
                                     if (m_cursorRelativeCoordinates)
                                     {
@@ -1044,15 +2418,15 @@ void PlainTextLog::appendBytes(const QByteArray &bytes, bool insertCR)
                                     moveCaretDownwardsBy(row);
                                     moveCaretToTheRightBy(column);
 
-                                    if (m_caret.blockNumber() != row + m_screenTopLine || m_caret.positionInBlock() != column)
+                                    if (m_caretLine != row + screenTopLine() || m_caretColumn != column)
                                     {
                                         qDebug() << QString("Error: Cursor positioned to (%1,%2) instead of (%3,%4)")
-                                                    .arg(m_caret.blockNumber()).arg(m_caret.positionInBlock())
+                                                    .arg(m_caretLine - screenTopLine()).arg(m_caretColumn)
                                                     .arg(row).arg(column);
                                     }
 
                                     //qDebug() << m_escSeq << QString("Cursor: row=%1, col=%2; Scroll region: top=%3, bottom=%4")
-                                    //            .arg(m_caret.blockNumber() - m_screenTopLine).arg(m_caret.positionInBlock())
+                                    //            .arg(m_caretLine - screenTopLine()).arg(m_caretColumn)
                                     //            .arg(m_screenScrollingRegionTop).arg(m_screenScrollingRegionBottom);
                                 }
                             }
@@ -1073,7 +2447,7 @@ void PlainTextLog::appendBytes(const QByteArray &bytes, bool insertCR)
                             {
                                 lines = args.at(0).toInt(); // todo add check
                             }
-                            moveCaretDownwardsBy(lines);
+                            moveCaretDownwardsWithinScreenBy(lines);
                         }
                         else if (cmd == "C")
                         {
@@ -1084,7 +2458,7 @@ void PlainTextLog::appendBytes(const QByteArray &bytes, bool insertCR)
                             }
                             moveCaretToTheRightBy(chars);
                         }
-                        else if (cmd == "D")
+                        else if (cmd == "D" && isCsi)
                         {
                             int chars = 1;
                             if (!args.isEmpty())
@@ -1093,26 +2467,47 @@ void PlainTextLog::appendBytes(const QByteArray &bytes, bool insertCR)
                             }
                             moveCaretToTheLeftBy(chars);
                         }
-                        else if (cmd == "M")
+                        else if (cmd == "D" || cmd == "E")
+                        {
+                            // IND: the same column on the next line, at the bottom margin the region scrolls up.
+                            // NEL: the same at the first column.
+
+                            lineFeed();
+
+                            if (cmd == "E")
+                            {
+                                moveCaretToTheFirstColumn();
+                            }
+                        }
+                        else if (cmd == "M" && !isCsi)
                         {
-                            // Move the active position to the same horizontal position on the preceding line.
+                            // RI: move the active position to the same horizontal position on the preceding line.
                             // If the active position is at the top margin, a scroll down is performed.
 
-                            qDebug() << m_escSeq << QString("Cursor: row=%1, col=%2; Scroll region: top=%3, bottom=%4")
-                                        .arg(m_caret.blockNumber() - m_screenTopLine).arg(m_caret.positionInBlock())
-                                        .arg(m_screenScrollingRegionTop).arg(m_screenScrollingRegionBottom);
+                            reverseLineFeed();
+                        }
+                        else if (cmd == "L" || cmd == "M")
+                        {
+                            // IL/DL: insert or delete lines at the caret row, the rest of the scrolling region
+                            // moves down or up. Ignored outside of the region.
 
-                            if (m_caret.blockNumber() - m_screenTopLine == m_screenScrollingRegionTop)
+                            int lines = 1;
+                            if (!args.isEmpty())
                             {
-                                //
+                                lines = qMax(1, args.at(0).toInt());
                             }
-                            else
+
+                            int row = caretRow();
+
+                            if (row >= m_screenScrollingRegionTop && row <= m_screenScrollingRegionBottom)
                             {
-                                //
+                                scrollRegion(row, m_screenScrollingRegionBottom, cmd == "L" ? -lines : lines);
+                                moveCaretToTheFirstColumn();
                             }
                         }
                         else if (cmd == "?")
                         {
+                            m_counters.unsupportedSequences++;
                             qDebug() << QString("Not supported: '?' %1").arg(m_escSeq);
                         }
                         else if (cmd == "r")
@@ -1132,7 +2527,7 @@ void PlainTextLog::appendBytes(const QByteArray &bytes, bool insertCR)
                             }
                             else if (args.length() == 0)
                             {
-                                setScrollingRegion(0, terminalScreenHeight - 1);
+                                setScrollingRegion(0, m_terminalRows - 1);
                             }
                             else
                             {
@@ -1164,6 +2559,7 @@ void PlainTextLog::appendBytes(const QByteArray &bytes, bool insertCR)
                                     break;
 
                                 case 4:
+                                    m_counters.unsupportedSequences++;
                                     qDebug() << "Not supported: 'Set smooth scroll'";
                                     break;
 
@@ -1173,11 +2569,23 @@ void PlainTextLog::appendBytes(const QByteArray &bytes, bool insertCR)
                                     break;
 
                                 case 7:
+                                    m_counters.unsupportedSequences++;
                                     qDebug() << "Not supported: 'Set auto-wrap mode'";
                                     break;
 
+                                case 47:
+                                case 1047:
+                                    setAlternateScreen(true, false);
+                                    break;
+
+                                case 1049:
+                                    // save the caret, switch to the alternate screen and clear it
+                                    setAlternateScreen(true, true);
+                                    break;
+
                                 case 40:
                                 default:
+                                    m_counters.unsupportedSequences++;
                                     qDebug() << "Not supported:" << m_escSeq;
                                     break;
                                 }
@@ -1203,7 +2611,7 @@ void PlainTextLog::appendBytes(const QByteArray &bytes, bool insertCR)
                                     break;
 
                                 case 3:
-                                    Q_ASSERT(terminalScreenWidth == 80); // todo implement reset to 80 columns
+                                    // 80 columns mode: the width follows the window
                                     break;
 
                                 case 4:
@@ -1220,6 +2628,7 @@ void PlainTextLog::appendBytes(const QByteArray &bytes, bool insertCR)
                                     break;
 
                                 case 7:
+                                    m_counters.unsupportedSequences++;
                                     qDebug() << "Not supported: 'Reset auto-wrap mode'";
                                     break;
 
@@ -1227,8 +2636,19 @@ void PlainTextLog::appendBytes(const QByteArray &bytes, bool insertCR)
                                     // turn off auto repeat
                                     break;
 
+                                case 47:
+                                case 1047:
+                                    setAlternateScreen(false, false);
+                                    break;
+
+                                case 1049:
+                                    // back to the main screen, restore the caret
+                                    setAlternateScreen(false, true);
+                                    break;
+
                                 case 45:
                                 default:
+                                    m_counters.unsupportedSequences++;
                                     qDebug() << "Not supported:" << m_escSeq;
                                     break;
                                 }
@@ -1242,22 +2662,27 @@ void PlainTextLog::appendBytes(const QByteArray &bytes, bool insertCR)
                             {
                                 QString str;
 
-                                for (int col = 0; col < terminalScreenWidth; ++col)
+                                for (int col = 0; col < m_terminalColumns; ++col)
                                 {
                                     str += 'E';
                                 }
 
                                 insertTextAtCaret(str);
 
-                                if (row == terminalScreenHeight - 1)
+                                if (row == m_terminalRows - 1)
                                     break;
 
                                 moveCaretToTheFirstColumn(); // \r
                                 moveCaretDownwardsBy(1); // \n
                             }
+
+                            // DECALN homes the caret
+                            m_caretLine = screenTopLine();
+                            m_caretColumn = 0;
                         }
                         else
                         {
+                            m_counters.unsupportedSequences++;
                             qDebug() << "Not supported:" << m_escSeq;
                         }
                     }
@@ -1303,6 +2728,8 @@ void PlainTextLog::appendBytes(const QByteArray &bytes, bool insertCR)
 
             if (m_decoder->hasFailure())
             {
+                m_counters.droppedUtf8Bytes += dropped;
+                m_counters.replacedUtf8Chars++;
                 qDebug() << "Error: utf8 decoder failure, dropped" << dropped << "octets";
                 insertTextAtCaret("\u25AF"); // hollow rectangle
                 resetTextDecoder();
@@ -1323,6 +2750,7 @@ void PlainTextLog::appendBytes(const QByteArray &bytes, bool insertCR)
                 if (!m_escSeq.isEmpty())
                 {
                     insertTextAtCaret(m_escSeq);
+                    m_counters.unsupportedSequences++;
                     qDebug() << "Warning: aborted" << m_escSeq << "sequence";
                     m_escSeq.clear();
                 }
@@ -1336,11 +2764,8 @@ void PlainTextLog::appendBytes(const QByteArray &bytes, bool insertCR)
 
             case '\n':
                 //qDebug() << "\\n";
-                if (insertCR)
-                {
-                    moveCaretToTheFirstColumn();
-                }
-                moveCaretDownwardsBy(1);
+                m_counters.lines++;
+                lineFeed();
                 break;
 
             case '\t':
@@ -1363,12 +2788,9 @@ void PlainTextLog::appendBytes(const QByteArray &bytes, bool insertCR)
         }
     }
 
-    QRect caretIsRect = this->cursorRect(m_caret);
+    endEditTransaction();
 
-    if (caretIsRect != caretWasRect)
-    {
-        viewport()->repaint(); // TODO: make it more efficient
-    }
+    viewport()->update(); // the caret might have moved
 }
 
 void PlainTextLog::insertTextAtCaret(const QString &text)
@@ -1379,15 +2801,10 @@ void PlainTextLog::insertTextAtCaret(const QString &text)
         return;
     }
 
-    int toRemove = qMin(m_caret.block().text().length() - m_caret.positionInBlock(), text.length());
-
     //qDebug() << text;
 
-    m_caret.beginEditBlock();
-    {
-        m_caret.movePosition(QTextCursor::NextCharacter, QTextCursor::KeepAnchor, toRemove);
-        m_caret.removeSelectedText();
-        m_caret.insertText(text, m_tcfm);
-    }
-    m_caret.endEditBlock();
+    caretLine().write(m_caretColumn, text, m_caretAttr);
+    m_caretColumn += text.length();
+
+    contentsChanged(m_caretLine);
 }
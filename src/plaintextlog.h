@@ -1,16 +1,44 @@
 #ifndef PLAINTEXTLOG_H
 #define PLAINTEXTLOG_H
 
-#include "logblockcustomdata.h"
+#include "chunklatency.h"
+#include "linestore.h"
 #include "searchhighlighter.h"
 
-#include <QPlainTextEdit>
-#include <QObject>
+#include <QAbstractScrollArea>
+#include <QCache>
+#include <QGraphicsRectItem>
 #include <QGraphicsScene>
+#include <QMap>
+#include <QMenu>
+#include <QObject>
 #include <QRegExpValidator>
+#include <QRegularExpression>
+#include <QTime>
+#include <QStaticText>
 #include <QTextDecoder>
+#include <QTimer>
 
-class PlainTextLog : public QPlainTextEdit
+//
+// VT100 terminal log view.
+//
+// The text lives in a LineStore; the view lays out and paints the visible lines only,
+// column by column in a monospace grid, so the cost of scrolling and painting doesn't depend
+// on the scrollback size. The terminal screen is the last terminalScreenHeight() lines of the store,
+// its size follows the viewport. Lines are not wrapped, so a resize only moves the screen top.
+//
+// Full-screen programs switching to the alternate screen (?47h, ?1047h, ?1049h) get a separate store
+// which keeps the screen rows only, the main log is left as it was.
+//
+// Laid out lines are cached as QStaticText pieces keyed by line id and checked against the line
+// revision, so scrolling through the (frozen) scrollback mostly draws prepared glyph runs.
+//
+// Bookmarks are kept by line id in an ordered map, so they stay on their lines when the head
+// of the log is cleared and the next/previous one is a lowerBound() away. Besides the manual ones,
+// the lines matching a bookmark rule are bookmarked once they leave the screen.
+//
+
+class PlainTextLog : public QAbstractScrollArea
 {
     Q_OBJECT
 
@@ -49,21 +77,72 @@ public:
         ANSI_WHITE
     };
 
+    struct ParserCounters
+    {
+        ParserCounters() :
+            bytes(0),
+            lines(0),
+            sequences(0),
+            droppedUtf8Bytes(0),
+            replacedUtf8Chars(0),
+            unsupportedSequences(0)
+        {
+        }
+
+        qint64 bytes;
+        qint64 lines;
+        qint64 sequences;            // recognized escape sequences
+        qint64 droppedUtf8Bytes;     // skipped after a decoder failure
+        qint64 replacedUtf8Chars;    // U+25AF inserted in place of the broken ones
+        qint64 unsupportedSequences; // unknown, aborted or recognized but not implemented
+    };
+
     explicit PlainTextLog(QWidget *parent = 0);
 
-    const int terminalScreenWidth = 80;
-    const int terminalScreenHeight = 24;
+    int terminalScreenWidth() const;
+    int terminalScreenHeight() const;
+#ifdef QMINICOM_TESTS
+    QString screenSnapshot() const; // screen text and attributes, for tests/
+#endif
+
+    const LineStore &lineStore() const; // the log, i.e. the main store: the alternate screen has no scrollback
+    void setBookmarkRules(const QStringList &patterns); // regular expressions, for the new lines
+    int bookmarkCount() const;
+    bool isAlternateScreenActive() const;
+
+    static QRgb ansiColorToRgb(AnsiColor ansiColor, bool isBright); // the palette, also used by LogExporter
 
     void setSideMarkScene(QGraphicsScene *sideMarkScene);
-    LogBlockCustomData *highlightBlock(const QTextBlock &block);
 
-    void setContextMenuTextCursor(const QTextCursor &cur);
+    int tabStopWidth() const;
+    void setTabStopWidth(int pixels);
+
+    qint64 lineAt(const QPoint &viewportPos) const;
+    void setContextMenuLine(qint64 line);
+    QMenu *createContextMenu();
+
+    QString selectedText() const;
+
+    bool isClippedToViewport() const;
+    void setClipToViewport(bool clip); // render time, the text is kept
+
+    const ParserCounters &counters() const;
+    qint64 scrollbackBytes() const;
+
+    const ChunkLatency &chunkLatency() const;
+    bool isLatencyOverlayVisible() const;
+    void setLatencyOverlayVisible(bool visible);
 
 signals:
     void sendBytes(const QByteArray &bytes);
+    void linesChanged(qint64 fromLine, qint64 endLine); // once per received chunk, and on clear()
+    void linesDropped(qint64 firstLineId); // by "Clear to this line", the lines from firstLineId on are kept
+    void linesTrimmed(); // cut at the right edge in place, under the same ids
+    void terminalSizeChanged(int columns, int rows);
+    void bookmarksChanged(int count);
 
 public slots:
-    void appendBytes(const QByteArray &bytes, bool insertCR = false);
+    void appendBytes(const QByteArray &bytes, qint64 timestamp = -1); // timestamp: see ChunkLatency::now()
     //void appendTextNoNewline(const QString &text);
     void setSearchPhrase(const QString &phrase, bool caseSensitive);
     void findNext();
@@ -71,17 +150,97 @@ public slots:
     void find(bool backward);
     void clear();
     void clearToCurrentContextMenuLine();
+    void showLine(qint64 line);
+    void toggleBookmark(); // at the selection, or at the caret line: "now"
+    void toggleBookmarkAtContextMenuLine();
+    void nextBookmark();
+    void prevBookmark();
+    void clearBookmarks();
     void trimContentsByTheRightEdge();
     void paste();
+    void copy();
+    void selectAll();
 
 protected:
     void resizeEvent(QResizeEvent *e);
     void keyPressEvent(QKeyEvent *e);
     void paintEvent(QPaintEvent *e);
+    void showEvent(QShowEvent *e);
+    void changeEvent(QEvent *e);
+    void mousePressEvent(QMouseEvent *e);
+    void mouseMoveEvent(QMouseEvent *e);
+    void mouseDoubleClickEvent(QMouseEvent *e);
+    void scrollContentsBy(int dx, int dy);
 
 private:
-    int getLastBlockBottom();
-    void resizeMark(QGraphicsRectItem *item, const QTextBlock &block);
+    struct TextPosition
+    {
+        qint64 line;
+        int index;
+
+        bool operator<(const TextPosition &other) const
+        {
+            return line < other.line || (line == other.line && index < other.index);
+        }
+    };
+
+    struct LinePiece
+    {
+        int column;
+        int columns;
+        TextAttr attr;
+        QStaticText text; // empty for the tab gaps
+    };
+
+    struct Bookmark
+    {
+        QTime time; // when it was added
+        QString text;
+        bool automatic; // by a rule
+        QGraphicsRectItem *mark; // in the side mark scene, if there is one
+    };
+
+    struct LineLayout
+    {
+        quint32 revision;
+        int columns;
+        QVector<LinePiece> pieces;
+    };
+
+    static const int layoutCacheLines = 4096;
+    static const int searchRangeLines = 16384; // per pool task of a search
+
+    void processBytes(const QByteArray &bytes);
+    void linesFinalized(qint64 from, qint64 to);
+    void addSearchMark(qint64 line, const QString &text);
+    void addBookmark(qint64 line, bool automatic);
+    bool matchesBookmarkRule(const QString &text) const;
+    QString bookmarkToolTip(qint64 line, const Bookmark &bookmark) const;
+    void removeBookmark(qint64 line);
+    void jumpToBookmark(bool backward);
+    int markProjection() const;
+    void resizeMark(QGraphicsRectItem *item, qint64 line);
+    void resizeMarks();
+    void updateScrollBars();
+    void contentsChanged(qint64 fromLine);
+    void beginEditTransaction();
+    void endEditTransaction();
+    void applyContentsChanges();
+    void ensureLineVisible(qint64 line);
+    TextPosition positionAt(const QPoint &viewportPos) const;
+    int tabColumns() const;
+    int columnOf(const QString &text, int index) const;
+    int indexAtColumn(const QString &text, int column) const;
+    const LineLayout *lineLayout(qint64 line);
+    void invalidateLayouts();
+    QString layoutCacheStats() const;
+    void paintLine(QPainter &p, qint64 line, int y);
+    QColor attrForeground(TextAttr attr) const;
+    QColor attrBackground(TextAttr attr) const;
+
+    qint64 screenTopLine() const;
+    LogLine &screenLine(int row);
+    LogLine &caretLine();
     void sendVT100EscSeq(VT100EscapeCode code);
     void moveCaretToTheStartOfTheScreen();
     void moveCaretToTheRightBy(int chars);
@@ -89,6 +248,15 @@ private:
     void moveCaretToTheFirstColumn();
     void moveCaretUpwardsBy(int lines);
     void moveCaretDownwardsBy(int lines);
+    void moveCaretDownwardsWithinScreenBy(int lines);
+    int caretRow() const;
+    bool isScrollingRegionFullScreen() const;
+    void ensureScreenRows(int rows);
+    void updateTerminalSize();
+    void setAlternateScreen(bool active, bool saveCaret);
+    void scrollRegion(int top, int bottom, int lines);
+    void lineFeed();
+    void reverseLineFeed();
     void insertTextAtCaret(const QString &text);
     void caretBackspace();
     void setCaretBrightness(bool bright);
@@ -100,15 +268,40 @@ private:
     void resetCaretAttributes();
     void updateCaretAttributes();
     void resetTextDecoder();
-    QRgb ansiColorToRgb(AnsiColor ansiColor, bool isBright);
 
-    SearchHighlighter *m_highlighter;
+    LineStore m_mainStore;
+    LineStore m_altStore;  // the alternate screen: screen rows only, discarded on exit
+    LineStore *m_store;    // the active one
+    int m_maxColumns; // the widest line seen, for the horizontal scroll bar
+    int m_tabStopWidth;
+    QCache<qint64, LineLayout> m_layoutCache;
+    qint64 m_layoutCacheLookups;
+    qint64 m_layoutCacheHits;
+    bool m_clipToViewport;
+    bool m_editTransaction;
+    qint64 m_changedFromLine; // the first line changed since the view was last updated
+
+    SearchHighlighter m_highlighter;
     QGraphicsScene *m_sideMarkScene;
+    QMap<qint64, QGraphicsRectItem *> m_searchMarks; // line id -> side mark
+    QMap<qint64, Bookmark> m_bookmarks; // main store line id -> bookmark
+    QList<QRegularExpression> m_bookmarkRules;
+
+    TextPosition m_selectionAnchor;
+    TextPosition m_selectionEnd; // the selection is empty when equal to the anchor
+    qint64 m_contextMenuLine;
+
     QString m_escSeq;
+    QByteArray m_pendingBytes; // received while hidden, parsed once the widget is shown
+    ParserCounters m_counters;
+    ChunkLatency m_chunkLatency;
+    QVector<qint64> m_unpaintedChunks; // timestamps of the parsed chunks waiting for a paint
+    bool m_latencyOverlayVisible;
+    QTimer *m_latencyOverlayTimer;
     QTextDecoder *m_decoder;
-    QTextCursor m_caret;
-    QTextCursor m_contextMenuTextCursor;
-    QTextCharFormat m_tcfm;
+    qint64 m_caretLine;
+    int m_caretColumn;
+    TextAttr m_caretAttr;
     AnsiColor m_caretFgColor;
     AnsiColor m_caretBgColor;
     bool m_caretBrightness;
@@ -116,9 +309,12 @@ private:
     bool m_caretInvertedColors;
     bool m_cursorMode;
     bool m_cursorRelativeCoordinates;
-    int m_screenTopLine;
     QRegularExpressionValidator *m_vt100escReV;
 
+    qint64 m_savedCaretLine; // main screen caret saved by ?1049h
+    int m_savedCaretColumn;
+    int m_terminalColumns;
+    int m_terminalRows;
     int m_screenScrollingRegionTop;
     int m_screenScrollingRegionBottom;
 };
@@ -0,0 +1,53 @@
+#include "portenumerator.h"
+
+#include <QSerialPortInfo>
+#include <QtConcurrent/QtConcurrentRun>
+
+static QStringList enumeratePorts()
+{
+    QStringList portNames;
+
+    foreach (const QSerialPortInfo &pi, QSerialPortInfo::availablePorts())
+    {
+        portNames.append(pi.portName());
+    }
+
+    return portNames;
+}
+
+PortEnumerator::PortEnumerator(QObject *parent) :
+    QObject(parent)
+{
+    connect(&m_watcher, SIGNAL(finished()), this, SLOT(refreshFinished()));
+}
+
+QStringList PortEnumerator::portNames() const
+{
+    return m_portNames;
+}
+
+bool PortEnumerator::isRefreshing() const
+{
+    return m_watcher.isRunning();
+}
+
+void PortEnumerator::refresh()
+{
+    if (m_watcher.isRunning())
+    {
+        return;
+    }
+
+    m_watcher.setFuture(QtConcurrent::run(enumeratePorts));
+}
+
+void PortEnumerator::refreshFinished()
+{
+    QStringList portNames = m_watcher.result();
+
+    if (portNames != m_portNames)
+    {
+        m_portNames = portNames;
+        emit portsChanged(m_portNames);
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef PORTENUMERATOR_H
+#define PORTENUMERATOR_H
+
+#include <QFutureWatcher>
+#include <QObject>
+#include <QStringList>
+
+//
+// Serial port list, enumerated off the GUI thread.
+//
+// QSerialPortInfo::availablePorts() walks sysfs / the registry and opens every device for its
+// description, which takes noticeable time with many USB-serial adapters. It runs on the global
+// thread pool; until it is done the last results are served.
+//
+
+class PortEnumerator : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PortEnumerator(QObject *parent = 0);
+
+    QStringList portNames() const; // cached, empty until the first enumeration is done
+    bool isRefreshing() const;
+
+signals:
+    void portsChanged(const QStringList &portNames);
+
+public slots:
+    void refresh(); // ignored while an enumeration is running
+
+private slots:
+    void refreshFinished();
+
+private:
+    QFutureWatcher<QStringList> m_watcher;
+    QStringList m_portNames;
+};
+
+#endif // PORTENUMERATOR_H
@@ -0,0 +1,92 @@
+#include "portthreadpool.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QMutexLocker>
+
+static PortThreadPool *s_portThreadPool = Q_NULLPTR;
+
+static void destroyPortThreadPool()
+{
+    delete s_portThreadPool; // stops the threads while QCoreApplication is still there
+    s_portThreadPool = Q_NULLPTR;
+}
+
+PortThreadPool *PortThreadPool::instance()
+{
+    if (!s_portThreadPool)
+    {
+        s_portThreadPool = new PortThreadPool();
+        qAddPostRoutine(destroyPortThreadPool);
+    }
+
+    return s_portThreadPool;
+}
+
+PortThreadPool::PortThreadPool()
+{
+    // one thread easily handles dozens of ports, a couple more keep the slowest port from adding latency to all others
+    int count = qBound(1, QThread::idealThreadCount() / 2, 4);
+
+    for (int i = 0; i < count; ++i)
+    {
+        QThread *thread = new QThread();
+        thread->setObjectName(QString("port I/O #%1").arg(i));
+        thread->start(QThread::HighestPriority);
+
+        m_threads << thread;
+        m_load << 0;
+    }
+}
+
+PortThreadPool::~PortThreadPool()
+{
+    foreach (QThread *thread, m_threads)
+    {
+        thread->quit();
+        thread->wait();
+        delete thread;
+    }
+}
+
+void PortThreadPool::attach(QObject *port)
+{
+    Q_ASSERT(port->thread() == QThread::currentThread());
+
+    QMutexLocker locker(&m_mutex);
+
+    int ix = 0;
+    for (int i = 1; i < m_load.size(); ++i)
+    {
+        if (m_load.at(i) < m_load.at(ix))
+        {
+            ix = i;
+        }
+    }
+
+    m_load[ix]++;
+    m_assignment.insert(port, ix);
+
+    port->moveToThread(m_threads.at(ix));
+}
+
+void PortThreadPool::detach(QObject *port)
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (!m_assignment.contains(port))
+    {
+        qDebug() << "Warning:" << __FUNCTION__ << ": unknown port";
+        return;
+    }
+
+    m_load[m_assignment.take(port)]--;
+
+    // the object is destroyed by its own thread once the pending events are processed
+    QMetaObject::invokeMethod(port, "deleteLater", Qt::QueuedConnection);
+}
+
+int PortThreadPool::threadCount() const
+{
+    return m_threads.size();
+}
@@ -0,0 +1,38 @@
+#ifndef PORTTHREADPOOL_H
+#define PORTTHREADPOOL_H
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QThread>
+
+//
+// A small fixed set of I/O threads shared by all the ports of the process.
+//
+// Each thread runs one event loop multiplexing the descriptors of every port attached to it,
+// a port is attached to the least loaded thread. Ports read in bounded slices (see AsyncPort::readPort),
+// so a flooding port can't starve the others sharing its thread.
+//
+
+class PortThreadPool
+{
+public:
+    static PortThreadPool *instance();
+    ~PortThreadPool();
+
+    void attach(QObject *port);
+    void detach(QObject *port);
+
+    int threadCount() const;
+
+private:
+    PortThreadPool();
+
+    QList<QThread *> m_threads;
+    QList<int> m_load;
+    QHash<QObject *, int> m_assignment;
+    QMutex m_mutex;
+};
+
+#endif // PORTTHREADPOOL_H
@@ -1,4 +1,5 @@
 #include "mainwindow.h"
+#include "portenumerator.h"
 #include "preferencesdialog.h"
 #include "ui_preferencesdialog.h"
 
@@ -46,8 +47,12 @@ PreferencesDialog::PreferencesDialog(MainWindow *parent) :
 
     //
 
-    connect(this, SIGNAL(openSerialPort(QString,qint32)), m_mainWindow, SIGNAL(openSerialPort(QString,qint32)));
-    connect(this, SIGNAL(openLocalShell()), m_mainWindow, SIGNAL(openLocalShell()));
+    connect(this, SIGNAL(openSerialPort(QString,qint32)), m_mainWindow, SLOT(openSerialPort(QString,qint32)));
+    connect(this, SIGNAL(setSerialTuning(SerialTuning)), m_mainWindow, SLOT(setSerialTuning(SerialTuning)));
+    connect(this, SIGNAL(openLocalShell()), m_mainWindow, SLOT(openLocalShell()));
+    connect(this, SIGNAL(openVirtualPort()), m_mainWindow, SLOT(openVirtualPort()));
+
+    connect(m_mainWindow->portEnumerator(), SIGNAL(portsChanged(QStringList)), this, SLOT(updatePortList(QStringList)));
 
     readSettings();
 
@@ -63,18 +68,12 @@ PreferencesDialog::~PreferencesDialog()
 
 void PreferencesDialog::open()
 {
-    // populate the device list
+    // the cached device list is shown right away, a fresh one replaces it when enumerated
 
     ui->cmbDevice->clear();
+    updatePortList(m_mainWindow->portEnumerator()->portNames());
 
-    QList<QSerialPortInfo> ports = QSerialPortInfo::availablePorts();
-
-    foreach (QSerialPortInfo pi, ports)
-    {
-        ui->cmbDevice->addItem(pi.portName());
-    }
-
-    ui->cmbDevice->setCurrentIndex(ui->cmbDevice->findText(m_serialPortName));
+    m_mainWindow->portEnumerator()->refresh();
 
     QDialog::open();
 }
@@ -86,8 +85,14 @@ void PreferencesDialog::accept()
     if (ui->radioButtonSerialDevice->isChecked())
     {
         m_serialPortName = ui->cmbDevice->currentText();
+        m_serialTuning.lowLatency = ui->checkBoxLowLatency->isChecked();
+        emit setSerialTuning(m_serialTuning);
         emit openSerialPort(m_serialPortName, ui->cmbSpeed->currentText().toUInt());
     }
+    else if (ui->radioButtonVirtualDevice->isChecked())
+    {
+        emit openVirtualPort();
+    }
     else
     {
         emit openLocalShell();
@@ -96,6 +101,19 @@ void PreferencesDialog::accept()
     m_mainWindow->setLogWidgetSettings(ui->plainTextEdit->font(), pixelsFromSpaces(ui->tabSizeSpinBox->value()));
 }
 
+void PreferencesDialog::updatePortList(const QStringList &portNames)
+{
+    QString selected = ui->cmbDevice->currentText();
+    if (selected.isEmpty())
+    {
+        selected = m_serialPortName;
+    }
+
+    ui->cmbDevice->clear();
+    ui->cmbDevice->addItems(portNames);
+    ui->cmbDevice->setCurrentIndex(ui->cmbDevice->findText(selected));
+}
+
 void PreferencesDialog::pickUpFont(const QString &name)
 {
     QFont font = ui->plainTextEdit->font();
@@ -135,6 +153,7 @@ void PreferencesDialog::pickUpPortSelection()
     ui->cmbDevice->setEnabled(isSerial);
     ui->cmbSpeed->setEnabled(isSerial);
     ui->labelParams->setEnabled(isSerial);
+    ui->checkBoxLowLatency->setEnabled(isSerial);
 }
 
 void PreferencesDialog::readSettings()
@@ -144,6 +163,7 @@ void PreferencesDialog::readSettings()
     m_settings.beginGroup(QLatin1String("Port"));
     {
         bool isSerial = m_settings.value(QLatin1String("isSerial"), true).toBool();
+        bool isVirtual = m_settings.value(QLatin1String("isVirtual"), false).toBool();
 
         m_serialPortName = m_settings.value(QLatin1String("portName"), "").toString();
 
@@ -151,54 +171,41 @@ void PreferencesDialog::readSettings()
 
         qint32 br = m_settings.value(QLatin1String("baudRate"), QSerialPort::Baud115200).toInt();
         ui->cmbSpeed->setCurrentIndex(ui->cmbSpeed->findText(QString("%1").arg(br)));
-        br = ui->cmbSpeed->currentText().toInt();
+
+        m_serialTuning.lowLatency = m_settings.value(QLatin1String("lowLatency"), false).toBool();
+        m_serialTuning.readBufferSize = m_settings.value(QLatin1String("lowLatencyReadBufferSize"), m_serialTuning.readBufferSize).toLongLong();
+        ui->checkBoxLowLatency->setChecked(m_serialTuning.lowLatency);
+
+        // the port itself was opened by MainWindow at startup, the dialog only shows the choice
 
         if (isSerial)
         {
             ui->radioButtonSerialDevice->setChecked(true);
-            emit openSerialPort(m_serialPortName, br);
+        }
+        else if (isVirtual)
+        {
+            ui->radioButtonVirtualDevice->setChecked(true);
         }
         else
         {
             ui->radioButtonLocalShell->setChecked(true);
-            emit openLocalShell();
         }
     }
     m_settings.endGroup();
 
     m_settings.beginGroup(QLatin1String("LogWidget"));
     {
-        const QString &font_str_default =
-        #if defined(Q_OS_MAC)
-                "Monaco"
-        #elif defined(Q_OS_WIN)
-                "fixed"
-        #else
-                "Monospace"
-        #endif
-                ;
-
-        const QString &font_str = m_settings.value(QLatin1String("font"), font_str_default).toString();
-
-        QFont font;
-        if (font.fromString(font_str))
-        {
-            pickUpFont(font.family());
-        }
-        else
-        {
-            qDebug() << "WARNING Can't pick up font setting:" << font_str;
-        }
+        // the font was read by MainWindow at startup and may have been changed since
+
+        pickUpFont(m_mainWindow->logWidgetFont().family());
         ui->fontComboBox->setCurrentIndex(ui->fontComboBox->findText(ui->plainTextEdit->font().family()));
 
-        pickUpFontSize(QFontInfo(ui->plainTextEdit->font()).pixelSize());
+        pickUpFontSize(QFontInfo(m_mainWindow->logWidgetFont()).pixelSize());
         ui->fontSizeSpinBox->setValue(QFontInfo(ui->plainTextEdit->font()).pixelSize());
 
         int tabSize = m_settings.value(QLatin1String("tabSize"), 8).toInt();
         ui->tabSizeSpinBox->setValue(tabSize);
         pickUpTabSize(ui->tabSizeSpinBox->value());
-
-        m_mainWindow->setLogWidgetSettings(ui->plainTextEdit->font(), pixelsFromSpaces(ui->tabSizeSpinBox->value()));
     }
     m_settings.endGroup();
 }
@@ -210,8 +217,11 @@ void PreferencesDialog::writeSettings()
     m_settings.beginGroup(QLatin1String("Port"));
     {
         m_settings.setValue(QLatin1String("isSerial"), ui->radioButtonSerialDevice->isChecked());
+        m_settings.setValue(QLatin1String("isVirtual"), ui->radioButtonVirtualDevice->isChecked());
         m_settings.setValue(QLatin1String("portName"), m_serialPortName);
         m_settings.setValue(QLatin1String("baudRate"), ui->cmbSpeed->currentText());
+        m_settings.setValue(QLatin1String("lowLatency"), m_serialTuning.lowLatency);
+        m_settings.setValue(QLatin1String("lowLatencyReadBufferSize"), m_serialTuning.readBufferSize);
     }
     m_settings.endGroup();
 
@@ -21,7 +21,9 @@ public:
 
 signals:
     void openSerialPort(const QString &pn, qint32 br);
+    void setSerialTuning(const SerialTuning &tuning);
     void openLocalShell();
+    void openVirtualPort();
 
 public slots:
     void open();
@@ -32,6 +34,7 @@ private slots:
     void pickUpFontSize(int val);
     void pickUpTabSize(int val);
     void pickUpPortSelection();
+    void updatePortList(const QStringList &portNames);
 
 private:
     void readSettings();
@@ -45,6 +48,7 @@ private:
     int m_textShade;
     int m_bgShade;
     QString m_serialPortName;
+    SerialTuning m_serialTuning;
 };
 
 #endif // PREFERENCESDIALOG_H
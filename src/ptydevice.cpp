@@ -0,0 +1,451 @@
+#include "ptydevice.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QTimer>
+#include <QVector>
+
+#ifdef Q_OS_UNIX
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+
+extern char **environ;
+#endif
+
+PtyDevice::PtyDevice(QObject *parent) :
+    QIODevice(parent),
+    m_masterFd(-1),
+    m_slaveFd(-1),
+    m_pid(-1),
+    m_readNotifier(Q_NULLPTR),
+    m_columns(80),
+    m_rows(24)
+{
+}
+
+PtyDevice::~PtyDevice()
+{
+    close();
+}
+
+#ifdef Q_OS_UNIX
+
+bool PtyDevice::start(const QString &program, const QStringList &arguments, const QProcessEnvironment &env)
+{
+    close();
+
+    if (!openMaster())
+    {
+        return false;
+    }
+
+    // everything the child needs is prepared before fork(): no allocations after it
+
+    QByteArray slavePath = QFile::encodeName(m_slaveName);
+
+    // the slave is opened here, not in the child: a master whose slave was never opened reports HUP
+    // and read() gives EIO, which readData() would take for the end of a child that hasn't even started.
+    // The child inherits the descriptor, so from fork() on the slave is open until the child is gone.
+
+    int slave = ::open(slavePath.constData(), O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (slave < 0)
+    {
+        setErrorString(QString("%1: %2").arg(m_slaveName).arg(strerror(errno)));
+        close();
+        return false;
+    }
+
+    QList<QByteArray> argStorage;
+    argStorage << QFile::encodeName(program);
+    foreach (const QString &arg, arguments)
+    {
+        argStorage << arg.toLocal8Bit();
+    }
+
+    QVector<char *> argv;
+    for (int i = 0; i < argStorage.size(); ++i)
+    {
+        argv << argStorage[i].data();
+    }
+    argv << Q_NULLPTR;
+
+    QList<QByteArray> envStorage;
+    foreach (const QString &kv, env.toStringList())
+    {
+        envStorage << kv.toLocal8Bit();
+    }
+
+    QVector<char *> envp;
+    for (int i = 0; i < envStorage.size(); ++i)
+    {
+        envp << envStorage[i].data();
+    }
+    envp << Q_NULLPTR;
+
+    pid_t pid = fork();
+
+    if (pid < 0)
+    {
+        setErrorString(QString("fork: %1").arg(strerror(errno)));
+        ::close(slave);
+        close();
+        return false;
+    }
+
+    if (pid == 0)
+    {
+        // child: become a session leader and acquire the slave as the controlling terminal
+
+        setsid();
+
+#ifdef TIOCSCTTY
+        ioctl(slave, TIOCSCTTY, 0);
+#else
+        // the first terminal a session leader opens becomes its controlling terminal
+        int tty = ::open(slavePath.constData(), O_RDWR);
+        if (tty >= 0)
+        {
+            ::close(tty);
+        }
+#endif
+
+        fcntl(slave, F_SETFD, 0); // dup2() onto itself would keep O_CLOEXEC
+        dup2(slave, STDIN_FILENO);
+        dup2(slave, STDOUT_FILENO);
+        dup2(slave, STDERR_FILENO);
+
+        if (slave > STDERR_FILENO)
+        {
+            ::close(slave);
+        }
+
+        signal(SIGPIPE, SIG_DFL);
+
+        environ = envp.data();
+        execvp(argv[0], argv.data());
+
+        _exit(127);
+    }
+
+    // the child's copy keeps the slave open; the parent's would hide the child's end from the master
+    ::close(slave);
+
+    m_pid = pid;
+    m_program = program;
+
+    return true;
+}
+
+bool PtyDevice::openVirtualDevice()
+{
+    close();
+
+    if (!openMaster())
+    {
+        return false;
+    }
+
+    m_slaveFd = ::open(QFile::encodeName(m_slaveName).constData(), O_RDWR | O_NOCTTY);
+    if (m_slaveFd < 0)
+    {
+        setErrorString(QString("%1: %2").arg(m_slaveName).arg(strerror(errno)));
+        close();
+        return false;
+    }
+
+    fcntl(m_slaveFd, F_SETFD, FD_CLOEXEC);
+
+    // behave like a serial line: no echo, no line editing, no CR/LF translation
+    struct termios tio;
+    if (tcgetattr(m_slaveFd, &tio) == 0)
+    {
+        cfmakeraw(&tio);
+        tcsetattr(m_slaveFd, TCSANOW, &tio);
+    }
+
+    return true;
+}
+
+void PtyDevice::close()
+{
+    if (m_readNotifier)
+    {
+        delete m_readNotifier;
+        m_readNotifier = Q_NULLPTR;
+    }
+
+    if (m_slaveFd >= 0)
+    {
+        ::close(m_slaveFd);
+        m_slaveFd = -1;
+    }
+
+    if (m_masterFd >= 0)
+    {
+        ::close(m_masterFd); // hangs up the slave side, the session gets SIGHUP
+        m_masterFd = -1;
+    }
+
+    if (m_pid > 0)
+    {
+        pid_t pid = m_pid;
+        m_pid = -1;
+
+        kill(pid, SIGHUP);
+
+        int i;
+        for (i = 0; i < 20 && waitpid(pid, Q_NULLPTR, WNOHANG) == 0; ++i)
+        {
+            usleep(10000);
+        }
+
+        if (i == 20)
+        {
+            qDebug() << "Warning:" << m_program << "ignores SIGHUP, killing";
+            kill(pid, SIGKILL);
+            waitpid(pid, Q_NULLPTR, 0);
+        }
+    }
+
+    m_program.clear();
+    m_slaveName.clear();
+
+    if (isOpen())
+    {
+        QIODevice::close();
+    }
+}
+
+qint64 PtyDevice::bytesAvailable() const
+{
+    int available = 0;
+
+    if (m_masterFd >= 0 && ioctl(m_masterFd, FIONREAD, &available) < 0)
+    {
+        available = 0;
+    }
+
+    return available + QIODevice::bytesAvailable();
+}
+
+void PtyDevice::setWindowSize(int columns, int rows)
+{
+    m_columns = columns;
+    m_rows = rows;
+
+    if (m_masterFd >= 0)
+    {
+        struct winsize ws;
+        memset(&ws, 0, sizeof(ws));
+        ws.ws_col = columns;
+        ws.ws_row = rows;
+
+        if (ioctl(m_masterFd, TIOCSWINSZ, &ws) < 0)
+        {
+            qDebug() << "Warning: TIOCSWINSZ failed:" << strerror(errno);
+        }
+    }
+}
+
+qint64 PtyDevice::readData(char *data, qint64 maxSize)
+{
+    ssize_t r = ::read(m_masterFd, data, maxSize);
+
+    if (r > 0)
+    {
+        return r;
+    }
+
+    if (r < 0 && (errno == EAGAIN || errno == EINTR))
+    {
+        return 0;
+    }
+
+    // EOF or EIO: the last slave descriptor has been closed, i.e. the child is gone
+
+    if (m_readNotifier && m_readNotifier->isEnabled())
+    {
+        m_readNotifier->setEnabled(false);
+        QMetaObject::invokeMethod(this, "masterActivated", Qt::QueuedConnection);
+    }
+
+    return 0;
+}
+
+qint64 PtyDevice::writeData(const char *data, qint64 maxSize)
+{
+    qint64 written = 0;
+
+    while (written < maxSize)
+    {
+        ssize_t r = ::write(m_masterFd, data + written, maxSize - written);
+
+        if (r >= 0)
+        {
+            written += r;
+        }
+        else if (errno == EAGAIN)
+        {
+            // the slave input queue is full, wait for the child to drain it
+            struct pollfd pfd;
+            pfd.fd = m_masterFd;
+            pfd.events = POLLOUT;
+            if (poll(&pfd, 1, 100) <= 0)
+            {
+                qDebug() << "Warning:" << __FUNCTION__ << ": dropped" << maxSize - written << "bytes";
+                break;
+            }
+        }
+        else if (errno != EINTR)
+        {
+            setErrorString(strerror(errno));
+            return written ? written : -1;
+        }
+    }
+
+    return written;
+}
+
+void PtyDevice::masterActivated()
+{
+    if (m_readNotifier && m_readNotifier->isEnabled())
+    {
+        emit readyRead();
+        return;
+    }
+
+    // the notifier has been disabled by readData(): the slave side is closed
+
+    if (m_pid <= 0)
+    {
+        return;
+    }
+
+    int status = 0;
+    pid_t r = waitpid(m_pid, &status, WNOHANG);
+
+    if (r == 0)
+    {
+        // the slave is closed but the child hasn't exited yet
+        QTimer::singleShot(50, this, SLOT(masterActivated()));
+        return;
+    }
+
+    int exitCode = (r > 0 && WIFEXITED(status)) ? WEXITSTATUS(status) : -1;
+    m_pid = -1;
+
+    emit finished(exitCode);
+}
+
+bool PtyDevice::openMaster()
+{
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (fd < 0)
+    {
+        setErrorString(QString("posix_openpt: %1").arg(strerror(errno)));
+        return false;
+    }
+
+    const char *name = Q_NULLPTR;
+    if (grantpt(fd) < 0 || unlockpt(fd) < 0 || (name = ptsname(fd)) == Q_NULLPTR)
+    {
+        setErrorString(QString("pty: %1").arg(strerror(errno)));
+        ::close(fd);
+        return false;
+    }
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    m_masterFd = fd;
+    m_slaveName = QFile::decodeName(name);
+
+    setWindowSize(m_columns, m_rows);
+
+    m_readNotifier = new QSocketNotifier(m_masterFd, QSocketNotifier::Read, this);
+    connect(m_readNotifier, SIGNAL(activated(int)), this, SLOT(masterActivated()));
+
+    return QIODevice::open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+}
+
+#else // !Q_OS_UNIX
+
+bool PtyDevice::start(const QString &, const QStringList &, const QProcessEnvironment &)
+{
+    setErrorString("pseudo-terminals are not supported on this platform");
+    return false;
+}
+
+bool PtyDevice::openVirtualDevice()
+{
+    return openMaster();
+}
+
+void PtyDevice::close()
+{
+    if (isOpen())
+    {
+        QIODevice::close();
+    }
+}
+
+qint64 PtyDevice::bytesAvailable() const
+{
+    return QIODevice::bytesAvailable();
+}
+
+void PtyDevice::setWindowSize(int columns, int rows)
+{
+    m_columns = columns;
+    m_rows = rows;
+}
+
+qint64 PtyDevice::readData(char *, qint64)
+{
+    return -1;
+}
+
+qint64 PtyDevice::writeData(const char *, qint64)
+{
+    return -1;
+}
+
+void PtyDevice::masterActivated()
+{
+}
+
+bool PtyDevice::openMaster()
+{
+    setErrorString("pseudo-terminals are not supported on this platform");
+    return false;
+}
+
+#endif // Q_OS_UNIX
+
+bool PtyDevice::isSequential() const
+{
+    return true;
+}
+
+QString PtyDevice::program() const
+{
+    return m_program;
+}
+
+QString PtyDevice::slaveName() const
+{
+    return m_slaveName;
+}
+
+int PtyDevice::masterFd() const
+{
+    return m_masterFd;
+}
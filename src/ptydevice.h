@@ -0,0 +1,60 @@
+#ifndef PTYDEVICE_H
+#define PTYDEVICE_H
+
+#include <QIODevice>
+#include <QProcessEnvironment>
+#include <QSocketNotifier>
+#include <QStringList>
+
+//
+// Master side of a pseudo-terminal.
+//
+// start() runs a program on the slave side as a session leader with the slave as its controlling TTY,
+// openVirtualDevice() leaves the (raw) slave for an external program, e.g. to emulate a serial device.
+//
+
+class PtyDevice : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    explicit PtyDevice(QObject *parent = 0);
+    ~PtyDevice();
+
+    bool start(const QString &program, const QStringList &arguments, const QProcessEnvironment &env);
+    bool openVirtualDevice();
+    void close();
+
+    bool isSequential() const;
+    qint64 bytesAvailable() const;
+
+    void setWindowSize(int columns, int rows);
+
+    QString program() const;
+    QString slaveName() const;
+    int masterFd() const;
+
+signals:
+    void finished(int exitCode);
+
+protected:
+    qint64 readData(char *data, qint64 maxSize);
+    qint64 writeData(const char *data, qint64 maxSize);
+
+private slots:
+    void masterActivated();
+
+private:
+    bool openMaster();
+
+    int m_masterFd;
+    int m_slaveFd; // kept open in the virtual device mode only: with a child, its end shows as EIO/HUP
+    qint64 m_pid;
+    QSocketNotifier *m_readNotifier;
+    QString m_program;
+    QString m_slaveName;
+    int m_columns;
+    int m_rows;
+};
+
+#endif // PTYDEVICE_H
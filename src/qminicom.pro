@@ -4,27 +4,66 @@
 #
 #-------------------------------------------------
 
-QT       += core gui serialport
+QT       += core gui serialport concurrent qml
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
 TARGET = qminicom
 TEMPLATE = app
 
+LIBS += -lz
+
 
 SOURCES += main.cpp\
         mainwindow.cpp \
     preferencesdialog.cpp \
     plaintextlog.cpp \
+    linestore.cpp \
     searchhighlighter.cpp \
-    asyncserialport.cpp
+    asyncserialport.cpp \
+    latencyhistogram.cpp \
+    chunklatency.cpp \
+    ptydevice.cpp \
+    session.cpp \
+    portthreadpool.cpp \
+    portenumerator.cpp \
+    capturewriter.cpp \
+    logexporter.cpp \
+    logfileindex.cpp \
+    logfileview.cpp \
+    logfilewindow.cpp \
+    headlesscapture.cpp \
+    expectmatcher.cpp \
+    scripthost.cpp \
+    hexview.cpp \
+    framedecoder.cpp \
+    filterview.cpp \
+    packetview.cpp
 
 HEADERS  += mainwindow.h \
     preferencesdialog.h \
     plaintextlog.h \
     searchhighlighter.h \
-    logblockcustomdata.h \
-    asyncserialport.h
+    linestore.h \
+    asyncserialport.h \
+    latencyhistogram.h \
+    chunklatency.h \
+    ptydevice.h \
+    session.h \
+    portthreadpool.h \
+    portenumerator.h \
+    capturewriter.h \
+    logexporter.h \
+    logfileindex.h \
+    logfileview.h \
+    logfilewindow.h \
+    headlesscapture.h \
+    expectmatcher.h \
+    scripthost.h \
+    hexview.h \
+    framedecoder.h \
+    filterview.h \
+    packetview.h
 
 FORMS    += mainwindow.ui \
     preferencesdialog.ui
@@ -0,0 +1,263 @@
+#include "scripthost.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QJSEngine>
+#include <QMutexLocker>
+#include <QRegularExpression>
+
+static const char *const scriptPrelude =
+        "function send(text) { qminicom.send(String(text)); }\n"
+        "function expect(pattern, timeout, reply) {\n"
+        "    return qminicom.expect(pattern, timeout === undefined ? 10000 : timeout, reply === undefined ? '' : String(reply));\n"
+        "}\n"
+        "function sleep(ms) { return qminicom.sleep(ms); }\n"
+        "function log(text) { qminicom.log(String(text)); }\n"
+        "function openSerialPort(name, baud) { qminicom.openSerialPort(name, baud === undefined ? 115200 : baud); }\n"
+        "function openLocalShell() { qminicom.openLocalShell(); }\n"
+        "function closePort() { qminicom.closePort(); }\n";
+
+ScriptApi::ScriptApi(AsyncPort *port, ExpectMatcher *matcher, QObject *parent) :
+    QObject(parent),
+    m_port(port),
+    m_matcher(matcher)
+{
+}
+
+void ScriptApi::send(const QString &text)
+{
+    if (m_matcher->isAborted())
+    {
+        return;
+    }
+
+    QMetaObject::invokeMethod(m_port, "sendData", Qt::QueuedConnection, Q_ARG(QByteArray, text.toUtf8()));
+}
+
+QVariant ScriptApi::expect(const QJSValue &pattern, int timeoutMs, const QString &reply)
+{
+    const QByteArray replyBytes = reply.toUtf8();
+    QByteArray matched;
+    bool replySent = false;
+    bool ok;
+
+    if (pattern.isRegExp())
+    {
+        QRegularExpression rx(pattern.property("source").toString());
+        if (pattern.property("ignoreCase").toBool())
+        {
+            rx.setPatternOptions(QRegularExpression::CaseInsensitiveOption);
+        }
+
+        if (!rx.isValid())
+        {
+            emit message(tr("Bad pattern %1: %2").arg(rx.pattern()).arg(rx.errorString()));
+            return QVariant();
+        }
+
+        ok = m_matcher->expect(rx, replyBytes, timeoutMs, &matched, &replySent);
+    }
+    else
+    {
+        ok = m_matcher->expect(pattern.toString().toUtf8(), replyBytes, timeoutMs, &matched, &replySent);
+    }
+
+    if (!ok)
+    {
+        return QVariant(); // undefined
+    }
+
+    if (!replySent && !replyBytes.isEmpty())
+    {
+        QMetaObject::invokeMethod(m_port, "sendData", Qt::QueuedConnection, Q_ARG(QByteArray, replyBytes));
+    }
+
+    return QString::fromUtf8(matched);
+}
+
+bool ScriptApi::sleep(int ms)
+{
+    return m_matcher->sleep(ms);
+}
+
+void ScriptApi::log(const QString &text)
+{
+    emit message(text);
+}
+
+void ScriptApi::openSerialPort(const QString &pn, int br)
+{
+    // blocking: the script may send right away
+    QMetaObject::invokeMethod(m_port, "openSerialPort", Qt::BlockingQueuedConnection, Q_ARG(QString, pn), Q_ARG(qint32, br));
+}
+
+void ScriptApi::openLocalShell()
+{
+    QMetaObject::invokeMethod(m_port, "openLocalShell", Qt::BlockingQueuedConnection);
+}
+
+void ScriptApi::closePort()
+{
+    QMetaObject::invokeMethod(m_port, "closePort", Qt::BlockingQueuedConnection);
+}
+
+ScriptRunner::ScriptRunner(AsyncPort *port, ExpectMatcher *matcher) :
+    QObject(),
+    m_port(port),
+    m_matcher(matcher),
+    m_engine(Q_NULLPTR)
+{
+}
+
+void ScriptRunner::interrupt()
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    // breaks the loops that don't call into the API
+    QMutexLocker locker(&m_engineMutex);
+    if (m_engine)
+    {
+        m_engine->setInterrupted(true);
+    }
+#endif
+}
+
+void ScriptRunner::run(const QString &program, const QString &fileName)
+{
+    QJSEngine engine;
+
+    ScriptApi *api = new ScriptApi(m_port, m_matcher, this); // has a parent: not owned by the engine
+    connect(api, SIGNAL(message(QString)), this, SIGNAL(message(QString)));
+
+    engine.globalObject().setProperty("qminicom", engine.newQObject(api));
+    engine.evaluate(QString::fromLatin1(scriptPrelude));
+
+    {
+        QMutexLocker locker(&m_engineMutex);
+        m_engine = &engine;
+    }
+
+    QJSValue result = engine.evaluate(program, fileName);
+
+    {
+        QMutexLocker locker(&m_engineMutex);
+        m_engine = Q_NULLPTR;
+    }
+
+    if (m_matcher->isAborted())
+    {
+        emit finished(false, tr("Stopped"));
+    }
+    else if (result.isError())
+    {
+        emit finished(false, tr("%1:%2: %3").arg(QFileInfo(fileName).fileName())
+                      .arg(result.property("lineNumber").toInt())
+                      .arg(result.toString()));
+    }
+    else
+    {
+        emit finished(true, QString());
+    }
+}
+
+ScriptHost::ScriptHost(AsyncPort *port, QObject *parent) :
+    QObject(parent),
+    m_port(port),
+    m_thread(Q_NULLPTR),
+    m_runner(Q_NULLPTR),
+    m_matcher(Q_NULLPTR)
+{
+    qRegisterMetaType<ExpectMatcher *>("ExpectMatcher*");
+}
+
+ScriptHost::~ScriptHost()
+{
+    if (isRunning())
+    {
+        stop();
+        cleanUp();
+    }
+}
+
+bool ScriptHost::start(const QString &fileName)
+{
+    if (isRunning())
+    {
+        qDebug() << "Warning: a script is already running:" << m_fileName;
+        return false;
+    }
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        qDebug() << "ERROR Can't open" << fileName << file.errorString();
+        return false;
+    }
+
+    const QString program = QString::fromUtf8(file.readAll());
+
+    m_fileName = fileName;
+    m_matcher = new ExpectMatcher();
+
+    // from now on every received chunk also goes to the matcher, in the port thread
+    QMetaObject::invokeMethod(m_port, "setExpectMatcher", Qt::BlockingQueuedConnection, Q_ARG(ExpectMatcher*, m_matcher));
+
+    m_thread = new QThread();
+    m_thread->setObjectName(QLatin1String("qminicom-script"));
+
+    m_runner = new ScriptRunner(m_port, m_matcher);
+    m_runner->moveToThread(m_thread);
+
+    connect(m_runner, SIGNAL(message(QString)), this, SIGNAL(message(QString)));
+    connect(m_runner, SIGNAL(finished(bool,QString)), this, SLOT(runnerFinished(bool,QString)));
+
+    m_thread->start();
+
+    QMetaObject::invokeMethod(m_runner, "run", Qt::QueuedConnection, Q_ARG(QString, program), Q_ARG(QString, fileName));
+
+    return true;
+}
+
+bool ScriptHost::isRunning() const
+{
+    return m_thread != Q_NULLPTR;
+}
+
+QString ScriptHost::fileName() const
+{
+    return m_fileName;
+}
+
+void ScriptHost::stop()
+{
+    if (!isRunning())
+    {
+        return;
+    }
+
+    m_matcher->abort(); // the pending expect or sleep returns, the others return at once
+    m_runner->interrupt();
+}
+
+void ScriptHost::runnerFinished(bool ok, const QString &error)
+{
+    cleanUp();
+
+    emit finished(ok, error);
+}
+
+void ScriptHost::cleanUp()
+{
+    QMetaObject::invokeMethod(m_port, "setExpectMatcher", Qt::BlockingQueuedConnection, Q_ARG(ExpectMatcher*, Q_NULLPTR));
+
+    m_thread->quit();
+    m_thread->wait(); // the script returns soon after stop()
+
+    delete m_runner;
+    delete m_thread;
+    delete m_matcher;
+
+    m_runner = Q_NULLPTR;
+    m_thread = Q_NULLPTR;
+    m_matcher = Q_NULLPTR;
+}
@@ -0,0 +1,110 @@
+#ifndef SCRIPTHOST_H
+#define SCRIPTHOST_H
+
+#include "asyncserialport.h"
+#include "expectmatcher.h"
+
+#include <QJSValue>
+#include <QMutex>
+#include <QObject>
+#include <QThread>
+#include <QVariant>
+
+class QJSEngine;
+
+//
+// Expect/send automation: a JavaScript file run against the port of a session.
+//
+// The script runs in a thread of its own, so its blocking calls stay simple:
+//
+//     openSerialPort("ttyUSB0", 115200);
+//     expect("Hit any key to stop autoboot", 10000, " ");  // the reply goes out from the port thread
+//     send("setenv serverip 10.0.0.1\r");
+//     if (expect(/=> $/, 2000) === undefined) throw "no prompt";
+//     sleep(500);
+//     log("done");
+//
+// expect(pattern, timeout = 10000 ms, reply) returns the matched text, undefined on a timeout.
+// Patterns are matched byte-wise on the raw stream in the port thread (see ExpectMatcher),
+// regular expressions over the bytes as Latin-1. closePort() and openLocalShell() control the port.
+//
+
+class ScriptApi : public QObject
+{
+    Q_OBJECT
+
+public:
+    ScriptApi(AsyncPort *port, ExpectMatcher *matcher, QObject *parent);
+
+    Q_INVOKABLE void send(const QString &text);
+    Q_INVOKABLE QVariant expect(const QJSValue &pattern, int timeoutMs, const QString &reply);
+    Q_INVOKABLE bool sleep(int ms);
+    Q_INVOKABLE void log(const QString &text);
+    Q_INVOKABLE void openSerialPort(const QString &pn, int br);
+    Q_INVOKABLE void openLocalShell();
+    Q_INVOKABLE void closePort();
+
+signals:
+    void message(const QString &text);
+
+private:
+    AsyncPort *m_port;
+    ExpectMatcher *m_matcher;
+};
+
+class ScriptRunner : public QObject
+{
+    Q_OBJECT
+
+public:
+    ScriptRunner(AsyncPort *port, ExpectMatcher *matcher);
+
+    void interrupt(); // any thread
+
+signals:
+    void message(const QString &text);
+    void finished(bool ok, const QString &error);
+
+public slots:
+    void run(const QString &program, const QString &fileName);
+
+private:
+    AsyncPort *m_port;
+    ExpectMatcher *m_matcher;
+    QMutex m_engineMutex;
+    QJSEngine *m_engine; // while running
+};
+
+class ScriptHost : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ScriptHost(AsyncPort *port, QObject *parent = 0);
+    ~ScriptHost();
+
+    bool start(const QString &fileName);
+    bool isRunning() const;
+    QString fileName() const;
+
+signals:
+    void message(const QString &text);
+    void finished(bool ok, const QString &error);
+
+public slots:
+    void stop();
+
+private slots:
+    void runnerFinished(bool ok, const QString &error);
+
+private:
+    void cleanUp();
+
+    AsyncPort *m_port; // lives in one of the PortThreadPool threads
+    QThread *m_thread;
+    ScriptRunner *m_runner; // lives in m_thread
+    ExpectMatcher *m_matcher;
+    QString m_fileName;
+};
+
+#endif // SCRIPTHOST_H
@@ -1,56 +1,47 @@
-#include "plaintextlog.h"
 #include "searchhighlighter.h"
 
-#include <QDebug>
-
-SearchHighlighter::SearchHighlighter(PlainTextLog *textLog) :
-    QSyntaxHighlighter(textLog->document())
+SearchHighlighter::SearchHighlighter() :
+    m_isCaseSensitive(false)
 {
-    m_textLog = textLog;
 }
 
 void SearchHighlighter::setSearchPhrase(const QString &phrase, bool caseSensitive)
 {
     m_searchPhrase = phrase;
     m_isCaseSensitive = caseSensitive;
-    rehighlight();
 }
 
-void SearchHighlighter::highlightBlock(const QString &text)
+QString SearchHighlighter::searchPhrase() const
 {
-    QTextBlockUserData *data = Q_NULLPTR;
-
-    if (!m_searchPhrase.isEmpty())
-    {
-        QTextCharFormat myClassFormat;
-        myClassFormat.setFontWeight(QFont::Bold);
-        myClassFormat.setBackground(QColor(0xFEF935));
-        myClassFormat.setForeground(Qt::black);
+    return m_searchPhrase;
+}
 
-        int index = text.indexOf(m_searchPhrase, 0, m_isCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
-        if (index >= 0)
-        {
-            // set block data for drawing the sidebar markers
-            data = m_textLog->highlightBlock(this->currentBlock());
+bool SearchHighlighter::isCaseSensitive() const
+{
+    return m_isCaseSensitive;
+}
 
-            while (index >= 0) {
-                int length = m_searchPhrase.length();
-                setFormat(index, length, myClassFormat);
-                index = text.indexOf(m_searchPhrase, index + length, m_isCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
-            }
-        }
+bool SearchHighlighter::isEmpty() const
+{
+    return m_searchPhrase.isEmpty();
+}
 
-    }
+bool SearchHighlighter::matches(const QString &text) const
+{
+    return !m_searchPhrase.isEmpty() && indexIn(text, 0) >= 0;
+}
 
-    setCurrentBlockUserData(data);
+bool SearchHighlighter::matches(const QStringRef &text) const
+{
+    return !m_searchPhrase.isEmpty() && text.indexOf(m_searchPhrase, 0, m_isCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive) >= 0;
 }
 
-QString SearchHighlighter::searchPhrase() const
+int SearchHighlighter::indexIn(const QString &text, int from) const
 {
-    return m_searchPhrase;
+    return text.indexOf(m_searchPhrase, from, m_isCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
 }
 
-bool SearchHighlighter::isCaseSensitive() const
+int SearchHighlighter::lastIndexIn(const QString &text, int from) const
 {
-    return m_isCaseSensitive;
+    return text.lastIndexOf(m_searchPhrase, from, m_isCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
 }
@@ -1,31 +1,32 @@
 #ifndef SEARCHHIGHLIGHTER_H
 #define SEARCHHIGHLIGHTER_H
 
-#include <QSyntaxHighlighter>
-#include <QTextDocument>
-#include <QObject>
+#include <QString>
 
-class PlainTextLog;
+//
+// The phrase of the find bar. PlainTextLog asks it for the matches of the lines it paints
+// and of the lines leaving the screen (for the side marks), nothing is stored per line.
+//
 
-class SearchHighlighter : public QSyntaxHighlighter
+class SearchHighlighter
 {
-    Q_OBJECT
-
 public:
-    explicit SearchHighlighter(PlainTextLog *textLog);
+    SearchHighlighter();
 
     void setSearchPhrase(const QString &phrase, bool caseSensitive);
 
-    void highlightBlock(const QString &text);
-
     QString searchPhrase() const;
     bool isCaseSensitive() const;
+    bool isEmpty() const;
+
+    bool matches(const QString &text) const;
+    bool matches(const QStringRef &text) const;
+    int indexIn(const QString &text, int from) const;
+    int lastIndexIn(const QString &text, int from) const;
 
 private:
     QString m_searchPhrase;
     bool m_isCaseSensitive;
-
-    PlainTextLog *m_textLog;
 };
 
 #endif // SEARCHHIGHLIGHTER_H
@@ -0,0 +1,470 @@
+#include "session.h"
+#include "portthreadpool.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QGraphicsScene>
+#include <QHBoxLayout>
+#include <QScrollBar>
+#include <QSettings>
+#include <QSplitter>
+#include <QVBoxLayout>
+
+Session::Session(QWidget *parent) :
+    QWidget(parent),
+    m_log(new PlainTextLog(this)),
+    m_sideMarkView(new QGraphicsView(this)),
+    m_searchMarksVisible(false),
+    m_hexView(new HexView(this)),
+    m_packetView(new PacketView(this)),
+    m_filterPane(new QWidget(this)),
+    m_filterEdit(new QLineEdit(m_filterPane)),
+    m_filterExclude(new QCheckBox(tr("Exclude"), m_filterPane)),
+    m_filterCaseSensitive(new QCheckBox(tr("Aa"), m_filterPane)),
+    m_filterView(new FilterView(m_log, m_filterPane)),
+    m_filterTimer(new QTimer(this)),
+    m_port(new AsyncPort()),
+    m_scriptHost(new ScriptHost(m_port)),
+    m_framing(FrameDecoder::NoFraming),
+    m_frameCrcChecked(false),
+    m_frameDecoder(Q_NULLPTR),
+    m_status(AsyncPort::Offline),
+    m_baudRate(0),
+    m_lastRxBytes(0),
+    m_lastTxBytes(0),
+    m_lastLines(0),
+    m_lastSequences(0)
+{
+    QWidget *logArea = new QWidget(this);
+    QHBoxLayout *logLayout = new QHBoxLayout(logArea);
+    logLayout->setSpacing(0);
+    logLayout->setContentsMargins(0, 0, 0, 0);
+    logLayout->addWidget(m_log);
+    logLayout->addWidget(m_sideMarkView);
+
+    QHBoxLayout *filterBar = new QHBoxLayout();
+    filterBar->setContentsMargins(0, 0, 0, 0);
+    filterBar->addWidget(m_filterEdit, 1);
+    filterBar->addWidget(m_filterExclude);
+    filterBar->addWidget(m_filterCaseSensitive);
+
+    QVBoxLayout *filterLayout = new QVBoxLayout(m_filterPane);
+    filterLayout->setSpacing(0);
+    filterLayout->setContentsMargins(0, 0, 0, 0);
+    filterLayout->addLayout(filterBar);
+    filterLayout->addWidget(m_filterView);
+
+    QSplitter *splitter = new QSplitter(Qt::Vertical, this);
+    splitter->setChildrenCollapsible(false);
+    splitter->addWidget(logArea);
+    splitter->addWidget(m_filterPane);
+    splitter->addWidget(m_hexView);
+    splitter->addWidget(m_packetView);
+    splitter->setStretchFactor(0, 2);
+    splitter->setStretchFactor(1, 1);
+    splitter->setStretchFactor(2, 1);
+    splitter->setStretchFactor(3, 1);
+
+    QHBoxLayout *layout = new QHBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addWidget(splitter);
+
+    m_hexView->setVisible(false);
+    m_packetView->setVisible(false);
+
+    m_filterPane->setVisible(false);
+    m_filterEdit->setPlaceholderText(tr("Filter lines (regular expression)"));
+    m_filterCaseSensitive->setToolTip(tr("Case sensitive"));
+    m_filterTimer->setSingleShot(true);
+    m_filterTimer->setInterval(200);
+    connect(m_filterEdit, SIGNAL(textChanged(QString)), m_filterTimer, SLOT(start()));
+    connect(m_filterExclude, SIGNAL(toggled(bool)), this, SLOT(applyFilter()));
+    connect(m_filterCaseSensitive, SIGNAL(toggled(bool)), this, SLOT(applyFilter()));
+    connect(m_filterTimer, SIGNAL(timeout()), this, SLOT(applyFilter()));
+    connect(m_filterView, SIGNAL(lineActivated(qint64)), m_log, SLOT(showLine(qint64)));
+
+    // keep the dump at the terminal line shown at the top of the log, both ways
+    connect(m_log->verticalScrollBar(), SIGNAL(valueChanged(int)), this, SLOT(syncHexView()));
+    connect(m_hexView, SIGNAL(topLineChanged(qint64)), this, SLOT(showHexViewLine(qint64)));
+
+    m_sideMarkView->setEnabled(false);
+    m_sideMarkView->setFixedWidth(14);
+    m_sideMarkView->setFrameShape(QFrame::NoFrame);
+    m_sideMarkView->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    m_sideMarkView->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    m_sideMarkView->setInteractive(false);
+    m_sideMarkView->setAlignment(Qt::AlignHCenter | Qt::AlignTop);
+    m_sideMarkView->setTransformationAnchor(QGraphicsView::NoAnchor);
+    m_sideMarkView->setViewportUpdateMode(QGraphicsView::FullViewportUpdate);
+    m_sideMarkView->setVisible(false);
+
+    QGraphicsScene *scene = new QGraphicsScene(this);
+    m_log->setSideMarkScene(scene);
+    m_sideMarkView->setScene(scene);
+
+    m_log->setContextMenuPolicy(Qt::CustomContextMenu);
+
+    PortThreadPool::instance()->attach(m_port);
+    QMetaObject::invokeMethod(m_port, "initialize", Qt::QueuedConnection);
+    connect(m_port, SIGNAL(statusChanged(AsyncPort::Status,QString,qint32)), this, SLOT(updatePortStatus(AsyncPort::Status,QString,qint32)));
+    connect(m_port, SIGNAL(readLatencyUpdated(QString)), this, SLOT(updateReadLatency(QString)));
+    connect(m_port, SIGNAL(dataReceived(QByteArray,qint64)), this, SLOT(receiveData(QByteArray,qint64)));
+    connect(m_log, SIGNAL(sendBytes(QByteArray)), m_port, SLOT(sendData(QByteArray)));
+    connect(m_log, SIGNAL(terminalSizeChanged(int,int)), m_port, SLOT(setTerminalSize(int,int)));
+    connect(m_log, SIGNAL(sendBytes(QByteArray)), m_hexView, SLOT(appendSent(QByteArray)));
+    connect(m_log, SIGNAL(bookmarksChanged(int)), this, SLOT(updateSideMarks()));
+
+    m_countersClock.start();
+}
+
+Session::~Session()
+{
+    delete m_scriptHost; // stops the script, which may be using the port
+
+    // the final flush has to happen before the writer thread is stopped on exit
+    foreach (CaptureWriter *writer, m_captureWriters)
+    {
+        QMetaObject::invokeMethod(writer, "close", Qt::BlockingQueuedConnection);
+    }
+    stopCapture();
+
+    QMetaObject::invokeMethod(m_port, "closePort", Qt::BlockingQueuedConnection);
+
+    PortThreadPool::instance()->detach(m_port);
+
+    delete m_frameDecoder;
+}
+
+PlainTextLog *Session::log() const
+{
+    return m_log;
+}
+
+HexView *Session::hexView() const
+{
+    return m_hexView;
+}
+
+PacketView *Session::packetView() const
+{
+    return m_packetView;
+}
+
+FilterView *Session::filterView() const
+{
+    return m_filterView;
+}
+
+ScriptHost *Session::scriptHost() const
+{
+    return m_scriptHost;
+}
+
+void Session::setSideMarksVisible(bool visible)
+{
+    m_searchMarksVisible = visible;
+    updateSideMarks();
+}
+
+void Session::updateSideMarks()
+{
+    m_sideMarkView->setVisible(m_searchMarksVisible || m_log->bookmarkCount() > 0);
+}
+
+void Session::setHexViewVisible(bool visible)
+{
+    m_hexView->setVisible(visible);
+
+    if (visible)
+    {
+        syncHexView();
+    }
+}
+
+void Session::syncHexView()
+{
+    // by line id: the scroll bar counts from the first line left by "Clear to this line"
+    if (m_hexView->isHidden() || m_log->isAlternateScreenActive())
+    {
+        return;
+    }
+
+    m_hexView->scrollToLine(m_log->lineStore().firstLineId() + m_log->verticalScrollBar()->value());
+}
+
+void Session::showHexViewLine(qint64 line)
+{
+    if (m_log->isAlternateScreenActive())
+    {
+        return;
+    }
+
+    const qint64 row = line - m_log->lineStore().firstLineId();
+    if (row >= 0)
+    {
+        m_log->verticalScrollBar()->setValue(int(qMin(row, qint64(m_log->verticalScrollBar()->maximum()))));
+    }
+}
+
+void Session::setFilterVisible(bool visible)
+{
+    m_filterPane->setVisible(visible);
+
+    if (visible)
+    {
+        m_filterEdit->setFocus();
+    }
+
+    applyFilter(); // a hidden filter isn't kept up to date
+}
+
+void Session::applyFilter()
+{
+    m_filterTimer->stop();
+
+    const QString pattern = m_filterPane->isHidden() ? QString() : m_filterEdit->text();
+
+    bool valid = m_filterView->setFilter(pattern, m_filterExclude->isChecked(), m_filterCaseSensitive->isChecked());
+
+    QPalette palette = m_filterEdit->palette();
+    palette.setColor(QPalette::Text, valid ? QPalette().color(QPalette::Text) : QColor(Qt::red));
+    m_filterEdit->setPalette(palette);
+}
+
+FrameDecoder::Framing Session::framing() const
+{
+    return m_framing;
+}
+
+bool Session::isFrameCrcChecked() const
+{
+    return m_frameCrcChecked;
+}
+
+void Session::setFraming(FrameDecoder::Framing framing, bool checkCrc)
+{
+    if (framing == m_framing && checkCrc == m_frameCrcChecked)
+    {
+        return;
+    }
+
+    // a frame cut in half by the switch is lost
+    delete m_frameDecoder;
+    m_frameDecoder = FrameDecoder::create(framing, checkCrc);
+
+    m_framing = framing;
+    m_frameCrcChecked = checkCrc;
+
+    m_packetView->setVisible(m_frameDecoder != Q_NULLPTR);
+
+    // the '\n' inside the frames don't reach the log: no line mapping while decoding
+    m_hexView->setLineIndexing(m_frameDecoder == Q_NULLPTR, m_log->lineStore().endLineId() - 1);
+}
+
+AsyncPort::Status Session::status() const
+{
+    return m_status;
+}
+
+QString Session::portName() const
+{
+    return m_portName;
+}
+
+qint32 Session::baudRate() const
+{
+    return m_baudRate;
+}
+
+QString Session::readLatency() const
+{
+    return m_readLatency;
+}
+
+QString Session::title() const
+{
+    if (m_portName.isEmpty())
+    {
+        return AsyncPort::convertStatusToQString(m_status);
+    }
+
+    return m_portName.section('/', -1);
+}
+
+SessionCounters Session::sampleCounters()
+{
+    PortCounters *portCounters = m_port->counters();
+    const PlainTextLog::ParserCounters &logCounters = m_log->counters();
+
+    qint64 rxBytes = portCounters->rxBytes.load();
+    qint64 txBytes = portCounters->txBytes.load();
+
+    double seconds = qMax(m_countersClock.restart(), Q_INT64_C(1)) / 1000.0;
+
+    SessionCounters c;
+
+    c.rxBytesRate = (rxBytes - m_lastRxBytes) / seconds;
+    c.txBytesRate = (txBytes - m_lastTxBytes) / seconds;
+    c.linesRate = (logCounters.lines - m_lastLines) / seconds;
+    c.sequencesRate = (logCounters.sequences - m_lastSequences) / seconds;
+
+    c.droppedUtf8Bytes = logCounters.droppedUtf8Bytes;
+    c.replacedUtf8Chars = logCounters.replacedUtf8Chars;
+    c.unsupportedSequences = logCounters.unsupportedSequences;
+
+    c.backlogChunks = portCounters->chunksInFlight.load();
+    c.scrollbackBytes = m_log->scrollbackBytes();
+
+    m_lastRxBytes = rxBytes;
+    m_lastTxBytes = txBytes;
+    m_lastLines = logCounters.lines;
+    m_lastSequences = logCounters.sequences;
+
+    return c;
+}
+
+bool Session::startCapture(const QString &fileName, QString *error)
+{
+    stopCapture();
+
+    QSettings m_settings;
+
+    m_settings.beginGroup(QLatin1String("Capture"));
+    QString formatName = m_settings.value(QLatin1String("format"), "plain").toString();
+    qint64 maxSegmentBytes = m_settings.value(QLatin1String("maxSegmentMBytes"), 0).toLongLong() * 1024 * 1024;
+    int maxSegmentSeconds = m_settings.value(QLatin1String("maxSegmentMinutes"), 0).toInt() * 60;
+    bool compress = m_settings.value(QLatin1String("compress"), true).toBool();
+    m_settings.endGroup();
+
+    // "both" keeps the escape-free text next to the raw stream, the raw one gets the .raw suffix
+
+    QList<QPair<QString, CaptureWriter::Format> > outputs;
+    CaptureWriter::Format format;
+
+    if (formatName == "both")
+    {
+        outputs << qMakePair(fileName, CaptureWriter::PlainText);
+        outputs << qMakePair(fileName + ".raw", CaptureWriter::Raw);
+    }
+    else if (CaptureWriter::parseFormat(formatName, &format))
+    {
+        outputs << qMakePair(fileName, format);
+    }
+    else
+    {
+        qDebug() << "Warning: unknown capture format" << formatName << ", using plain";
+        outputs << qMakePair(fileName, CaptureWriter::PlainText);
+    }
+
+    for (int i = 0; i < outputs.size(); ++i)
+    {
+        CaptureWriter *writer = new CaptureWriter();
+        writer->setRotation(maxSegmentBytes, maxSegmentSeconds, compress);
+
+        if (!writer->open(outputs.at(i).first, outputs.at(i).second, error))
+        {
+            qDebug() << "ERROR Can't open" << outputs.at(i).first << ":" << *error;
+            *error = tr("Can't open %1:\n%2").arg(QDir::toNativeSeparators(outputs.at(i).first)).arg(*error);
+            delete writer;
+            stopCapture();
+            return false;
+        }
+
+        // the writer is fed straight from the port thread, the GUI thread is not involved
+        writer->moveToThread(CaptureWriter::writerThread());
+        connect(m_port, SIGNAL(dataReceived(QByteArray,qint64)), writer, SLOT(write(QByteArray)));
+
+        m_captureWriters.append(writer);
+    }
+
+    return true;
+}
+
+void Session::stopCapture()
+{
+    foreach (CaptureWriter *writer, m_captureWriters)
+    {
+        disconnect(m_port, Q_NULLPTR, writer, Q_NULLPTR);
+        QMetaObject::invokeMethod(writer, "close", Qt::QueuedConnection);
+        writer->deleteLater();
+    }
+
+    m_captureWriters.clear();
+}
+
+bool Session::isCapturing() const
+{
+    return !m_captureWriters.isEmpty();
+}
+
+void Session::openSerialPort(const QString &pn, qint32 br)
+{
+    QMetaObject::invokeMethod(m_port, "openSerialPort", Qt::QueuedConnection, Q_ARG(QString, pn), Q_ARG(qint32, br));
+}
+
+void Session::setSerialTuning(const SerialTuning &tuning)
+{
+    QMetaObject::invokeMethod(m_port, "setSerialTuning", Qt::QueuedConnection, Q_ARG(SerialTuning, tuning));
+}
+
+void Session::openLocalShell()
+{
+    QMetaObject::invokeMethod(m_port, "openLocalShell", Qt::QueuedConnection);
+}
+
+void Session::openVirtualPort()
+{
+    QMetaObject::invokeMethod(m_port, "openVirtualPort", Qt::QueuedConnection);
+}
+
+void Session::closePort()
+{
+    QMetaObject::invokeMethod(m_port, "closePort", Qt::QueuedConnection);
+}
+
+void Session::receiveData(const QByteArray &data, qint64 timestamp)
+{
+    m_port->counters()->chunksInFlight.deref();
+
+    m_hexView->appendReceived(data);
+
+    if (!m_frameDecoder)
+    {
+        m_log->appendBytes(data, timestamp);
+        return;
+    }
+
+    QByteArray text;
+    text.reserve(data.size());
+    QVector<FrameRecord> frames;
+
+    m_frameDecoder->decode(data, &text, &frames);
+
+    m_packetView->appendFrames(frames);
+
+    if (!text.isEmpty())
+    {
+        m_log->appendBytes(text, timestamp);
+    }
+}
+
+void Session::updatePortStatus(AsyncPort::Status st, const QString &pn, qint32 br)
+{
+    m_status = st;
+    m_portName = pn;
+    m_baudRate = br;
+
+    if (st != AsyncPort::Online)
+    {
+        m_readLatency.clear();
+    }
+
+    emit statusChanged();
+}
+
+void Session::updateReadLatency(const QString &histogram)
+{
+    m_readLatency = histogram;
+
+    emit statusChanged();
+}
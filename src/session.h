@@ -0,0 +1,136 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include "asyncserialport.h"
+#include "capturewriter.h"
+#include "filterview.h"
+#include "framedecoder.h"
+#include "hexview.h"
+#include "packetview.h"
+#include "plaintextlog.h"
+#include "scripthost.h"
+
+#include <QCheckBox>
+#include <QElapsedTimer>
+#include <QGraphicsView>
+#include <QLineEdit>
+#include <QTimer>
+#include <QWidget>
+
+//
+// One terminal session: a port backend running in a shared I/O thread and the log widget it feeds.
+//
+// A session whose widget is hidden (background tab) keeps capturing,
+// the log widget defers parsing and rendering until it is shown again.
+//
+// With a framing set, the received chunks go through a FrameDecoder first: the frames are listed
+// in the packet view, the text around them goes to the log. The hex view and the captures get the raw stream,
+// the hex view follows the log lines only while no framing is set.
+//
+
+struct SessionCounters
+{
+    // per second, since the previous Session::sampleCounters()
+    double rxBytesRate;
+    double txBytesRate;
+    double linesRate;
+    double sequencesRate;
+
+    // totals
+    qint64 droppedUtf8Bytes;
+    qint64 replacedUtf8Chars;
+    qint64 unsupportedSequences;
+
+    // current values
+    int backlogChunks;
+    qint64 scrollbackBytes;
+};
+
+class Session : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit Session(QWidget *parent = 0);
+    ~Session();
+
+    PlainTextLog *log() const;
+    HexView *hexView() const;
+    PacketView *packetView() const;
+    FilterView *filterView() const;
+    ScriptHost *scriptHost() const;
+
+    void setSideMarksVisible(bool visible); // with the find bar, the bookmarks show them anyway
+    void setHexViewVisible(bool visible);
+    void setFilterVisible(bool visible);
+
+    FrameDecoder::Framing framing() const;
+    bool isFrameCrcChecked() const;
+    void setFraming(FrameDecoder::Framing framing, bool checkCrc);
+
+    AsyncPort::Status status() const;
+    QString portName() const;
+    qint32 baudRate() const;
+    QString readLatency() const;
+    QString title() const;
+
+    SessionCounters sampleCounters();
+
+    bool startCapture(const QString &fileName, QString *error);
+    void stopCapture();
+    bool isCapturing() const;
+
+signals:
+    void statusChanged();
+
+public slots:
+    void openSerialPort(const QString &pn, qint32 br);
+    void setSerialTuning(const SerialTuning &tuning);
+    void openLocalShell();
+    void openVirtualPort();
+    void closePort();
+
+private slots:
+    void receiveData(const QByteArray &data, qint64 timestamp);
+    void updatePortStatus(AsyncPort::Status st, const QString &pn, qint32 br);
+    void updateReadLatency(const QString &histogram);
+    void applyFilter();
+    void syncHexView();
+    void showHexViewLine(qint64 line);
+    void updateSideMarks();
+
+private:
+    PlainTextLog *m_log;
+    QGraphicsView *m_sideMarkView;
+    bool m_searchMarksVisible;
+    HexView *m_hexView;
+    PacketView *m_packetView;
+    QWidget *m_filterPane;
+    QLineEdit *m_filterEdit;
+    QCheckBox *m_filterExclude;
+    QCheckBox *m_filterCaseSensitive;
+    FilterView *m_filterView;
+    QTimer *m_filterTimer; // the filter is applied once the typing pauses
+
+    AsyncPort *m_port; // lives in one of the PortThreadPool threads
+    ScriptHost *m_scriptHost;
+
+    FrameDecoder::Framing m_framing;
+    bool m_frameCrcChecked;
+    FrameDecoder *m_frameDecoder;
+
+    AsyncPort::Status m_status;
+    QString m_portName;
+    qint32 m_baudRate;
+    QString m_readLatency;
+
+    QElapsedTimer m_countersClock;
+    qint64 m_lastRxBytes;
+    qint64 m_lastTxBytes;
+    qint64 m_lastLines;
+    qint64 m_lastSequences;
+
+    QList<CaptureWriter *> m_captureWriters; // live in CaptureWriter::writerThread()
+};
+
+#endif // SESSION_H
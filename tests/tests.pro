@@ -0,0 +1,33 @@
+#-------------------------------------------------
+#
+# Parser conformance and throughput: make check
+#
+#-------------------------------------------------
+
+QT       += core gui concurrent testlib
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+TARGET = tst_terminalparser
+TEMPLATE = app
+
+CONFIG += testcase console
+CONFIG -= app_bundle
+
+DEFINES += QMINICOM_TESTS
+
+INCLUDEPATH += ../src
+
+SOURCES += tst_terminalparser.cpp \
+    ../src/plaintextlog.cpp \
+    ../src/linestore.cpp \
+    ../src/searchhighlighter.cpp \
+    ../src/chunklatency.cpp
+
+HEADERS += ../src/plaintextlog.h \
+    ../src/linestore.h \
+    ../src/searchhighlighter.h \
+    ../src/chunklatency.h
+
+DISTFILES += \
+    snapshots/*.screen
@@ -0,0 +1,215 @@
+#include "plaintextlog.h"
+
+#include <QApplication>
+#include <QDir>
+#include <QFile>
+#include <QFontDatabase>
+#include <QScopedPointer>
+#include <QtTest>
+
+//
+// Parser conformance and throughput, on an offscreen PlainTextLog.
+//
+// conformance: each sample is parsed on a fresh 80x24 screen and the result (text, attribute runs,
+// caret) is compared with snapshots/<sample>.screen. Real captures dropped into snapshots/ as
+// <capture>.raw are compared with <capture>.raw.screen. A missing snapshot is a failure;
+// QMINICOM_UPDATE_SNAPSHOTS=1 writes the snapshots instead of comparing.
+//
+// throughput: a generated workload per sequence class (plain text, SGR, CUP, ED/EL) parsed
+// in receive-sized chunks, so a parser change can be checked against the numbers of the previous build.
+//
+
+class TerminalParserTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void conformance_data();
+    void conformance();
+    void throughput_data();
+    void throughput();
+
+private:
+    static const int columns = 80;
+    static const int rows = 24;
+    static const int chunkBytes = 4096; // a typical read from a fast port
+
+    PlainTextLog *createLog() const;
+    void feed(PlainTextLog *log, const QByteArray &bytes) const;
+};
+
+void TerminalParserTest::conformance_data()
+{
+    QTest::addColumn<QByteArray>("bytes");
+    QTest::addColumn<QString>("snapshotFile");
+
+    const QString dir = QFINDTESTDATA("snapshots");
+
+    // the test strings kept in the PlainTextLog constructor for years, plus a few vttest-like fragments
+
+    static const char *const samples[][2] =
+    {
+        { "cursor-moves",   "\x1B[2J@\x1B[12B@\x1B[12C@\x1B[2J" },
+        { "erase-below",    "\x1B[2J@\x1B[D\x1B[12B@\x1B[D\x1B[12C@\x1B[D\x1B[6B$\x1B[D\x1B[0J\x1B[6A\x1B[0J" },
+        { "erase-above",    "\x1B[2J@\x1B[D\x1B[12B@\x1B[D\x1B[12C@\x1B[D\x1B[D\x1B[1J" },
+        { "alignment-test", "\x1B[H\x1B#8\x1B[2J" },
+        { "sgr",            "plain \x1B[1;31mbright red\x1B[0m \x1B[4;42munderlined on green\x1B[m \x1B[7minverse\x1B[0m\r\n" },
+        { "erase-line",     "0123456789\x1B[5D\x1B[K\r\nabcdefghij\x1B[5D\x1B[1K\r\nABCDEFGHIJ\x1B[2K\r\n" },
+        { "scroll-region",  "\x1B[2J\x1B[H1\r\n2\r\n3\r\n4\r\n5\x1B[2;4r\x1B[4;1H\n\n\x1B[2;1H\x1BM\x1B[r" },
+        { "insert-delete",  "\x1B[2J\x1B[Ha\r\nb\r\nc\r\nd\x1B[2;1H\x1B[L\x1B[4;1H\x1B[2M" },
+        { "alternate",      "main\r\n\x1B[?1049hfull screen\x1B[?1049l" }
+    };
+
+    for (size_t i = 0; i < sizeof(samples) / sizeof(samples[0]); ++i)
+    {
+        QTest::newRow(samples[i][0]) << QByteArray(samples[i][1]) << QString("%1/%2.screen").arg(dir).arg(samples[i][0]);
+    }
+
+    foreach (const QString &fileName, QDir(dir).entryList(QStringList() << "*.raw", QDir::Files, QDir::Name))
+    {
+        QFile file(QDir(dir).filePath(fileName));
+        if (!file.open(QIODevice::ReadOnly))
+        {
+            qDebug() << "ERROR Can't open" << file.fileName() << file.errorString();
+            continue;
+        }
+
+        QTest::newRow(qPrintable(fileName)) << file.readAll() << file.fileName() + ".screen";
+    }
+}
+
+void TerminalParserTest::conformance()
+{
+    QFETCH(QByteArray, bytes);
+    QFETCH(QString, snapshotFile);
+
+    QScopedPointer<PlainTextLog> log(createLog());
+
+    QCOMPARE(log->terminalScreenWidth(), int(columns));
+    QCOMPARE(log->terminalScreenHeight(), int(rows));
+
+    feed(log.data(), bytes);
+
+    const QString snapshot = log->screenSnapshot();
+
+    QFile file(snapshotFile);
+
+    if (qEnvironmentVariableIsSet("QMINICOM_UPDATE_SNAPSHOTS"))
+    {
+        QVERIFY2(file.open(QIODevice::WriteOnly) && file.write(snapshot.toUtf8()) >= 0,
+                 qPrintable(QString("Can't write %1: %2").arg(snapshotFile).arg(file.errorString())));
+        return;
+    }
+
+    QVERIFY2(file.open(QIODevice::ReadOnly),
+             qPrintable(QString("No snapshot %1: %2").arg(snapshotFile).arg(file.errorString())));
+
+    const QStringList expected = QString::fromUtf8(file.readAll()).split('\n');
+    const QStringList actual = snapshot.split('\n');
+
+    for (int i = 0; i < qMax(expected.size(), actual.size()); ++i)
+    {
+        if (actual.value(i) != expected.value(i))
+        {
+            QFAIL(qPrintable(QString("line %1\n   expected: %2\n   actual:   %3").arg(i + 1).arg(expected.value(i)).arg(actual.value(i))));
+        }
+    }
+}
+
+void TerminalParserTest::throughput_data()
+{
+    QTest::addColumn<QByteArray>("bytes");
+
+    // about 1 MiB per sequence class, deterministic so that the runs are comparable
+
+    const int workloadBytes = 1024 * 1024;
+
+    QByteArray text;
+    while (text.size() < workloadBytes)
+    {
+        text += QByteArray::number(text.size()) + " the quick brown fox jumps over the lazy dog\r\n";
+    }
+
+    QByteArray sgr;
+    for (int i = 0; sgr.size() < workloadBytes; ++i)
+    {
+        sgr += "\x1B[1;3" + QByteArray::number(i % 8) + "m[" + QByteArray::number(i) + "]\x1B[0m "
+                + "\x1B[4;4" + QByteArray::number((i + 3) % 8) + "mstatus\x1B[m ok\r\n";
+    }
+
+    QByteArray cup;
+    for (int i = 0; cup.size() < workloadBytes; ++i)
+    {
+        cup += "\x1B[" + QByteArray::number(i * 7 % rows + 1) + ";" + QByteArray::number(i * 13 % columns + 1) + "H*";
+    }
+
+    QByteArray erase;
+    for (int i = 0; erase.size() < workloadBytes; ++i)
+    {
+        erase += "\x1B[" + QByteArray::number(i % rows + 1) + ";1Hprogress " + QByteArray::number(i) + "\x1B[K";
+        if (i % 64 == 0)
+        {
+            erase += "\x1B[2J";
+        }
+    }
+
+    QTest::newRow("text") << text;
+    QTest::newRow("sgr") << sgr;
+    QTest::newRow("cup") << cup;
+    QTest::newRow("ed-el") << erase;
+}
+
+void TerminalParserTest::throughput()
+{
+    QFETCH(QByteArray, bytes);
+
+    QScopedPointer<PlainTextLog> log(createLog());
+
+    QBENCHMARK
+    {
+        log->clear();
+        feed(log.data(), bytes);
+    }
+}
+
+PlainTextLog *TerminalParserTest::createLog() const
+{
+    PlainTextLog *log = new PlainTextLog();
+
+    // the terminal size follows the viewport: make it exactly columns x rows character cells
+    log->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    log->setFrameShape(QFrame::NoFrame);
+    log->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    log->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    log->resize(columns * log->fontMetrics().width(' '), rows * log->fontMetrics().height());
+    log->setAttribute(Qt::WA_DontShowOnScreen);
+    log->show(); // a hidden log only queues the bytes
+
+    QApplication::processEvents();
+
+    return log;
+}
+
+void TerminalParserTest::feed(PlainTextLog *log, const QByteArray &bytes) const
+{
+    for (int i = 0; i < bytes.size(); i += chunkBytes)
+    {
+        log->appendBytes(bytes.mid(i, chunkBytes));
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    // no display needed
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+    {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    QApplication app(argc, argv);
+
+    TerminalParserTest test;
+    return QTest::qExec(&test, argc, argv);
+}
+
+#include "tst_terminalparser.moc"